@@ -0,0 +1,88 @@
+// Lexer micro-benchmark: tokenizes a synthetic ~10 MB UAS source and
+// compares perfect-hash keyword lookup against the old if/else chain.
+// Build & run: make lexer-bench
+
+#include "lexer.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+static std::string makeSource(size_t targetBytes) {
+    static const char* lines[] = {
+        "функція обчислення_%zu(значення: число, крок: число): число {\n",
+        "    нехай проміжне_%zu = значення * крок + %zu.5\n",
+        "    змінна лічильник_%zu = 0\n",
+        "    поки лічильник_%zu < %zu { лічильник_%zu = лічильник_%zu + 1 }\n",
+        "    якщо проміжне_%zu >= 100 { повернути так } інакше { повернути ні }\n",
+        "    співпадіння значення { варіант %zu => друк(\"рядок %zu\") варіант _ => друк(\"інше\") }\n",
+        "}\n",
+        "let result_%zu = compute_%zu(%zu, 2) // trailing comment\n",
+    };
+    std::string src;
+    src.reserve(targetBytes + 256);
+    char buf[256];
+    for (size_t i = 0; src.size() < targetBytes; i++) {
+        const char* fmt = lines[i % (sizeof(lines) / sizeof(lines[0]))];
+        snprintf(buf, sizeof(buf), fmt, i, i, i, i, i, i, i);
+        src += buf;
+    }
+    return src;
+}
+
+// The keyword classification Lexer::identifier() used before the perfect hash.
+static TokenType legacyKeyword(std::string_view text) {
+    if (text == "fn" || text == "функція" || text == "fun") return TOK_FN;
+    if (text == "let" || text == "нехай" || text == "змінна") return TOK_LET;
+    if (text == "if" || text == "якщо") return TOK_IF;
+    if (text == "else" || text == "інакше") return TOK_ELSE;
+    if (text == "return" || text == "повернути") return TOK_RETURN;
+    if (text == "while" || text == "поки") return TOK_WHILE;
+    if (text == "true" || text == "так" || text == "істина") return TOK_TRUE;
+    if (text == "false" || text == "ні" || text == "хиба") return TOK_FALSE;
+    if (text == "null" || text == "нічого") return TOK_NONE;
+    if (text == "switch" || text == "вибір" || text == "співпадіння") return TOK_SWITCH;
+    if (text == "case" || text == "варіант") return TOK_CASE;
+    if (text == "default" || text == "типово") return TOK_DEFAULT;
+    return TOK_IDENTIFIER;
+}
+
+template <typename F>
+static double timeMs(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    std::string src = makeSource(10 * 1024 * 1024);
+    double mb = src.size() / (1024.0 * 1024.0);
+
+    // Full lexer pass, pulling tokens the way the parser does.
+    size_t tokens = 0;
+    double lexMs = timeMs([&] {
+        Lexer lexer(src);
+        while (lexer.next().type != TOK_EOF) tokens++;
+    });
+
+    // Keyword classification alone, on every identifier-like token.
+    std::vector<std::string_view> words;
+    {
+        Lexer lexer(src);
+        for (Token t = lexer.next(); t.type != TOK_EOF; t = lexer.next()) {
+            if (t.type == TOK_IDENTIFIER || lookupKeyword(t.text) != TOK_IDENTIFIER) words.push_back(t.text);
+        }
+    }
+    size_t hashHits = 0, chainHits = 0;
+    double hashMs = timeMs([&] { for (auto w : words) hashHits += lookupKeyword(w) != TOK_IDENTIFIER; });
+    double chainMs = timeMs([&] { for (auto w : words) chainHits += legacyKeyword(w) != TOK_IDENTIFIER; });
+    if (hashHits != chainHits) {
+        fprintf(stderr, "keyword mismatch: %zu vs %zu\n", hashHits, chainHits);
+        return 1;
+    }
+
+    printf("source: %.1f MB, %zu tokens, %zu identifiers/keywords\n", mb, tokens, words.size());
+    printf("lex (next):       %8.2f ms  %7.1f MB/s  %6.1f Mtok/s\n", lexMs, mb / (lexMs / 1000), tokens / lexMs / 1000);
+    printf("keywords (hash):  %8.2f ms\n", hashMs);
+    printf("keywords (chain): %8.2f ms  (%.1fx slower)\n", chainMs, chainMs / hashMs);
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Numeric list kernels: one Value at a time (what untyped list code does),
+// the scalar fallback, and every vector variant this CPU can run, on
+// lists small enough to stay in cache.
+// Build & run: make simd-bench
+
+#include "runtime.h"
+#include <chrono>
+#include <cstdio>
+
+template <typename F>
+static double timeMs(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static volatile double sink;
+
+int main() {
+    const size_t n = 1024, reps = 80000;
+    List<double> a, b;
+    List<Value> va, vb;
+    for (size_t i = 0; i < n; i++) {
+        a.push(1.0 + i % 17);
+        b.push(0.5 + i % 13);
+        va.push(Value(1.0 + i % 17));
+        vb.push(Value(0.5 + i % 13));
+    }
+    List<double> out = sizedList<double>(n);
+
+    std::vector<SimdKernels> variants = {simd_scalar::kernels("scalar")};
+#ifdef UAS_SIMD_X86
+    if (__builtin_cpu_supports("avx2")) variants.push_back(simd_avx2::kernels("avx2"));
+    if (__builtin_cpu_supports("avx512f")) variants.push_back(simd_avx512::kernels("avx512"));
+#endif
+#ifdef UAS_SIMD_NEON
+    variants.push_back(simd_neon::kernels("neon"));
+#endif
+
+    double valueSum = timeMs([&] {
+        for (size_t r = 0; r < reps; r++) {
+            Value total(0.0);
+            for (const Value& x : va) total = total + x;
+            sink = total.numberVal;
+        }
+    });
+    double valueMul = timeMs([&] {
+        for (size_t r = 0; r < reps; r++) {
+            for (size_t i = 0; i < n; i++) va.unchecked(i) = va.unchecked(i) * vb.unchecked(i) * Value(1.0);
+        }
+    });
+    printf("%-8s %10s %10s %10s %10s %10s\n", "", "sum", "dot", "max", "a*b", "sqrt");
+    printf("%-8s %8.1fms %10s %10s %8.1fms %10s\n", "Value", valueSum, "-", "-", valueMul, "-");
+    for (const SimdKernels& k : variants) {
+        double sum = timeMs([&] { for (size_t r = 0; r < reps; r++) sink = k.sum(a.data(), n); });
+        double dot = timeMs([&] { for (size_t r = 0; r < reps; r++) sink = k.dot(a.data(), b.data(), n); });
+        double max = timeMs([&] { for (size_t r = 0; r < reps; r++) sink = k.max(a.data(), n); });
+        double mul = timeMs([&] { for (size_t r = 0; r < reps; r++) k.each[SIMD_MUL](a.data(), b.data(), out.data(), n); });
+        double root = timeMs([&] { for (size_t r = 0; r < reps; r++) k.sqrt(a.data(), out.data(), n); });
+        printf("%-8s %8.1fms %8.1fms %8.1fms %8.1fms %8.1fms\n", k.name, sum, dot, max, mul, root);
+    }
+    return 0;
+}
@@ -0,0 +1,301 @@
+// Benchmark suite harness: for every program of benchmarks/suite it times
+// the transpiler, the C++ compile and the program itself separately,
+// repeating each, and writes the median and p95 of every stage as JSON.
+// Given a baseline (the JSON of an earlier run) it prints the change per
+// benchmark and fails on a run-time regression or a changed output; a
+// baseline recorded with another --cxx is refused.
+// Build & run: make bench-suite [RUNS=5] [BASELINE=file]
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <spawn.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <vector>
+
+extern char** environ;
+
+struct Options {
+    std::string compiler = "build/uas";
+    std::string cxx = "g++";
+    std::string flags = "-std=c++17 -O3 -pthread -Icpp/runtime";
+    std::string work = "build/suite";
+    std::string json;
+    std::string baseline;
+    int runs = 5;
+    int compileRuns = 1;
+    double tolerance = 10; // percent
+    bool gateAll = false;
+    std::vector<std::string> programs;
+};
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: bench_suite [--runs N] [--compile-runs N] [--compiler build/uas] [--cxx g++] [--flags \"...\"]\n"
+            "                   [--work dir] [--json out.json] [--baseline old.json] [--tolerance pct] [--gate-all]\n"
+            "                   program.uas...\n"
+            "--gate-all: a slower transpile or compile also fails, not only a slower run\n");
+}
+
+static std::vector<std::string> words(const std::string& s) {
+    std::vector<std::string> out;
+    size_t i = 0;
+    while (i < s.size()) {
+        while (i < s.size() && s[i] == ' ') i++;
+        size_t start = i;
+        while (i < s.size() && s[i] != ' ') i++;
+        if (i > start) out.push_back(s.substr(start, i - start));
+    }
+    return out;
+}
+
+// Runs `args` with stdout sent to `out`; returns the wall time in ms, or a
+// negative number if it could not start or exited with an error.
+static double timed(const std::vector<std::string>& args, const std::string& out) {
+    std::vector<char*> argv;
+    for (const auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    int status = -1;
+    bool started = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0;
+    if (started) waitpid(pid, &status, 0);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    posix_spawn_file_actions_destroy(&actions);
+    if (!started || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return ms;
+}
+
+static std::string fileHash(const std::string& path) {
+    uint64_t h = 1469598103934665603ULL;
+    if (FILE* f = fopen(path.c_str(), "rb")) {
+        char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                h ^= (unsigned char)buf[i];
+                h *= 1099511628211ULL;
+            }
+        }
+        fclose(f);
+    }
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)h);
+    return hex;
+}
+
+struct Stat {
+    double median = 0;
+    double p95 = 0;
+};
+
+// p95 by nearest rank, so with fewer than 20 samples it is the slowest.
+static Stat summarize(std::vector<double> samples) {
+    Stat s;
+    if (samples.empty()) return s;
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    s.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    s.p95 = samples[(size_t)std::ceil(0.95 * n) - 1];
+    return s;
+}
+
+static const char* const STAGES[] = {"transpile_ms", "compile_ms", "run_ms"};
+
+struct Result {
+    std::string name;
+    std::string output; // hash of what the program printed
+    Stat stages[3];
+};
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static bool measure(const Options& o, const std::string& program, Result& r) {
+    r.name = baseName(program);
+    std::string cpp = o.work + "/" + r.name + ".cpp";
+    std::string binary = o.work + "/" + r.name;
+    std::string out = o.work + "/" + r.name + ".out";
+    std::vector<double> samples[3];
+
+    for (int i = 0; i < o.runs; i++) {
+        double ms = timed({o.compiler, program}, cpp);
+        if (ms < 0) return fprintf(stderr, "%s: transpile failed\n", program.c_str()), false;
+        samples[0].push_back(ms);
+    }
+    std::vector<std::string> compile = {o.cxx};
+    for (const auto& f : words(o.flags)) compile.push_back(f);
+    compile.insert(compile.end(), {"-o", binary, cpp});
+    for (int i = 0; i < o.compileRuns; i++) {
+        double ms = timed(compile, "/dev/null");
+        if (ms < 0) return fprintf(stderr, "%s: compile failed\n", program.c_str()), false;
+        samples[1].push_back(ms);
+    }
+    for (int i = 0; i < o.runs; i++) {
+        double ms = timed({binary}, out);
+        if (ms < 0) return fprintf(stderr, "%s: run failed\n", program.c_str()), false;
+        samples[2].push_back(ms);
+        if (i == 0) r.output = fileHash(out);
+    }
+    for (int s = 0; s < 3; s++) r.stages[s] = summarize(samples[s]);
+    return true;
+}
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// One benchmark per line, which is all readBaseline() relies on.
+static void writeJson(const Options& o, const std::vector<Result>& results, FILE* f) {
+    fprintf(f, "{\n  \"compiler\": %s,\n  \"cxx\": %s,\n  \"flags\": %s,\n  \"runs\": %d,\n  \"benchmarks\": [\n",
+            jsonString(o.compiler).c_str(), jsonString(o.cxx).c_str(), jsonString(o.flags).c_str(), o.runs);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(f, "    {\"name\": %s, \"output\": \"%s\"", jsonString(r.name).c_str(), r.output.c_str());
+        for (int s = 0; s < 3; s++) {
+            fprintf(f, ", \"%s\": {\"median\": %.3f, \"p95\": %.3f}", STAGES[s], r.stages[s].median, r.stages[s].p95);
+        }
+        fprintf(f, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+static std::string field(const std::string& line, const std::string& key) {
+    size_t at = line.find("\"" + key + "\": \"");
+    if (at == std::string::npos) return "";
+    at += key.size() + 5;
+    return line.substr(at, line.find('"', at) - at);
+}
+
+// The results by name, and in `cxx` the compiler they were recorded with.
+static std::map<std::string, Result> readBaseline(const std::string& path, std::string& cxx) {
+    std::map<std::string, Result> out;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return out;
+    char buf[4096];
+    while (fgets(buf, sizeof(buf), f)) {
+        std::string line = buf;
+        if (cxx.empty()) cxx = field(line, "cxx");
+        Result r;
+        r.name = field(line, "name");
+        if (r.name.empty()) continue;
+        r.output = field(line, "output");
+        for (int s = 0; s < 3; s++) {
+            size_t at = line.find(std::string("\"") + STAGES[s] + "\": {\"median\": ");
+            if (at != std::string::npos) {
+                sscanf(line.c_str() + at + strlen(STAGES[s]) + 15, "%lf, \"p95\": %lf", &r.stages[s].median, &r.stages[s].p95);
+            }
+        }
+        out[r.name] = r;
+    }
+    fclose(f);
+    return out;
+}
+
+static double change(double now, double before) { return before > 0 ? (now / before - 1) * 100 : 0; }
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool value = i + 1 < argc;
+        if (a == "--runs" && value) o.runs = atoi(argv[++i]);
+        else if (a == "--compile-runs" && value) o.compileRuns = atoi(argv[++i]);
+        else if (a == "--compiler" && value) o.compiler = argv[++i];
+        else if (a == "--cxx" && value) o.cxx = argv[++i];
+        else if (a == "--flags" && value) o.flags = argv[++i];
+        else if (a == "--work" && value) o.work = argv[++i];
+        else if (a == "--json" && value) o.json = argv[++i];
+        else if (a == "--baseline" && value) o.baseline = argv[++i];
+        else if (a == "--tolerance" && value) o.tolerance = atof(argv[++i]);
+        else if (a == "--gate-all") o.gateAll = true;
+        else if (a.compare(0, 2, "--") == 0) return usage(), 1;
+        else o.programs.push_back(a);
+    }
+    if (o.programs.empty() || o.runs < 1 || o.compileRuns < 1) return usage(), 1;
+    if (mkdir(o.work.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s\n", o.work.c_str());
+        return 1;
+    }
+
+    std::map<std::string, Result> baseline;
+    if (!o.baseline.empty()) {
+        std::string cxx;
+        baseline = readBaseline(o.baseline, cxx);
+        if (baseline.empty()) fprintf(stderr, "No results in baseline %s; comparing nothing\n", o.baseline.c_str());
+        // Times from another compiler say nothing about this tree.
+        else if (cxx != o.cxx) {
+            fprintf(stderr, "Baseline %s was recorded with --cxx %s, not %s; use the same compiler or record a new baseline\n",
+                    o.baseline.c_str(), cxx.empty() ? "(unknown)" : cxx.c_str(), o.cxx.c_str());
+            return 1;
+        }
+    }
+
+    printf("%d run(s) per program, %d compile(s); times in ms, median / p95\n", o.runs, o.compileRuns);
+    printf("%-16s %19s %19s %19s", "benchmark", "transpile", "compile", "run");
+    printf(baseline.empty() ? "\n" : "   run vs baseline\n");
+    std::vector<Result> results;
+    bool failed = false;
+    for (const auto& program : o.programs) {
+        Result r;
+        if (!measure(o, program, r)) {
+            failed = true;
+            continue;
+        }
+        printf("%-16s", r.name.c_str());
+        for (int s = 0; s < 3; s++) printf(" %9.1f / %7.1f", r.stages[s].median, r.stages[s].p95);
+        auto it = baseline.find(r.name);
+        if (it != baseline.end()) {
+            const Result& b = it->second;
+            printf("   %+6.1f%%", change(r.stages[2].median, b.stages[2].median));
+            // Slower by more than the tolerance and by more than a
+            // millisecond, so the shortest stages do not fail on noise.
+            for (int s = o.gateAll ? 0 : 2; s < 3; s++) {
+                double now = r.stages[s].median, before = b.stages[s].median;
+                if (before > 0 && now > before * (1 + o.tolerance / 100) && now - before > 1) {
+                    printf("  %s slower (%+.1f%%)", STAGES[s], change(now, before));
+                    failed = true;
+                }
+            }
+            if (!b.output.empty() && b.output != r.output) {
+                printf("  output changed");
+                failed = true;
+            }
+        }
+        printf("\n");
+        results.push_back(r);
+    }
+
+    if (!o.json.empty()) {
+        FILE* f = fopen(o.json.c_str(), "w");
+        if (!f) {
+            fprintf(stderr, "Could not write %s\n", o.json.c_str());
+            return 1;
+        }
+        writeJson(o, results, f);
+        fclose(f);
+        printf("Results: %s\n", o.json.c_str());
+    }
+    if (failed) printf("FAILED\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef UAS_HASH_H
+#define UAS_HASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Hashes for Словник keys. Every spelling of the same key hashes the same
+// way: a std::string and a Value holding that text, an int64_t and the
+// same number as a double inside a Value are converted before hashing.
+
+// 64x64 -> 128 multiply, folded: a cheap mixer with full avalanche.
+inline uint64_t mixHash(uint64_t x) {
+    __uint128_t r = (__uint128_t)x * 0x9E3779B97F4A7C15ULL;
+    return (uint64_t)(r >> 64) ^ (uint64_t)r;
+}
+
+// Eight bytes per step, so long keys do not cost a multiply per byte.
+inline uint64_t hashBytes(const char* p, size_t n) {
+    uint64_t h = 0x243F6A8885A308D3ULL ^ n;
+    while (n >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, p, 8);
+        h = mixHash(h ^ chunk);
+        p += 8;
+        n -= 8;
+    }
+    // The last 0-7 bytes are read as two overlapping words, not copied
+    // byte by byte: a variable-length copy stalls on store forwarding.
+    uint64_t tail = 0;
+    if (n >= 4) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + n - 4, 4);
+        tail = (uint64_t)lo << 32 | hi;
+    } else if (n > 0) {
+        tail = (uint64_t)(unsigned char)p[0] << 16 | (uint64_t)(unsigned char)p[n >> 1] << 8 | (unsigned char)p[n - 1];
+    }
+    return mixHash(h ^ tail);
+}
+
+inline uint64_t hashKey(int64_t i) { return mixHash((uint64_t)i); }
+inline uint64_t hashKey(double d) {
+    if (d == 0) d = 0; // -0.0 and 0.0 are the same key
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return mixHash(bits);
+}
+inline uint64_t hashKey(bool b) { return mixHash(b ? 2 : 1); }
+inline uint64_t hashKey(const std::string& s) { return hashBytes(s.data(), s.size()); }
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef UAS_LIST_H
+#define UAS_LIST_H
+
+// Included by runtime.h once Value is complete.
+
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+// Contiguous payload shared by every handle to the same list.
+template <typename T>
+struct ListRep {
+    size_t refs;
+    std::vector<T> items;
+};
+
+[[noreturn]] inline void indexError(int64_t i, size_t size) {
+    char message[96];
+    snprintf(message, sizeof(message), "list index %lld out of range for length %zu", (long long)i, size);
+    runtimeError(message);
+}
+
+// Index operands as the generated code spells them.
+inline int64_t listPosition(long long i) { return i; }
+inline int64_t listPosition(long i) { return i; }
+inline int64_t listPosition(int i) { return i; }
+inline int64_t listPosition(double d) {
+    if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0) || d != std::trunc(d)) {
+        runtimeError("list index is not an integer");
+    }
+    return (int64_t)d;
+}
+inline int64_t listPosition(const Value& v) {
+    if (v.type != VAL_NUMBER) runtimeError("list index is not a number");
+    return listPosition(v.numberVal);
+}
+
+// Typed element from a dynamic one, for lists filled from Value code.
+inline void unbox(const Value& v, Value& out) { out = v; }
+inline void unbox(const Value& v, double& out) {
+    if (v.type != VAL_NUMBER) runtimeError("expected a number");
+    out = v.numberVal;
+}
+inline void unbox(const Value& v, int64_t& out) {
+    if (v.type != VAL_NUMBER || v.numberVal != std::trunc(v.numberVal)) runtimeError("expected an integer");
+    out = (int64_t)v.numberVal;
+}
+inline void unbox(const Value& v, bool& out) {
+    if (v.type != VAL_BOOL) runtimeError("expected a bool");
+    out = v.boolVal;
+}
+inline void unbox(const Value& v, std::string& out) {
+    if (v.type != VAL_STRING) runtimeError("expected a string");
+    out = v.stringVal();
+}
+template <typename T>
+inline void unbox(const Value& v, List<T>& out) { out = List<T>(v); }
+
+template <typename T, typename V>
+inline T element(V&& v) {
+    if constexpr (std::is_same<std::decay_t<V>, Value>::value && !std::is_same<T, Value>::value) {
+        T out;
+        unbox(v, out);
+        return out;
+    } else {
+        return T(std::forward<V>(v));
+    }
+}
+
+// `Список<T>`: a refcounted handle to contiguous storage. Copies share the
+// elements, as assigning a list does in the language; converting to a list
+// of another element type (or out of a dynamic Value) copies them. Lists
+// only ever grow, so an index below a size read earlier stays valid.
+template <typename T>
+struct List {
+    ListRep<T>* rep;
+
+    List() : rep(new ListRep<T>{1, {}}) {}
+    explicit List(ListRep<T>* r) : rep(r) { retainRef(rep->refs); }
+    List(const List& other) : rep(other.rep) { retainRef(rep->refs); }
+    List(List&& other) noexcept : rep(other.rep) { other.rep = nullptr; }
+    template <typename U>
+    List(const List<U>& other) : List() {
+        rep->items.reserve(other.rep->items.size());
+        for (const U& item : other.rep->items) rep->items.push_back(element<T>(item));
+    }
+    List(const Value& v);
+    List& operator=(List other) noexcept {
+        std::swap(rep, other.rep);
+        return *this;
+    }
+    ~List() { if (rep && releaseRef(rep->refs)) delete rep; }
+
+    template <typename... Items>
+    static List of(Items&&... items) {
+        List list;
+        list.rep->items.reserve(sizeof...(items));
+        (list.rep->items.push_back(element<T>(std::forward<Items>(items))), ...);
+        return list;
+    }
+
+    int64_t size() const { return (int64_t)rep->items.size(); }
+
+    template <typename I>
+    T& operator[](const I& i) const {
+        int64_t at = listPosition(i);
+        if ((uint64_t)at >= rep->items.size()) indexError(at, rep->items.size());
+        return rep->items[at];
+    }
+    // Only emitted where the transpiler has proven `i` in range.
+    T& unchecked(int64_t i) const { return rep->items[i]; }
+
+    template <typename V>
+    void push(V&& v) const { rep->items.push_back(element<T>(std::forward<V>(v))); }
+
+    T* data() const { return rep->items.data(); }
+    T* begin() const { return rep->items.data(); }
+    T* end() const { return rep->items.data() + rep->items.size(); }
+};
+
+template <typename T>
+inline List<T>::List(const Value& v) {
+    if (v.type != VAL_LIST) runtimeError("expected a list");
+    if constexpr (std::is_same<T, Value>::value) {
+        rep = v.listRep;
+        retainRef(rep->refs);
+    } else {
+        rep = new ListRep<T>{1, {}};
+        rep->items.reserve(v.listRep->items.size());
+        for (const Value& item : v.listRep->items) rep->items.push_back(element<T>(item));
+    }
+}
+
+// A dynamic list shares a List<Value>'s elements and copies any other.
+template <typename T>
+inline Value::Value(const List<T>& list) : type(VAL_LIST) {
+    if constexpr (std::is_same<T, Value>::value) {
+        listRep = list.rep;
+        retainRef(listRep->refs);
+    } else {
+        List<Value> copy(list);
+        listRep = copy.rep;
+        copy.rep = nullptr;
+    }
+}
+
+template <typename T>
+inline int64_t length(const List<T>& list) { return list.size(); }
+
+// Code points, not bytes.
+inline int64_t length(const std::string& s) {
+    int64_t n = 0;
+    for (unsigned char c : s) n += (c & 0xC0) != 0x80;
+    return n;
+}
+
+template <typename T, typename V>
+inline void push(const List<T>& list, V&& v) { list.push(std::forward<V>(v)); }
+
+template <typename V>
+inline void push(const Value& list, V&& v) {
+    if (list.type != VAL_LIST) runtimeError("push onto a value that is not a list");
+    list.listRep->items.push_back(Value(std::forward<V>(v)));
+}
+
+#endif
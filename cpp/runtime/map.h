@@ -0,0 +1,293 @@
+#ifndef UAS_MAP_H
+#define UAS_MAP_H
+
+// Included by runtime.h after list.h.
+
+#include <utility>
+#include <vector>
+
+inline uint64_t hashKey(const Value& v) {
+    switch (v.type) {
+        case VAL_NUMBER: return hashKey(v.numberVal);
+        case VAL_BOOL: return hashKey(v.boolVal);
+        case VAL_STRING: return v.stringRep->interned ? v.stringRep->hash : hashKey(v.stringVal());
+        case VAL_NONE: return mixHash(0);
+        default: runtimeError("lists and maps cannot be map keys");
+    }
+}
+
+inline bool keyEquals(const Value& a, const Value& b) {
+    if (a.type != b.type) return false;
+    switch (a.type) {
+        case VAL_NUMBER: return a.numberVal == b.numberVal;
+        case VAL_BOOL: return a.boolVal == b.boolVal;
+        case VAL_STRING:
+            if (a.stringRep == b.stringRep) return true;
+            if (a.stringRep->interned && b.stringRep->interned) return false;
+            return a.stringVal() == b.stringVal();
+        default: return true; // none
+    }
+}
+inline bool keyEquals(const std::string& a, const Value& b) { return a == b.stringVal(); }
+template <typename K>
+inline bool keyEquals(const K& a, const K& b) { return a == b; }
+
+template <typename K, typename V>
+struct MapEntry {
+    K key;
+    V value;
+    uint64_t hash;
+};
+
+// Robin Hood open addressing over a dense entry array. The slot array is
+// eight bytes per slot and holds no keys: a probe compares the probe
+// distance and an 8-bit fingerprint packed into one word, and touches an
+// entry only on a fingerprint hit. Entries stay in insertion order (a
+// removal shifts the later ones down, so it is linear unless it takes the
+// last entry), and a lookup stops as soon as it meets a slot closer to its
+// home than the probe is.
+template <typename K, typename V>
+struct MapRep {
+    struct Slot {
+        uint32_t distance; // (probe distance + 1) << 8 | fingerprint; 0 = empty
+        uint32_t entry;
+    };
+    static const uint32_t ONE = 1u << 8;
+    static const uint32_t NOT_FOUND = ~0u;
+
+    size_t refs;
+    std::vector<MapEntry<K, V>> entries;
+    std::vector<Slot> slots;
+    int shift = 61; // home slot = hash >> shift; 8 slots to start
+
+    explicit MapRep(size_t r) : refs(r), slots(8, Slot{0, 0}) {}
+
+    size_t mask() const { return slots.size() - 1; }
+    static uint32_t start(uint64_t hash) { return ONE | (uint32_t)(hash & 0xFF); }
+
+    template <typename Q>
+    uint32_t find(const Q& key, uint64_t hash) const {
+        uint32_t distance = start(hash);
+        size_t i = hash >> shift;
+        while (true) {
+            const Slot& s = slots[i];
+            if (s.distance == distance && keyEquals(entries[s.entry].key, key)) return s.entry;
+            if (s.distance < distance) return NOT_FOUND;
+            distance += ONE;
+            i = (i + 1) & mask();
+        }
+    }
+
+    // The slot pointing at entry `e`, which must be present.
+    size_t slotOf(uint32_t e) const {
+        size_t i = entries[e].hash >> shift;
+        while (slots[i].entry != e || slots[i].distance == 0) i = (i + 1) & mask();
+        return i;
+    }
+
+    // Takes the first slot whose resident is closer to home than we are and
+    // shifts the run after it one step further.
+    void place(uint32_t e) {
+        uint64_t hash = entries[e].hash;
+        Slot cur{start(hash), e};
+        size_t i = hash >> shift;
+        while (slots[i].distance >= cur.distance) {
+            cur.distance += ONE;
+            i = (i + 1) & mask();
+        }
+        while (slots[i].distance != 0) {
+            std::swap(cur, slots[i]);
+            cur.distance += ONE;
+            i = (i + 1) & mask();
+        }
+        slots[i] = cur;
+    }
+
+    template <typename Q>
+    V& insert(const Q& key, uint64_t hash) {
+        uint32_t e = find(key, hash);
+        if (e != NOT_FOUND) return entries[e].value;
+        entries.push_back(MapEntry<K, V>{element<K>(key), V(), hash});
+        e = (uint32_t)(entries.size() - 1);
+        // Half empty at most: short probe runs keep the loop exit predictable.
+        if (entries.size() * 2 > slots.size()) grow();
+        else place(e);
+        return entries[e].value;
+    }
+
+    void grow() {
+        slots.assign(slots.size() * 2, Slot{0, 0});
+        shift--;
+        for (uint32_t e = 0; e < entries.size(); e++) place(e);
+    }
+
+    template <typename Q>
+    bool remove(const Q& key, uint64_t hash) {
+        uint32_t e = find(key, hash);
+        if (e == NOT_FOUND) return false;
+        // Backward shift: later members of the run move one step home.
+        size_t i = slotOf(e);
+        size_t next = (i + 1) & mask();
+        while (slots[next].distance >= 2 * ONE) {
+            slots[i] = Slot{slots[next].distance - ONE, slots[next].entry};
+            i = next;
+            next = (next + 1) & mask();
+        }
+        slots[i] = Slot{0, 0};
+        if (e + 1 != entries.size()) {
+            for (Slot& s : slots) {
+                if (s.distance != 0 && s.entry > e) s.entry--;
+            }
+        }
+        entries.erase(entries.begin() + e);
+        return true;
+    }
+};
+
+// `Словник<K, V>`: a refcounted handle like List. Keys are converted to K
+// before hashing, except that string-keyed maps also take a Value holding
+// the string, so an interned literal key is never rehashed.
+template <typename K, typename V>
+struct Map {
+    MapRep<K, V>* rep;
+
+    Map() : rep(new MapRep<K, V>(1)) {}
+    explicit Map(MapRep<K, V>* r) : rep(r) { retainRef(rep->refs); }
+    Map(const Map& other) : rep(other.rep) { retainRef(rep->refs); }
+    Map(Map&& other) noexcept : rep(other.rep) { other.rep = nullptr; }
+    template <typename K2, typename V2>
+    Map(const Map<K2, V2>& other) : Map() {
+        for (const auto& e : other.rep->entries) slot(e.key) = element<V>(e.value);
+    }
+    Map(const Value& v);
+    Map& operator=(Map other) noexcept {
+        std::swap(rep, other.rep);
+        return *this;
+    }
+    ~Map() { if (rep && releaseRef(rep->refs)) delete rep; }
+
+    template <typename... Items>
+    static Map of(Items&&... items) {
+        static_assert(sizeof...(items) % 2 == 0, "keys and values alternate");
+        Map map;
+        map.fill(std::forward<Items>(items)...);
+        return map;
+    }
+
+    int64_t size() const { return (int64_t)rep->entries.size(); }
+
+    template <typename Q>
+    static decltype(auto) probe(const Q& key) {
+        if constexpr (std::is_same<K, std::string>::value &&
+                      (std::is_same<Q, std::string>::value || std::is_same<Q, Value>::value)) {
+            return (const Q&)key;
+        } else {
+            return element<K>(key);
+        }
+    }
+
+    template <typename Q>
+    bool has(const Q& key) const {
+        const auto& k = probe(key);
+        return rep->find(k, hashKey(k)) != MapRep<K, V>::NOT_FOUND;
+    }
+
+    // Reading a missing key is an error; `отримати` takes a default instead.
+    template <typename Q>
+    V& at(const Q& key) const {
+        const auto& k = probe(key);
+        uint32_t e = rep->find(k, hashKey(k));
+        if (e == MapRep<K, V>::NOT_FOUND) runtimeError(("key not found: " + toString(k)).c_str());
+        return rep->entries[e].value;
+    }
+
+    // A numeric default widens the result, as the type inference assumes:
+    // отримати(цілі, k, 0.5) is a число.
+    template <typename D>
+    using GetResult = typename std::conditional<
+        std::is_arithmetic<V>::value && std::is_arithmetic<std::decay_t<D>>::value &&
+            !std::is_same<V, bool>::value && !std::is_same<std::decay_t<D>, bool>::value,
+        std::common_type_t<V, std::decay_t<D>>, V>::type;
+
+    template <typename Q, typename D>
+    GetResult<D> get(const Q& key, D&& fallback) const {
+        const auto& k = probe(key);
+        uint32_t e = rep->find(k, hashKey(k));
+        if (e == MapRep<K, V>::NOT_FOUND) return element<GetResult<D>>(std::forward<D>(fallback));
+        return rep->entries[e].value;
+    }
+
+    // The value stored under `key`, inserted as V() if it is new.
+    template <typename Q>
+    V& slot(const Q& key) const {
+        const auto& k = probe(key);
+        return rep->insert(k, hashKey(k));
+    }
+
+    template <typename Q>
+    bool remove(const Q& key) const {
+        const auto& k = probe(key);
+        return rep->remove(k, hashKey(k));
+    }
+
+    const K& keyAt(int64_t i) const { return rep->entries[i].key; }
+    const V& valueAt(int64_t i) const { return rep->entries[i].value; }
+
+private:
+    void fill() {}
+    template <typename Q, typename W, typename... Rest>
+    void fill(Q&& key, W&& value, Rest&&... rest) {
+        slot(key) = element<V>(std::forward<W>(value));
+        fill(std::forward<Rest>(rest)...);
+    }
+};
+
+template <typename K, typename V>
+inline void unbox(const Value& v, Map<K, V>& out) { out = Map<K, V>(v); }
+
+template <typename K, typename V>
+inline Map<K, V>::Map(const Value& v) {
+    if (v.type != VAL_MAP) runtimeError("expected a map");
+    if constexpr (std::is_same<K, Value>::value && std::is_same<V, Value>::value) {
+        rep = v.mapRep;
+        retainRef(rep->refs);
+    } else {
+        rep = new MapRep<K, V>(1);
+        for (const auto& e : v.mapRep->entries) slot(e.key) = element<V>(e.value);
+    }
+}
+
+// A dynamic map shares a Map<Value, Value>'s entries and copies any other.
+template <typename K, typename V>
+inline Value::Value(const Map<K, V>& map) : type(VAL_MAP) {
+    if constexpr (std::is_same<K, Value>::value && std::is_same<V, Value>::value) {
+        mapRep = map.rep;
+        retainRef(mapRep->refs);
+    } else {
+        Map<Value, Value> copy(map);
+        mapRep = copy.rep;
+        copy.rep = nullptr;
+    }
+}
+
+template <typename K, typename V>
+inline int64_t length(const Map<K, V>& map) { return map.size(); }
+
+template <typename K, typename V, typename Q>
+inline bool has(const Map<K, V>& map, const Q& key) { return map.has(key); }
+
+template <typename K, typename V, typename Q, typename D>
+inline auto get(const Map<K, V>& map, const Q& key, D&& fallback) { return map.get(key, std::forward<D>(fallback)); }
+
+template <typename K, typename V, typename Q>
+inline bool removeKey(const Map<K, V>& map, const Q& key) { return map.remove(key); }
+
+template <typename K, typename V>
+inline List<K> keys(const Map<K, V>& map) {
+    List<K> out;
+    out.rep->items.reserve(map.size());
+    for (const auto& e : map.rep->entries) out.rep->items.push_back(e.key);
+    return out;
+}
+
+#endif
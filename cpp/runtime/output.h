@@ -0,0 +1,99 @@
+#ifndef UAS_OUTPUT_H
+#define UAS_OUTPUT_H
+
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+
+// Buffered stdout for print(). Each thread appends whole lines to its own
+// buffer and hands them to write(2) in bulk, so lines from different
+// threads never interleave mid-line. The buffer is flushed when full and at
+// exit; on a terminal, or with UAS_FLUSH=line, after every line instead.
+class OutputBuffer {
+    static const size_t CAPACITY = 256 * 1024;
+    std::unique_ptr<char[]> data;
+    size_t used = 0;
+    bool lineMode;
+
+public:
+    OutputBuffer() : lineMode(flushEachLine()) {}
+    ~OutputBuffer() { flush(); }
+
+    // Appends `n` bytes followed by a newline.
+    void line(const char* s, size_t n) {
+        if (n + 1 > CAPACITY) {
+            flush();
+            writeAll(s, n);
+            writeAll("\n", 1);
+            return;
+        }
+        if (used + n + 1 > CAPACITY) flush();
+        if (!data) data.reset(new char[CAPACITY]);
+        memcpy(data.get() + used, s, n);
+        used += n;
+        data[used++] = '\n';
+        if (lineMode) flush();
+    }
+
+    void flush() {
+        if (used) writeAll(data.get(), used);
+        used = 0;
+    }
+
+private:
+    static bool flushEachLine() {
+        const char* mode = getenv("UAS_FLUSH");
+        if (mode) return strcmp(mode, "line") == 0;
+        return isatty(1);
+    }
+
+    static void writeAll(const char* p, size_t n) {
+        while (n) {
+            ssize_t written = ::write(1, p, n);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            p += written;
+            n -= written;
+        }
+    }
+};
+
+inline OutputBuffer& output() {
+    static thread_local OutputBuffer buffer;
+    return buffer;
+}
+
+// Aborts the program: what was printed so far is flushed first, so the
+// message follows the output it relates to.
+[[noreturn]] inline void runtimeError(const char* message) {
+    output().flush();
+    const char prefix[] = "Runtime error: ";
+    ssize_t ignored = ::write(2, prefix, sizeof(prefix) - 1);
+    ignored = ::write(2, message, strlen(message));
+    ignored = ::write(2, "\n", 1);
+    (void)ignored;
+    exit(1);
+}
+
+// The one spelling of a number, shared by print() and string conversion:
+// integral values without a fraction, anything else as the shortest text
+// that reads back to the same double. Returns the length written to `out`.
+inline size_t formatNumber(double d, char (&out)[32]) {
+    if (d > -9223372036854775808.0 && d < 9223372036854775808.0 && d == std::trunc(d)) {
+        return std::to_chars(out, out + sizeof(out), (int64_t)d).ptr - out;
+    }
+    return std::to_chars(out, out + sizeof(out), d).ptr - out;
+}
+
+inline size_t formatNumber(int64_t i, char (&out)[32]) {
+    return std::to_chars(out, out + sizeof(out), i).ptr - out;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef UAS_PROFILE_H
+#define UAS_PROFILE_H
+
+// Included after runtime.h by programs built with --profile only.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// `--profile`: every function and method opens a ProfileScope. Each
+// thread records its calls in a call tree of its own, so entering a
+// function is a lookup among the current node's children and leaving it
+// adds the elapsed ticks to that node: no locks and no shared writes.
+// At exit the trees are merged into a flat profile on stderr and a
+// collapsed-stack file for flamegraph.pl (uas-profile.folded, or
+// $UAS_PROFILE).
+
+inline uint64_t profileTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct ProfileNode {
+    uint32_t function;
+    uint32_t parent;
+    uint64_t calls;
+    uint64_t ticks; // inclusive
+    std::vector<uint32_t> children;
+};
+
+struct ProfileThread {
+    std::vector<ProfileNode> nodes{ProfileNode{~0u, 0, 0, 0, {}}}; // nodes[0] is the root
+    uint32_t current = 0;
+
+    uint32_t enter(uint32_t function) {
+        for (uint32_t c : nodes[current].children) {
+            if (nodes[c].function == function) return current = c;
+        }
+        uint32_t c = (uint32_t)nodes.size();
+        nodes.push_back(ProfileNode{function, current, 0, 0, {}});
+        nodes[current].children.push_back(c);
+        return current = c;
+    }
+};
+
+struct ProfileState {
+    std::mutex lock; // taken when a function or thread registers, never per call
+    std::vector<std::string> functions;
+    std::vector<ProfileThread*> threads; // never freed: workers outlive main
+    uint64_t startTicks;
+    std::chrono::steady_clock::time_point start;
+};
+inline ProfileState& profileState = *new ProfileState();
+
+inline ProfileThread& profileThread() {
+    static thread_local ProfileThread* t = [] {
+        ProfileThread* made = new ProfileThread();
+        std::lock_guard<std::mutex> guard(profileState.lock);
+        profileState.threads.push_back(made);
+        return made;
+    }();
+    return *t;
+}
+
+struct ProfileScope {
+    ProfileThread& thread;
+    uint32_t node;
+    uint64_t start;
+
+    explicit ProfileScope(uint32_t function) : thread(profileThread()), node(thread.enter(function)), start(profileTicks()) {}
+    ProfileScope(const ProfileScope&) = delete;
+    ~ProfileScope() {
+        ProfileNode& n = thread.nodes[node];
+        n.ticks += profileTicks() - start;
+        n.calls++;
+        thread.current = n.parent;
+    }
+};
+
+inline void profileReport();
+
+// Called once per instrumented function while the program starts. A
+// method of a @soa class is emitted twice, and both count as one.
+inline uint32_t profileFunction(const char* name) {
+    std::lock_guard<std::mutex> guard(profileState.lock);
+    if (profileState.functions.empty()) {
+        profileState.startTicks = profileTicks();
+        profileState.start = std::chrono::steady_clock::now();
+        atexit(profileReport);
+    }
+    for (size_t i = 0; i < profileState.functions.size(); i++) {
+        if (profileState.functions[i] == name) return (uint32_t)i;
+    }
+    profileState.functions.push_back(name);
+    return (uint32_t)(profileState.functions.size() - 1);
+}
+
+// Calls, inclusive time counted once per outermost frame (so recursion is
+// not counted twice) and self time, per function.
+struct ProfileTotals {
+    uint64_t calls = 0;
+    uint64_t ticks = 0;
+    uint64_t self = 0;
+};
+
+inline void profileCollect(const ProfileThread& t, uint32_t node, std::vector<uint32_t>& stack,
+                           std::vector<ProfileTotals>& totals, std::vector<uint32_t>& active, FILE* folded) {
+    const ProfileNode& n = t.nodes[node];
+    uint64_t children = 0;
+    for (uint32_t c : n.children) children += t.nodes[c].ticks;
+    uint64_t self = n.ticks > children ? n.ticks - children : 0;
+    ProfileTotals& f = totals[n.function];
+    f.calls += n.calls;
+    f.self += self;
+    if (active[n.function]++ == 0) f.ticks += n.ticks;
+    stack.push_back(n.function);
+    if (folded && self > 0) {
+        for (size_t i = 0; i < stack.size(); i++) {
+            fprintf(folded, "%s%s", i > 0 ? ";" : "", profileState.functions[stack[i]].c_str());
+        }
+        fprintf(folded, " %llu\n", (unsigned long long)self);
+    }
+    for (uint32_t c : n.children) profileCollect(t, c, stack, totals, active, folded);
+    stack.pop_back();
+    active[n.function]--;
+}
+
+inline void profileReport() {
+    std::lock_guard<std::mutex> guard(profileState.lock);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - profileState.start).count();
+    uint64_t elapsed = profileTicks() - profileState.startTicks;
+    double msPerTick = elapsed > 0 ? seconds * 1000.0 / (double)elapsed : 0.0;
+
+    const char* path = getenv("UAS_PROFILE");
+    if (!path || !*path) path = "uas-profile.folded";
+    FILE* folded = fopen(path, "w");
+    size_t n = profileState.functions.size();
+    std::vector<ProfileTotals> totals(n);
+    std::vector<uint32_t> active(n, 0);
+    std::vector<uint32_t> stack;
+    for (const ProfileThread* t : profileState.threads) {
+        for (uint32_t c : t->nodes[0].children) profileCollect(*t, c, stack, totals, active, folded);
+    }
+    if (folded) fclose(folded);
+
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < n; i++) {
+        if (totals[i].calls > 0) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return totals[a].self > totals[b].self; });
+    fprintf(stderr, "\nProfile: %.3f s, %zu thread(s)\n", seconds, profileState.threads.size());
+    fprintf(stderr, "%12s %12s %12s  %s\n", "calls", "total ms", "self ms", "function");
+    for (uint32_t i : order) {
+        fprintf(stderr, "%12llu %12.3f %12.3f  %s\n", (unsigned long long)totals[i].calls,
+                totals[i].ticks * msPerTick, totals[i].self * msPerTick, profileState.functions[i].c_str());
+    }
+    if (folded) fprintf(stderr, "Collapsed stacks (in ticks): %s, for flamegraph.pl\n", path);
+}
+
+#endif
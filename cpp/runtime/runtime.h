@@ -2,99 +2,474 @@
 #ifndef RUNTIME_H
 #define RUNTIME_H
 
-#include <iostream>
 #include <string>
+#include <string_view>
 #include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
 #include <variant>
 #include <vector>
+#include "hash.h"
+#include "output.h"
 
 // Minimal Runtime for Transpiled Code
 
-enum ValueType { VAL_NONE, VAL_BOOL, VAL_NUMBER, VAL_STRING };
+enum ValueType : uint8_t { VAL_NONE, VAL_BOOL, VAL_NUMBER, VAL_STRING, VAL_LIST, VAL_MAP, VAL_CHANNEL };
 
+// Handles are counted with plain increments until the first task is
+// spawned (tasks.h); from then on any thread may copy or drop one, so the
+// counts become atomic. The flag is set before the first worker starts and
+// never cleared, so reading it needs no synchronization.
+inline bool tasksStarted = false;
+
+inline void retainRef(size_t& refs) {
+    if (tasksStarted) __atomic_add_fetch(&refs, 1, __ATOMIC_RELAXED);
+    else refs++;
+}
+
+// True when the last reference is gone.
+inline bool releaseRef(size_t& refs) {
+    if (tasksStarted) return __atomic_sub_fetch(&refs, 1, __ATOMIC_ACQ_REL) == 0;
+    return --refs == 0;
+}
+
+// Immutable string payload shared by every Value copy that refers to it.
+// An interned rep is the only one with its text, so two interned reps are
+// equal exactly when they are the same pointer. Interned reps also carry
+// their map-key hash, computed once when the literal is interned.
+struct StringRep {
+    size_t refs;
+    bool interned;
+    std::string data;
+    uint64_t hash;
+    explicit StringRep(std::string s, bool in = false)
+        : refs(1), interned(in), data(std::move(s)), hash(in ? hashKey(data) : 0) {}
+};
+
+template <typename T> struct ListRep;
+template <typename T> struct List;
+template <typename K, typename V> struct MapRep;
+template <typename K, typename V> struct Map;
+template <typename T> struct Channel;
+struct ChannelBase;
+
+// 16-byte tagged value: numbers and bools live inline, strings, lists,
+// maps and channels sit behind a refcounted handle, so numeric operators
+// never touch the allocator.
 struct Value {
     ValueType type;
-    double numberVal;
-    bool boolVal;
-    std::string stringVal;
-    
-    Value() : type(VAL_NONE), numberVal(0), boolVal(false) {}
-    Value(double d) : type(VAL_NUMBER), numberVal(d), boolVal(false) {}
-    Value(int i) : type(VAL_NUMBER), numberVal((double)i), boolVal(false) {}
-    Value(long l) : type(VAL_NUMBER), numberVal((double)l), boolVal(false) {} // Explicit long support
-    Value(bool b) : type(VAL_BOOL), numberVal(0), boolVal(b) {}
-    Value(std::string s) : type(VAL_STRING), numberVal(0), boolVal(false), stringVal(s) {}
-    Value(const char* s) : type(VAL_STRING), numberVal(0), boolVal(false), stringVal(s) {}
-    
-    // ... operators ...
-    Value operator+(const Value& other) const {
-        if (type == VAL_STRING || other.type == VAL_STRING) {
-            std::string s1 = (type == VAL_STRING) ? stringVal : (type == VAL_NUMBER ? std::to_string(numberVal) : (boolVal ? "true" : "false"));
-            std::string s2 = (other.type == VAL_STRING) ? other.stringVal : (other.type == VAL_NUMBER ? std::to_string(other.numberVal) : (other.boolVal ? "true" : "false"));
-            // Clean up number string (remove trailing zeros?)
-            return Value(s1 + s2);
+    union {
+        double numberVal;
+        bool boolVal;
+        StringRep* stringRep;
+        ListRep<Value>* listRep;
+        MapRep<Value, Value>* mapRep;
+        ChannelBase* channelRep;
+        uint64_t bits;
+    };
+
+    Value() : type(VAL_NONE), bits(0) {}
+    Value(double d) : type(VAL_NUMBER), numberVal(d) {}
+    Value(int i) : type(VAL_NUMBER), numberVal((double)i) {}
+    Value(long l) : type(VAL_NUMBER), numberVal((double)l) {} // Explicit long support
+    Value(long long l) : type(VAL_NUMBER), numberVal((double)l) {}
+    Value(bool b) : type(VAL_BOOL), bits(0) { boolVal = b; }
+    Value(std::string s) : type(VAL_STRING), stringRep(new StringRep(std::move(s))) {}
+    Value(const char* s) : type(VAL_STRING), stringRep(new StringRep(s)) {}
+    explicit Value(StringRep* rep) : type(VAL_STRING), stringRep(rep) { retainRef(rep->refs); }
+    template <typename T>
+    Value(const List<T>& list); // list.h
+    template <typename K, typename V>
+    Value(const Map<K, V>& map); // map.h
+    template <typename T>
+    Value(const Channel<T>& channel); // tasks.h
+
+    Value(const Value& other) : type(other.type), bits(other.bits) { retain(); }
+    // Moving hands the handle over without touching its count.
+    Value(Value&& other) noexcept : type(other.type), bits(other.bits) {
+        other.type = VAL_NONE;
+        other.bits = 0;
+    }
+    Value& operator=(const Value& other) {
+        if (this != &other) {
+            other.retain();
+            release();
+            type = other.type;
+            bits = other.bits;
         }
-        if (type == VAL_NUMBER && other.type == VAL_NUMBER) return Value(numberVal + other.numberVal);
-        return Value(0.0);
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            type = other.type;
+            bits = other.bits;
+            other.type = VAL_NONE;
+            other.bits = 0;
+        }
+        return *this;
+    }
+    ~Value() { release(); }
+
+    const std::string& stringVal() const { return stringRep->data; }
+
+private:
+    void retain() const; // list.h
+    void release();
+};
+
+static_assert(sizeof(Value) == 16, "Value must stay a 16-byte tagged union");
+
+inline std::string toString(const Value& v);
+
+// What a Value holding a channel sees of it, whatever its element type;
+// Channel<T> in tasks.h implements it.
+struct ChannelBase {
+    size_t refs = 1;
+    virtual ~ChannelBase() {}
+    virtual void sendValue(const Value& v) = 0;
+    virtual Value receiveValue() = 0;
+};
+
+#include "list.h"
+#include "map.h"
+#include "tasks.h"
+
+inline void Value::retain() const {
+    if (type == VAL_STRING) retainRef(stringRep->refs);
+    else if (type == VAL_LIST) retainRef(listRep->refs);
+    else if (type == VAL_MAP) retainRef(mapRep->refs);
+    else if (type == VAL_CHANNEL) retainRef(channelRep->refs);
+}
+
+inline void Value::release() {
+    if (type == VAL_STRING) { if (releaseRef(stringRep->refs)) delete stringRep; }
+    else if (type == VAL_LIST) { if (releaseRef(listRep->refs)) delete listRep; }
+    else if (type == VAL_MAP) { if (releaseRef(mapRep->refs)) delete mapRep; }
+    else if (type == VAL_CHANNEL) { if (releaseRef(channelRep->refs)) delete channelRep; }
+}
+
+// Dynamic containers: the same builtins on a Value holding a list or a map.
+
+template <typename I>
+inline Value& elementAt(const Value& v, const I& i) {
+    if (v.type == VAL_LIST) return List<Value>(v.listRep)[i];
+    if (v.type == VAL_MAP) return Map<Value, Value>(v.mapRep).at(i);
+    runtimeError("indexing a value that is neither a list nor a map");
+}
+
+// The target of `v[i] = x`: a list element must exist, a map key is added.
+template <typename I>
+inline Value& storeAt(const Value& v, const I& i) {
+    if (v.type == VAL_MAP) return Map<Value, Value>(v.mapRep).slot(i);
+    return elementAt(v, i);
+}
+
+inline int64_t length(const Value& v) {
+    if (v.type == VAL_LIST) return (int64_t)v.listRep->items.size();
+    if (v.type == VAL_MAP) return (int64_t)v.mapRep->entries.size();
+    if (v.type == VAL_STRING) return length(v.stringVal());
+    runtimeError("length of a value that is not a list, map or string");
+}
+
+inline const Map<Value, Value> asMap(const Value& v, const char* what) {
+    if (v.type != VAL_MAP) runtimeError(what);
+    return Map<Value, Value>(v.mapRep);
+}
+
+template <typename Q>
+inline bool has(const Value& map, const Q& key) { return asMap(map, "has() needs a map").has(key); }
+
+template <typename Q, typename D>
+inline Value get(const Value& map, const Q& key, D&& fallback) {
+    return asMap(map, "get() needs a map").get(key, std::forward<D>(fallback));
+}
+
+template <typename Q>
+inline bool removeKey(const Value& map, const Q& key) { return asMap(map, "remove() needs a map").remove(key); }
+
+inline List<Value> keys(const Value& map) { return List<Value>(keys(asMap(map, "keys() needs a map"))); }
+
+// What `для x в v` walks: a list's elements or a map's keys.
+inline List<Value> iterationList(const Value& v) {
+    if (v.type == VAL_MAP) return keys(v);
+    return List<Value>(v);
+}
+
+// String literals are interned once, during static initialization of the
+// generated program; the table keeps a reference so they are never freed.
+// After startup the table is only read, which is safe from any thread.
+inline std::unordered_map<std::string_view, StringRep*>& internTable() {
+    static std::unordered_map<std::string_view, StringRep*> table;
+    return table;
+}
+
+inline Value intern(std::string_view s) {
+    auto& table = internTable();
+    auto it = table.find(s);
+    if (it == table.end()) {
+        StringRep* rep = new StringRep(std::string(s), true);
+        it = table.emplace(rep->data, rep).first;
     }
-    
-    Value operator-(const Value& other) const { return Value(numberVal - other.numberVal); }
-    Value operator*(const Value& other) const { return Value(numberVal * other.numberVal); }
-    Value operator/(const Value& other) const { return Value(numberVal / other.numberVal); }
-    
-    Value operator%(const Value& other) const { 
-        return Value(fmod(numberVal, other.numberVal)); 
+    return Value(it->second);
+}
+
+template <size_t N>
+inline Value intern(const char (&s)[N]) { return intern(std::string_view(s, N - 1)); }
+
+// The interned handle for a string with a literal's text, if there is one,
+// so comparing it against literals takes a pointer compare.
+inline Value canonical(const Value& v) {
+    if (v.type != VAL_STRING || v.stringRep->interned) return v;
+    auto it = internTable().find(v.stringVal());
+    return it == internTable().end() ? v : Value(it->second);
+}
+inline Value canonical(const std::string& s) {
+    auto it = internTable().find(s);
+    return it == internTable().end() ? Value(s) : Value(it->second);
+}
+
+inline std::string toString(double d) {
+    char buf[32];
+    return std::string(buf, formatNumber(d, buf));
+}
+inline std::string toString(int i) { return std::to_string(i); }
+inline std::string toString(long l) { return std::to_string(l); }
+inline std::string toString(long long l) { return std::to_string(l); }
+inline std::string toString(bool b) { return b ? "true" : "false"; }
+inline std::string toString(const std::string& s) { return s; }
+
+// Lists print as `[1, 2.5, текст]`; nested lists the same way.
+template <typename T>
+inline std::string toString(const List<T>& list) {
+    std::string out = "[";
+    for (int64_t i = 0; i < list.size(); i++) {
+        if (i > 0) out += ", ";
+        out += toString(list.unchecked(i));
     }
-    
-    // Support ** as ^ operator in generated code
-    Value operator^(const Value& other) const { return Value(pow(numberVal, other.numberVal)); }
-
-    Value operator<(const Value& other) const { return Value(numberVal < other.numberVal); }
-    Value operator>(const Value& other) const { return Value(numberVal > other.numberVal); }
-    Value operator<=(const Value& other) const { return Value(numberVal <= other.numberVal); }
-    Value operator>=(const Value& other) const { return Value(numberVal >= other.numberVal); }
-    
-    Value operator==(const Value& other) const {
-        if (type != other.type) return Value(false);
-        if (type == VAL_NUMBER) return Value(numberVal == other.numberVal);
-        if (type == VAL_BOOL) return Value(boolVal == other.boolVal);
-        if (type == VAL_STRING) return Value(stringVal == other.stringVal);
-        if (type == VAL_NONE && other.type == VAL_NONE) return Value(true);
-        return Value(false);
+    return out + "]";
+}
+
+// Maps print as `{ключ: 1, інший: 2}`, in insertion order.
+template <typename K, typename V>
+inline std::string toString(const Map<K, V>& map) {
+    std::string out = "{";
+    for (int64_t i = 0; i < map.size(); i++) {
+        if (i > 0) out += ", ";
+        out += toString(map.keyAt(i));
+        out += ": ";
+        out += toString(map.valueAt(i));
     }
+    return out + "}";
+}
+
+inline std::string toString(const Value& v) {
+    if (v.type == VAL_STRING) return v.stringVal();
+    if (v.type == VAL_LIST) return toString(List<Value>(v.listRep));
+    if (v.type == VAL_MAP) return toString(Map<Value, Value>(v.mapRep));
+    if (v.type == VAL_NUMBER) return toString(v.numberVal);
+    if (v.type == VAL_BOOL) return v.boolVal ? "true" : "false";
+    if (v.type == VAL_CHANNEL) return "<channel>";
+    return "none";
+}
+
+// One operand of concat(): a view of its text, numbers formatted in place.
+struct ConcatPiece {
+    const char* data;
+    size_t size;
+    char buf[32];
+    std::string owned; // lists and maps only
+
+    ConcatPiece(const std::string& s) : data(s.data()), size(s.size()) {}
+    template <size_t N>
+    ConcatPiece(const char (&s)[N]) : data(s), size(N - 1) {}
+    ConcatPiece(double d) : data(buf), size(formatNumber(d, buf)) {}
+    ConcatPiece(long long i) : data(buf), size(formatNumber((int64_t)i, buf)) {}
+    ConcatPiece(long i) : ConcatPiece((long long)i) {}
+    ConcatPiece(int i) : ConcatPiece((long long)i) {}
+    ConcatPiece(bool b) : data(b ? "true" : "false"), size(b ? 4 : 5) {}
+    ConcatPiece(const Value& v) : data("none"), size(4) {
+        if (v.type == VAL_STRING) { data = v.stringVal().data(); size = v.stringVal().size(); }
+        else if (v.type == VAL_NUMBER) { data = buf; size = formatNumber(v.numberVal, buf); }
+        else if (v.type == VAL_BOOL) { data = v.boolVal ? "true" : "false"; size = v.boolVal ? 4 : 5; }
+        else if (v.type != VAL_NONE) { owned = toString(v); data = owned.data(); size = owned.size(); }
+    }
+    template <typename T>
+    ConcatPiece(const List<T>& list) : owned(toString(list)) { data = owned.data(); size = owned.size(); }
+    template <typename K, typename V>
+    ConcatPiece(const Map<K, V>& map) : owned(toString(map)) { data = owned.data(); size = owned.size(); }
+    ConcatPiece(const ConcatPiece&) = delete;
 };
 
-// Global operators for mixed double/Value operations (for string concat)
-inline Value operator+(double d, const Value& v) { return Value(d) + v; }
-inline Value operator+(const Value& v, double d) { return v + Value(d); }
-inline Value operator+(const std::string& s, const Value& v) { return Value(s) + v; }
-inline Value operator+(const Value& v, const std::string& s) { return v + Value(s); }
+// `a + b + c + ...` on strings: sized once, allocated once.
+template <typename... Parts>
+inline std::string concat(const Parts&... parts) {
+    const ConcatPiece pieces[] = {ConcatPiece(parts)...};
+    size_t total = 0;
+    for (const ConcatPiece& p : pieces) total += p.size;
+    std::string out;
+    out.reserve(total);
+    for (const ConcatPiece& p : pieces) out.append(p.data, p.size);
+    return out;
+}
+
+// Operators are free functions so that either side may be a plain double,
+// bool or std::string and still convert to Value.
+inline Value operator+(const Value& a, const Value& b) {
+    if (a.type == VAL_NUMBER && b.type == VAL_NUMBER) return Value(a.numberVal + b.numberVal);
+    if (a.type == VAL_STRING || b.type == VAL_STRING) return Value(concat(a, b));
+    return Value(0.0);
+}
+
+inline Value operator-(const Value& a, const Value& b) { return Value(a.numberVal - b.numberVal); }
+inline Value operator*(const Value& a, const Value& b) { return Value(a.numberVal * b.numberVal); }
+inline Value operator/(const Value& a, const Value& b) { return Value(a.numberVal / b.numberVal); }
+inline Value operator%(const Value& a, const Value& b) { return Value(fmod(a.numberVal, b.numberVal)); }
+inline Value operator-(const Value& v) { return Value(-v.numberVal); }
+
+// Support ** as ^ operator in generated code
+inline Value operator^(const Value& a, const Value& b) { return Value(pow(a.numberVal, b.numberVal)); }
+
+// Integer exponent: repeated squaring instead of pow().
+template <typename T>
+inline T ipow(T base, int64_t exp) {
+    // Only a real-valued power has a negative exponent (TypeInference
+    // makes `n ** -1` число), and there it is what pow() gives.
+    if (exp < 0) return (T)std::pow((double)base, (double)exp);
+    T result = 1;
+    while (exp) {
+        if (exp & 1) result *= base;
+        exp >>= 1;
+        if (exp) base *= base;
+    }
+    return result;
+}
+
+// `мін(a, b)` and `макс(a, b)`. Typed operands stay native: two integers
+// give an integer.
+template <typename A, typename B,
+          typename = std::enable_if_t<std::is_arithmetic<A>::value && std::is_arithmetic<B>::value>>
+inline std::common_type_t<A, B> minimum(A a, B b) { return b < a ? b : a; }
+template <typename A, typename B,
+          typename = std::enable_if_t<std::is_arithmetic<A>::value && std::is_arithmetic<B>::value>>
+inline std::common_type_t<A, B> maximum(A a, B b) { return a < b ? b : a; }
+inline Value minimum(const Value& a, const Value& b) {
+    if (a.type != VAL_NUMBER || b.type != VAL_NUMBER) runtimeError("мін expects numbers");
+    return b.numberVal < a.numberVal ? b : a;
+}
+inline Value maximum(const Value& a, const Value& b) {
+    if (a.type != VAL_NUMBER || b.type != VAL_NUMBER) runtimeError("макс expects numbers");
+    return a.numberVal < b.numberVal ? b : a;
+}
+
+// The transpiler lowers % and ** to fmod/pow, so they must accept Values too.
+inline Value fmod(const Value& a, const Value& b) { return a % b; }
+inline Value pow(const Value& a, const Value& b) { return a ^ b; }
+
+inline Value operator<(const Value& a, const Value& b) { return Value(a.numberVal < b.numberVal); }
+inline Value operator>(const Value& a, const Value& b) { return Value(a.numberVal > b.numberVal); }
+inline Value operator<=(const Value& a, const Value& b) { return Value(a.numberVal <= b.numberVal); }
+inline Value operator>=(const Value& a, const Value& b) { return Value(a.numberVal >= b.numberVal); }
+
+inline Value operator==(const Value& a, const Value& b) {
+    if (a.type != b.type) return Value(false);
+    if (a.type == VAL_NUMBER) return Value(a.numberVal == b.numberVal);
+    if (a.type == VAL_BOOL) return Value(a.boolVal == b.boolVal);
+    if (a.type == VAL_STRING) {
+        if (a.stringRep == b.stringRep) return Value(true);
+        if (a.stringRep->interned && b.stringRep->interned) return Value(false);
+        return Value(a.stringVal() == b.stringVal());
+    }
+    if (a.type == VAL_LIST) {
+        const std::vector<Value>& x = a.listRep->items;
+        const std::vector<Value>& y = b.listRep->items;
+        if (x.size() != y.size()) return Value(false);
+        for (size_t i = 0; i < x.size(); i++) {
+            if (!(x[i] == y[i]).boolVal) return Value(false);
+        }
+        return Value(true);
+    }
+    if (a.type == VAL_MAP) {
+        Map<Value, Value> x(a.mapRep), y(b.mapRep);
+        if (x.size() != y.size()) return Value(false);
+        for (int64_t i = 0; i < x.size(); i++) {
+            if (!y.has(x.keyAt(i)) || !(x.valueAt(i) == y.at(x.keyAt(i))).boolVal) return Value(false);
+        }
+        return Value(true);
+    }
+    if (a.type == VAL_CHANNEL) return Value(a.channelRep == b.channelRep);
+    return Value(true); // both none
+}
+
+// Integer key for a native switch over literal arms. Values that are not
+// integral numbers match no literal arm and fall through to the rest.
+inline bool switchKey(int64_t v, int64_t& key) { key = v; return true; }
+inline bool switchKey(double d, int64_t& key) {
+    if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0) || d != std::trunc(d)) return false;
+    key = (int64_t)d;
+    return true;
+}
+inline bool switchKey(const Value& v, int64_t& key) {
+    return v.type == VAL_NUMBER && switchKey(v.numberVal, key);
+}
 
 const Value NONE_VAL;
 
 inline bool isTruthy(bool b) { return b; }
 inline bool isTruthy(double d) { return d != 0; }
 inline bool isTruthy(int i) { return i != 0; }
+inline bool isTruthy(long l) { return l != 0; }
+inline bool isTruthy(long long l) { return l != 0; }
 inline bool isTruthy(const Value& v) {
     if (v.type == VAL_BOOL) return v.boolVal;
     if (v.type == VAL_NUMBER) return v.numberVal != 0;
-    return false;
+    if (v.type == VAL_LIST) return !v.listRep->items.empty();
+    if (v.type == VAL_MAP) return !v.mapRep->entries.empty();
+    return v.type == VAL_CHANNEL;
 }
+template <typename T>
+inline bool isTruthy(const List<T>& list) { return list.size() != 0; }
+template <typename K, typename V>
+inline bool isTruthy(const Map<K, V>& map) { return map.size() != 0; }
 
 
-void print(const Value& v) {
-    if (v.type == VAL_NUMBER) {
-        if (v.numberVal == (long)v.numberVal) std::cout << (long)v.numberVal;
-        else std::cout << v.numberVal;
-    }
-    else if (v.type == VAL_BOOL) std::cout << (v.boolVal ? "true" : "false");
-    else if (v.type == VAL_STRING) std::cout << v.stringVal;
-    else std::cout << "none";
-    std::cout << "\n";
+// One overload per static type, so typed code prints without boxing.
+inline void print(const std::string& s) { output().line(s.data(), s.size()); }
+inline void print(const char* s) { output().line(s, strlen(s)); }
+inline void print(bool b) { print(b ? "true" : "false"); }
+inline void print(double d) {
+    char buf[32];
+    output().line(buf, formatNumber(d, buf));
 }
+inline void print(long long i) {
+    char buf[32];
+    output().line(buf, formatNumber((int64_t)i, buf));
+}
+inline void print(long l) { print((long long)l); }
+inline void print(int i) { print((long long)i); }
+
+template <typename T>
+inline void print(const List<T>& list) { print(toString(list)); }
+template <typename K, typename V>
+inline void print(const Map<K, V>& map) { print(toString(map)); }
+
+inline void print(const Value& v) {
+    if (v.type == VAL_NUMBER) print(v.numberVal);
+    else if (v.type == VAL_BOOL) print(v.boolVal);
+    else if (v.type == VAL_STRING) print(v.stringVal());
+    else if (v.type != VAL_NONE) print(toString(v));
+    else print("none");
+}
+
+#include "simd.h"
+#include "signals.h"
+#include "stream.h"
+#include "soa.h"
 
 // Ukrainian aliases
-void друк(const Value& v) { print(v); }
+template <typename T>
+inline void друк(const T& v) { print(v); }
 #define повернення return
 #define якщо if
 #define інакше else
@@ -0,0 +1,246 @@
+#ifndef UAS_SIGNALS_H
+#define UAS_SIGNALS_H
+
+// Included at the end of runtime.h.
+
+#include <functional>
+#include <vector>
+
+// `сигнал`, `обчислене`, `ефект` and `пакет`: fine-grained reactivity.
+//
+// Signals, computed signals and effects are nodes of one graph, and reading
+// a node while a computed signal or effect runs records an edge to it. A
+// write only colours the graph: the writer's direct observers become DIRTY,
+// everything further down CHECK, and the effects reached are queued. The
+// queued effects then run, each first bringing its sources up to date: a
+// CHECK node asks its sources in order and recomputes only if one of them
+// actually changed. Evaluation therefore follows the graph's topological
+// order, a computed signal runs at most once per update and never sees a
+// half-updated input, and one that nothing reads is never computed. Inside
+// `пакет` the effects wait until the outermost batch ends.
+//
+// Signals belong to the thread that made them: tasks must not share them.
+struct ReactiveNode {
+    enum State : uint8_t { CLEAN, CHECK, DIRTY };
+
+    size_t refs = 1;
+    State state = CLEAN;
+    bool isEffect = false;
+    uint64_t run = 0;  // stamp of this node's current evaluation
+    uint64_t seen = 0; // stamp of the last evaluation that read this node
+    std::vector<ReactiveNode*> sources;   // retained
+    std::vector<ReactiveNode*> observers; // not retained: an observer retains us
+    size_t matched = 0;                   // sources read again, in order, this evaluation
+    std::vector<ReactiveNode*> fresh;     // sources read this evaluation beyond those
+
+    virtual ~ReactiveNode() {
+        for (ReactiveNode* s : sources) s->drop(this);
+    }
+
+    // Re-evaluates; true if the observable value changed.
+    virtual bool recompute() { return false; }
+
+    static void release(ReactiveNode* n) {
+        if (releaseRef(n->refs)) delete n;
+    }
+
+    void drop(ReactiveNode* observer) {
+        for (size_t i = 0; i < observers.size(); i++) {
+            if (observers[i] == observer) {
+                observers[i] = observers.back();
+                observers.pop_back();
+                break;
+            }
+        }
+        release(this);
+    }
+
+    void read();
+    void mark(State s);
+    void refresh();
+    void changed();
+    template <typename F>
+    void evaluate(F&& body);
+};
+
+struct ReactiveState {
+    ReactiveNode* observer = nullptr; // the node being evaluated
+    uint64_t stamp = 0;
+    int batches = 0;
+    bool flushing = false;
+    std::vector<ReactiveNode*> queue;   // effects to bring up to date
+    std::vector<ReactiveNode*> effects; // every effect, which lives as long as the program
+};
+inline ReactiveState& reactiveState = *new ReactiveState(); // never destroyed, like its effects
+
+inline void flushEffects() {
+    if (reactiveState.flushing) return;
+    reactiveState.flushing = true;
+    // Effects may write signals and queue more effects while this runs.
+    for (size_t i = 0; i < reactiveState.queue.size(); i++) reactiveState.queue[i]->refresh();
+    reactiveState.queue.clear();
+    reactiveState.flushing = false;
+}
+
+inline void ReactiveNode::read() {
+    ReactiveNode* o = reactiveState.observer;
+    if (!o || seen == o->run) return;
+    seen = o->run;
+    if (o->fresh.empty() && o->matched < o->sources.size() && o->sources[o->matched] == this) o->matched++;
+    else o->fresh.push_back(this);
+}
+
+inline void ReactiveNode::mark(State s) {
+    if (state >= s) return;
+    if (state == CLEAN && isEffect) reactiveState.queue.push_back(this);
+    state = s;
+    for (ReactiveNode* o : observers) o->mark(CHECK);
+}
+
+inline void ReactiveNode::refresh() {
+    if (state == CHECK) {
+        for (size_t i = 0; i < sources.size() && state == CHECK; i++) sources[i]->refresh();
+    }
+    if (state == DIRTY && recompute()) {
+        for (ReactiveNode* o : observers) o->state = DIRTY;
+    }
+    state = CLEAN;
+}
+
+// A signal was written.
+inline void ReactiveNode::changed() {
+    for (ReactiveNode* o : observers) o->mark(DIRTY);
+    if (reactiveState.batches == 0) flushEffects();
+}
+
+// Runs `body` with this node as the observer. Dependencies rarely change
+// between runs, so only a run that read something new relinks the graph.
+template <typename F>
+inline void ReactiveNode::evaluate(F&& body) {
+    ReactiveNode* outer = reactiveState.observer;
+    reactiveState.observer = this;
+    run = ++reactiveState.stamp;
+    matched = 0;
+    body();
+    reactiveState.observer = outer;
+    if (fresh.empty() && matched == sources.size()) return;
+    for (ReactiveNode* s : fresh) {
+        retainRef(s->refs);
+        s->observers.push_back(this);
+    }
+    for (size_t i = matched; i < sources.size(); i++) sources[i]->drop(this);
+    sources.resize(matched);
+    sources.insert(sources.end(), fresh.begin(), fresh.end());
+    fresh.clear();
+}
+
+// Whether a write leaves the value as it was, so observers need not run.
+// Lists, maps and channels compare as handles: pushing into a list held
+// by a signal is not a write to the signal.
+template <typename T>
+inline bool sameValue(const T& a, const T& b) {
+    if constexpr (std::is_arithmetic<T>::value || std::is_same<T, std::string>::value) return a == b;
+    else return a.rep == b.rep;
+}
+inline bool sameValue(const Value& a, const Value& b) {
+    if (a.type != b.type) return false;
+    if (a.type == VAL_STRING) return a.stringRep == b.stringRep || a.stringVal() == b.stringVal();
+    if (a.type == VAL_NUMBER) return a.numberVal == b.numberVal;
+    if (a.type == VAL_BOOL) return a.boolVal == b.boolVal;
+    return a.bits == b.bits;
+}
+
+template <typename T>
+struct SignalRep : ReactiveNode {
+    T value{};
+    std::function<T()> compute; // only for `обчислене`
+
+    bool recompute() override {
+        bool different = false;
+        evaluate([&] {
+            T next = compute();
+            different = !sameValue(next, value);
+            if (different) value = std::move(next);
+        });
+        return different;
+    }
+};
+
+// `Сигнал<T>`: a refcounted handle like List. A name bound to a signal
+// reads its value wherever it is used, and assigning to the name writes it.
+template <typename T>
+struct Signal {
+    SignalRep<T>* rep;
+
+    explicit Signal(T initial) : rep(new SignalRep<T>()) { rep->value = std::move(initial); }
+    Signal(const Signal& other) : rep(other.rep) { retainRef(rep->refs); }
+    Signal(Signal&& other) noexcept : rep(other.rep) { other.rep = nullptr; }
+    Signal& operator=(Signal other) noexcept {
+        std::swap(rep, other.rep);
+        return *this;
+    }
+    ~Signal() { if (rep) ReactiveNode::release(rep); }
+
+    // Not computed until the first read.
+    template <typename F>
+    static Signal computed(F&& body) {
+        Signal s{T()};
+        s.rep->compute = std::forward<F>(body);
+        s.rep->state = ReactiveNode::DIRTY;
+        return s;
+    }
+
+    const T& get() const {
+        rep->read();
+        rep->refresh();
+        return rep->value;
+    }
+
+    template <typename V>
+    const T& set(V&& v) const {
+        if (rep->compute) runtimeError("обчислене cannot be assigned");
+        T next = element<T>(std::forward<V>(v));
+        if (!sameValue(next, rep->value)) {
+            rep->value = std::move(next);
+            rep->changed();
+        }
+        return rep->value;
+    }
+};
+
+template <typename F>
+inline auto makeComputed(F&& body) {
+    return Signal<std::decay_t<decltype(body())>>::computed(std::forward<F>(body));
+}
+
+struct EffectRep : ReactiveNode {
+    std::function<void()> body;
+    bool recompute() override {
+        evaluate(body);
+        return false;
+    }
+};
+
+// `ефект(() => ...)` runs the body now, and again after every update that
+// changes something it read.
+template <typename F>
+inline Value effect(F&& body) {
+    EffectRep* e = new EffectRep();
+    e->isEffect = true;
+    e->body = std::forward<F>(body);
+    reactiveState.effects.push_back(e);
+    e->mark(ReactiveNode::DIRTY);
+    if (reactiveState.batches == 0) flushEffects();
+    return NONE_VAL;
+}
+
+// `пакет(() => ...)`: the writes inside trigger one update, at the end.
+template <typename F>
+inline Value batch(F&& body) {
+    reactiveState.batches++;
+    body();
+    if (--reactiveState.batches == 0) flushEffects();
+    return NONE_VAL;
+}
+
+#endif
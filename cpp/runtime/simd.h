@@ -0,0 +1,296 @@
+#ifndef UAS_SIMD_H
+#define UAS_SIMD_H
+
+// Included by runtime.h after list.h.
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define UAS_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define UAS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Vector kernels behind the numeric list builtins (сума, скалярний_добуток,
+// мін, макс, корінь and elementwise + - * /) on Список<число>. Every
+// instruction set gets the same kernel bodies (simd_kernels.h) over its
+// own Lane; the best one the CPU supports is picked once and
+// UAS_SIMD=scalar|avx2 forces a lesser one. Sums and dot products add in
+// lane order, so they can round differently from a left-to-right loop.
+enum SimdOp { SIMD_ADD, SIMD_SUB, SIMD_MUL, SIMD_DIV };
+
+struct SimdKernels {
+    const char* name;
+    double (*sum)(const double* a, size_t n);
+    double (*dot)(const double* a, const double* b, size_t n);
+    double (*min)(const double* a, size_t n);
+    double (*max)(const double* a, size_t n);
+    void (*each[4])(const double* a, const double* b, double* out, size_t n);
+    void (*eachScalar[4])(const double* a, double s, double* out, size_t n);
+    void (*scalarEach[4])(double s, const double* b, double* out, size_t n);
+    void (*sqrt)(const double* a, double* out, size_t n);
+};
+
+namespace simd_scalar {
+#define UAS_SIMD_TARGET
+struct Lane {
+    typedef double V;
+    static const size_t W = 1;
+    static V zero() { return 0; }
+    static V broadcast(double s) { return s; }
+    static V load(const double* p) { return *p; }
+    static void store(double* p, V v) { *p = v; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V div(V a, V b) { return a / b; }
+    static V min(V a, V b) { return a < b ? a : b; }
+    static V max(V a, V b) { return a > b ? a : b; }
+    static V sqrt(V a) { return std::sqrt(a); }
+    static double total(V v) { return v; }
+};
+#include "simd_kernels.h"
+#undef UAS_SIMD_TARGET
+}
+
+#ifdef UAS_SIMD_X86
+namespace simd_avx2 {
+#define UAS_SIMD_TARGET __attribute__((target("avx2")))
+struct Lane {
+    typedef __m256d V;
+    static const size_t W = 4;
+    UAS_SIMD_TARGET static V zero() { return _mm256_setzero_pd(); }
+    UAS_SIMD_TARGET static V broadcast(double s) { return _mm256_set1_pd(s); }
+    UAS_SIMD_TARGET static V load(const double* p) { return _mm256_loadu_pd(p); }
+    UAS_SIMD_TARGET static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+    UAS_SIMD_TARGET static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    UAS_SIMD_TARGET static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    UAS_SIMD_TARGET static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    UAS_SIMD_TARGET static V div(V a, V b) { return _mm256_div_pd(a, b); }
+    UAS_SIMD_TARGET static V min(V a, V b) { return _mm256_min_pd(a, b); }
+    UAS_SIMD_TARGET static V max(V a, V b) { return _mm256_max_pd(a, b); }
+    UAS_SIMD_TARGET static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+    UAS_SIMD_TARGET static double total(V v) {
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, v);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+};
+#include "simd_kernels.h"
+#undef UAS_SIMD_TARGET
+}
+
+namespace simd_avx512 {
+#define UAS_SIMD_TARGET __attribute__((target("avx512f")))
+struct Lane {
+    typedef __m512d V;
+    static const size_t W = 8;
+    UAS_SIMD_TARGET static V zero() { return _mm512_setzero_pd(); }
+    UAS_SIMD_TARGET static V broadcast(double s) { return _mm512_set1_pd(s); }
+    UAS_SIMD_TARGET static V load(const double* p) { return _mm512_loadu_pd(p); }
+    UAS_SIMD_TARGET static void store(double* p, V v) { _mm512_storeu_pd(p, v); }
+    UAS_SIMD_TARGET static V add(V a, V b) { return _mm512_add_pd(a, b); }
+    UAS_SIMD_TARGET static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    UAS_SIMD_TARGET static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    UAS_SIMD_TARGET static V div(V a, V b) { return _mm512_div_pd(a, b); }
+    // The unmasked min/max/sqrt hand the instruction an _mm512_undefined_pd()
+    // source that g++ reports -Wmaybe-uninitialized on; with every lane
+    // selected, the zero-masked forms compute the same and pass setzero.
+    UAS_SIMD_TARGET static V min(V a, V b) { return _mm512_maskz_min_pd(0xFF, a, b); }
+    UAS_SIMD_TARGET static V max(V a, V b) { return _mm512_maskz_max_pd(0xFF, a, b); }
+    UAS_SIMD_TARGET static V sqrt(V a) { return _mm512_maskz_sqrt_pd(0xFF, a); }
+    UAS_SIMD_TARGET static double total(V v) {
+        alignas(64) double lanes[8];
+        _mm512_store_pd(lanes, v);
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+};
+#include "simd_kernels.h"
+#undef UAS_SIMD_TARGET
+}
+#endif
+
+#ifdef UAS_SIMD_NEON
+// Advanced SIMD is part of every AArch64 CPU, so it needs no dispatch.
+namespace simd_neon {
+#define UAS_SIMD_TARGET
+struct Lane {
+    typedef float64x2_t V;
+    static const size_t W = 2;
+    static V zero() { return vdupq_n_f64(0); }
+    static V broadcast(double s) { return vdupq_n_f64(s); }
+    static V load(const double* p) { return vld1q_f64(p); }
+    static void store(double* p, V v) { vst1q_f64(p, v); }
+    static V add(V a, V b) { return vaddq_f64(a, b); }
+    static V sub(V a, V b) { return vsubq_f64(a, b); }
+    static V mul(V a, V b) { return vmulq_f64(a, b); }
+    static V div(V a, V b) { return vdivq_f64(a, b); }
+    static V min(V a, V b) { return vbslq_f64(vcltq_f64(a, b), a, b); }
+    static V max(V a, V b) { return vbslq_f64(vcgtq_f64(a, b), a, b); }
+    static V sqrt(V a) { return vsqrtq_f64(a); }
+    static double total(V v) { return vgetq_lane_f64(v, 0) + vgetq_lane_f64(v, 1); }
+};
+#include "simd_kernels.h"
+#undef UAS_SIMD_TARGET
+}
+#endif
+
+inline SimdKernels pickSimdKernels() {
+    const char* forced = getenv("UAS_SIMD");
+    bool scalar = forced && strcmp(forced, "scalar") == 0;
+    if (scalar) return simd_scalar::kernels("scalar");
+#ifdef UAS_SIMD_X86
+    __builtin_cpu_init();
+    bool avx2Only = forced && strcmp(forced, "avx2") == 0;
+    if (!avx2Only && __builtin_cpu_supports("avx512f")) return simd_avx512::kernels("avx512");
+    if (__builtin_cpu_supports("avx2")) return simd_avx2::kernels("avx2");
+#endif
+#ifdef UAS_SIMD_NEON
+    return simd_neon::kernels("neon");
+#endif
+    return simd_scalar::kernels("scalar");
+}
+
+// Picked on first use, so programs without list math compile none of it.
+inline const SimdKernels& simdKernels() {
+    static const SimdKernels kernels = pickSimdKernels();
+    return kernels;
+}
+
+template <char Op>
+constexpr SimdOp simdOp() {
+    return Op == '+' ? SIMD_ADD : Op == '-' ? SIMD_SUB : Op == '*' ? SIMD_MUL : SIMD_DIV;
+}
+
+template <char Op, typename A, typename B>
+inline auto applyOp(A a, B b) {
+    if constexpr (Op == '+') return a + b;
+    else if constexpr (Op == '-') return a - b;
+    else if constexpr (Op == '*') return a * b;
+    else return (double)a / (double)b;
+}
+
+// `/` is always real-valued, as for numbers.
+template <char Op, typename A, typename B>
+using ElementwiseResult = std::conditional_t<Op == '/', double, std::common_type_t<A, B>>;
+
+template <typename T>
+inline List<T> sizedList(size_t n) {
+    List<T> out;
+    out.rep->items.resize(n);
+    return out;
+}
+
+// `xs + ys`, `xs * 2`, `1 / xs`: elementwise arithmetic on numeric lists.
+template <char Op, typename A, typename B>
+inline List<ElementwiseResult<Op, A, B>> elementwise(const List<A>& a, const List<B>& b) {
+    size_t n = a.rep->items.size();
+    if (b.rep->items.size() != n) runtimeError("elementwise arithmetic on lists of different lengths");
+    auto out = sizedList<ElementwiseResult<Op, A, B>>(n);
+    if constexpr (std::is_same<A, double>::value && std::is_same<B, double>::value) {
+        simdKernels().each[simdOp<Op>()](a.data(), b.data(), out.data(), n);
+    } else {
+        for (size_t i = 0; i < n; i++) out.rep->items[i] = applyOp<Op>(a.rep->items[i], b.rep->items[i]);
+    }
+    return out;
+}
+
+template <char Op, typename A, typename B, typename = std::enable_if_t<std::is_arithmetic<B>::value>>
+inline List<ElementwiseResult<Op, A, B>> elementwise(const List<A>& a, B s) {
+    size_t n = a.rep->items.size();
+    auto out = sizedList<ElementwiseResult<Op, A, B>>(n);
+    if constexpr (std::is_same<A, double>::value) {
+        simdKernels().eachScalar[simdOp<Op>()](a.data(), (double)s, out.data(), n);
+    } else {
+        for (size_t i = 0; i < n; i++) out.rep->items[i] = applyOp<Op>(a.rep->items[i], s);
+    }
+    return out;
+}
+
+template <char Op, typename A, typename B, typename = std::enable_if_t<std::is_arithmetic<A>::value>>
+inline List<ElementwiseResult<Op, A, B>> elementwise(A s, const List<B>& b) {
+    size_t n = b.rep->items.size();
+    auto out = sizedList<ElementwiseResult<Op, A, B>>(n);
+    if constexpr (std::is_same<B, double>::value) {
+        simdKernels().scalarEach[simdOp<Op>()]((double)s, b.data(), out.data(), n);
+    } else {
+        for (size_t i = 0; i < n; i++) out.rep->items[i] = applyOp<Op>(s, b.rep->items[i]);
+    }
+    return out;
+}
+
+// `сума(xs)` on a numeric list.
+template <typename T>
+inline T listSum(const List<T>& xs) {
+    if constexpr (std::is_same<T, double>::value) {
+        return simdKernels().sum(xs.data(), xs.rep->items.size());
+    } else {
+        T total = 0;
+        for (const T& x : xs) total += x;
+        return total;
+    }
+}
+
+// `скалярний_добуток(xs, ys)`
+template <typename A, typename B>
+inline std::common_type_t<A, B> dot(const List<A>& a, const List<B>& b) {
+    size_t n = a.rep->items.size();
+    if (b.rep->items.size() != n) runtimeError("скалярний_добуток of lists of different lengths");
+    if constexpr (std::is_same<A, double>::value && std::is_same<B, double>::value) {
+        return simdKernels().dot(a.data(), b.data(), n);
+    } else {
+        std::common_type_t<A, B> total = 0;
+        for (size_t i = 0; i < n; i++) total += a.rep->items[i] * b.rep->items[i];
+        return total;
+    }
+}
+
+// `мін(xs)` and `макс(xs)`: the smallest and largest element.
+template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+inline T minimum(const List<T>& xs) {
+    if (xs.size() == 0) runtimeError("мін of an empty list");
+    if constexpr (std::is_same<T, double>::value) return simdKernels().min(xs.data(), xs.rep->items.size());
+    T best = xs.rep->items[0];
+    for (const T& x : xs) best = minimum(best, x);
+    return best;
+}
+
+template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+inline T maximum(const List<T>& xs) {
+    if (xs.size() == 0) runtimeError("макс of an empty list");
+    if constexpr (std::is_same<T, double>::value) return simdKernels().max(xs.data(), xs.rep->items.size());
+    T best = xs.rep->items[0];
+    for (const T& x : xs) best = maximum(best, x);
+    return best;
+}
+
+// `корінь(x)`, elementwise on a list.
+inline double squareRoot(double x) { return std::sqrt(x); }
+template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+inline List<double> squareRoot(const List<T>& xs) {
+    size_t n = xs.rep->items.size();
+    List<double> out = sizedList<double>(n);
+    if constexpr (std::is_same<T, double>::value) {
+        simdKernels().sqrt(xs.data(), out.data(), n);
+    } else {
+        for (size_t i = 0; i < n; i++) out.rep->items[i] = (double)xs.rep->items[i];
+        simdKernels().sqrt(out.data(), out.data(), n);
+    }
+    return out;
+}
+
+// Dynamic lists are converted to Список<число> first.
+inline Value squareRoot(const Value& v) {
+    if (v.type == VAL_LIST) return Value(squareRoot(List<double>(v)));
+    if (v.type != VAL_NUMBER) runtimeError("корінь expects a number or a list of numbers");
+    return Value(std::sqrt(v.numberVal));
+}
+inline Value minimum(const Value& xs) { return Value(minimum(List<double>(xs))); }
+inline Value maximum(const Value& xs) { return Value(maximum(List<double>(xs))); }
+inline Value dot(const Value& a, const Value& b) { return Value(dot(List<double>(a), List<double>(b))); }
+
+#endif
@@ -0,0 +1,112 @@
+// Kernel bodies for one instruction set. simd.h includes this once per
+// namespace, after defining Lane and UAS_SIMD_TARGET there, so there is
+// no include guard. Lane::V holds Lane::W doubles.
+
+// Four accumulators hide the latency of the vector add.
+UAS_SIMD_TARGET inline double sum(const double* a, size_t n) {
+    const size_t W = Lane::W;
+    Lane::V acc[4] = {Lane::zero(), Lane::zero(), Lane::zero(), Lane::zero()};
+    size_t i = 0;
+    for (; i + 4 * W <= n; i += 4 * W) {
+        for (size_t k = 0; k < 4; k++) acc[k] = Lane::add(acc[k], Lane::load(a + i + k * W));
+    }
+    for (; i + W <= n; i += W) acc[0] = Lane::add(acc[0], Lane::load(a + i));
+    double total = Lane::total(Lane::add(Lane::add(acc[0], acc[1]), Lane::add(acc[2], acc[3])));
+    for (; i < n; i++) total += a[i];
+    return total;
+}
+
+UAS_SIMD_TARGET inline double dot(const double* a, const double* b, size_t n) {
+    const size_t W = Lane::W;
+    Lane::V acc[4] = {Lane::zero(), Lane::zero(), Lane::zero(), Lane::zero()};
+    size_t i = 0;
+    for (; i + 4 * W <= n; i += 4 * W) {
+        for (size_t k = 0; k < 4; k++) {
+            acc[k] = Lane::add(acc[k], Lane::mul(Lane::load(a + i + k * W), Lane::load(b + i + k * W)));
+        }
+    }
+    for (; i + W <= n; i += W) acc[0] = Lane::add(acc[0], Lane::mul(Lane::load(a + i), Lane::load(b + i)));
+    double total = Lane::total(Lane::add(Lane::add(acc[0], acc[1]), Lane::add(acc[2], acc[3])));
+    for (; i < n; i++) total += a[i] * b[i];
+    return total;
+}
+
+// `n` is at least 1. Like minimum(a, b), a NaN element is skipped.
+template <bool Min>
+UAS_SIMD_TARGET inline double extreme(const double* a, size_t n) {
+    const size_t W = Lane::W;
+    double best = a[0];
+    size_t i = 0;
+    if (n >= W) {
+        Lane::V acc = Lane::load(a);
+        for (i = W; i + W <= n; i += W) {
+            Lane::V x = Lane::load(a + i);
+            acc = Min ? Lane::min(x, acc) : Lane::max(x, acc);
+        }
+        alignas(64) double lanes[W];
+        Lane::store(lanes, acc);
+        best = lanes[0];
+        for (size_t k = 1; k < W; k++) best = Min ? (lanes[k] < best ? lanes[k] : best) : (best < lanes[k] ? lanes[k] : best);
+    }
+    for (; i < n; i++) best = Min ? (a[i] < best ? a[i] : best) : (best < a[i] ? a[i] : best);
+    return best;
+}
+
+struct Add {
+    UAS_SIMD_TARGET static Lane::V lanes(Lane::V a, Lane::V b) { return Lane::add(a, b); }
+    static double one(double a, double b) { return a + b; }
+};
+struct Sub {
+    UAS_SIMD_TARGET static Lane::V lanes(Lane::V a, Lane::V b) { return Lane::sub(a, b); }
+    static double one(double a, double b) { return a - b; }
+};
+struct Mul {
+    UAS_SIMD_TARGET static Lane::V lanes(Lane::V a, Lane::V b) { return Lane::mul(a, b); }
+    static double one(double a, double b) { return a * b; }
+};
+struct Div {
+    UAS_SIMD_TARGET static Lane::V lanes(Lane::V a, Lane::V b) { return Lane::div(a, b); }
+    static double one(double a, double b) { return a / b; }
+};
+
+// out[i] = a[i] op b[i]; `out` may be `a` or `b`.
+template <typename Op>
+UAS_SIMD_TARGET inline void each(const double* a, const double* b, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + Lane::W <= n; i += Lane::W) Lane::store(out + i, Op::lanes(Lane::load(a + i), Lane::load(b + i)));
+    for (; i < n; i++) out[i] = Op::one(a[i], b[i]);
+}
+
+// out[i] = a[i] op s
+template <typename Op>
+UAS_SIMD_TARGET inline void eachScalar(const double* a, double s, double* out, size_t n) {
+    Lane::V v = Lane::broadcast(s);
+    size_t i = 0;
+    for (; i + Lane::W <= n; i += Lane::W) Lane::store(out + i, Op::lanes(Lane::load(a + i), v));
+    for (; i < n; i++) out[i] = Op::one(a[i], s);
+}
+
+// out[i] = s op b[i]
+template <typename Op>
+UAS_SIMD_TARGET inline void scalarEach(double s, const double* b, double* out, size_t n) {
+    Lane::V v = Lane::broadcast(s);
+    size_t i = 0;
+    for (; i + Lane::W <= n; i += Lane::W) Lane::store(out + i, Op::lanes(v, Lane::load(b + i)));
+    for (; i < n; i++) out[i] = Op::one(s, b[i]);
+}
+
+UAS_SIMD_TARGET inline void roots(const double* a, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + Lane::W <= n; i += Lane::W) Lane::store(out + i, Lane::sqrt(Lane::load(a + i)));
+    for (; i < n; i++) out[i] = std::sqrt(a[i]);
+}
+
+inline SimdKernels kernels(const char* name) {
+    return SimdKernels{
+        name, sum, dot, extreme<true>, extreme<false>,
+        {each<Add>, each<Sub>, each<Mul>, each<Div>},
+        {eachScalar<Add>, eachScalar<Sub>, eachScalar<Mul>, eachScalar<Div>},
+        {scalarEach<Add>, scalarEach<Sub>, scalarEach<Mul>, scalarEach<Div>},
+        roots,
+    };
+}
@@ -0,0 +1,78 @@
+#ifndef UAS_SOA_H
+#define UAS_SOA_H
+
+// Included at the end of runtime.h.
+
+#include <vector>
+
+// `@soa` (or `@стовпці`) on a class: a Список<T> of it keeps each field
+// in an array of its own, so a loop that reads two fields of every element
+// walks two dense arrays instead of every whole object. For such a class
+// the transpiler emits T::Columns, which holds the arrays, and T::Ref, an
+// element seen through references into them, and specializes List<T> as
+// a SoaList<T>. Reading an element whole (`нехай p = ps[і]`) gathers a T.
+
+// One field's array. A bool is kept in a struct, since std::vector<bool>
+// cannot hand out a bool&.
+template <typename F>
+struct SoaColumn {
+    std::vector<F> items;
+    size_t size() const { return items.size(); }
+    void reserve(size_t n) { items.reserve(n); }
+    void push_back(const F& v) { items.push_back(v); }
+    F& operator[](size_t i) { return items[i]; }
+};
+
+template <>
+struct SoaColumn<bool> {
+    struct Cell { bool b; };
+    std::vector<Cell> items;
+    size_t size() const { return items.size(); }
+    void reserve(size_t n) { items.reserve(n); }
+    void push_back(bool v) { items.push_back(Cell{v}); }
+    bool& operator[](size_t i) { return items[i].b; }
+};
+
+template <typename T>
+struct SoaRep {
+    size_t refs;
+    typename T::Columns columns;
+};
+
+// A refcounted handle like List: copies share the columns.
+template <typename T>
+struct SoaList {
+    SoaRep<T>* rep;
+
+    SoaList() : rep(new SoaRep<T>{1, {}}) {}
+    SoaList(const SoaList& other) : rep(other.rep) { retainRef(rep->refs); }
+    SoaList(SoaList&& other) noexcept : rep(other.rep) { other.rep = nullptr; }
+    SoaList& operator=(SoaList other) noexcept {
+        std::swap(rep, other.rep);
+        return *this;
+    }
+    ~SoaList() { if (rep && releaseRef(rep->refs)) delete rep; }
+
+    template <typename... Items>
+    static List<T> of(Items&&... items) {
+        List<T> list;
+        list.rep->columns.reserve(sizeof...(items));
+        (list.push(std::forward<Items>(items)), ...);
+        return list;
+    }
+
+    int64_t size() const { return (int64_t)rep->columns.size(); }
+
+    template <typename I>
+    typename T::Ref operator[](const I& i) const {
+        int64_t at = listPosition(i);
+        if ((uint64_t)at >= rep->columns.size()) indexError(at, rep->columns.size());
+        return rep->columns.at(at);
+    }
+    typename T::Ref unchecked(int64_t i) const { return rep->columns.at(i); }
+
+    template <typename V>
+    void push(V&& v) const { rep->columns.push(element<T>(std::forward<V>(v))); }
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef UAS_STREAM_H
+#define UAS_STREAM_H
+
+// Included at the end of runtime.h.
+
+#include <cstdio>
+#include <cstring>
+
+// `рядки(шлях)` and `рядки()`: a file, or standard input, one line at a
+// time. Pipelines are fused into a loop over next(), so only the current
+// line is ever held in memory.
+struct LineReader {
+    FILE* file;
+    bool owned;
+
+    LineReader() : file(stdin), owned(false) {}
+    explicit LineReader(const std::string& path) : file(fopen(path.c_str(), "rb")), owned(true) {
+        if (!file) runtimeError(("cannot open " + path).c_str());
+        setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    }
+    explicit LineReader(const Value& path) : LineReader(pathOf(path)) {}
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+    ~LineReader() { if (owned) fclose(file); }
+
+    static const std::string& pathOf(const Value& v) {
+        if (v.type != VAL_STRING) runtimeError("рядки expects a file path");
+        return v.stringVal();
+    }
+
+    // The next line without its "\n" or "\r\n"; false at the end of input.
+    bool next(std::string& line) {
+        line.clear();
+        char buf[4096];
+        while (fgets(buf, sizeof(buf), file)) {
+            size_t n = strlen(buf);
+            if (n > 0 && buf[n - 1] == '\n') {
+                line.append(buf, n - 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                return true;
+            }
+            line.append(buf, n);
+        }
+        return !line.empty();
+    }
+};
+
+#endif
@@ -0,0 +1,432 @@
+#ifndef UAS_TASKS_H
+#define UAS_TASKS_H
+
+// Included by runtime.h after map.h.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// A `запустити { }` body. Tasks run to completion on whichever worker
+// takes them; they are closures, not threads, so spawning one costs an
+// allocation and a deque push.
+struct TaskBase {
+    virtual ~TaskBase() {}
+    virtual void run() = 0;
+};
+
+template <typename F>
+struct TaskOf : TaskBase {
+    F body;
+    explicit TaskOf(F&& f) : body(std::move(f)) {}
+    explicit TaskOf(const F& f) : body(f) {}
+    void run() override { body(); }
+};
+
+// Work-stealing pool with one worker per hardware thread. A worker pushes
+// the tasks it spawns onto its own deque and takes the newest first, so a
+// task tree unfolds depth-first in cache; an idle worker steals the oldest
+// task of another. The main thread owns no deque: its spawns are dealt
+// round-robin, and while it waits for the tasks at exit it steals too.
+//
+// A task blocked on a channel keeps its worker. When that leaves fewer
+// running workers than hardware threads while tasks are queued, a spare
+// worker is started, so blocked tasks never starve the ones that would
+// unblock them.
+class Scheduler {
+    struct Worker {
+        std::mutex lock;
+        std::deque<TaskBase*> tasks;
+    };
+    static const size_t MAX_WORKERS = 1024;
+
+    Worker* workers[MAX_WORKERS];
+    std::atomic<size_t> count{0}; // workers[0, count) are published
+    size_t target;                // workers that should be running
+    std::mutex poolLock;          // serializes adding workers
+
+    std::atomic<int64_t> unfinished{0}; // spawned and not yet done
+    std::atomic<int64_t> queued{0};     // waiting in some deque
+    std::atomic<int64_t> blocked{0};    // workers waiting on a channel
+    std::atomic<int> sleeping{0};
+    std::atomic<size_t> next{0};        // round-robin cursor for the main thread
+    std::mutex idleLock;
+    std::condition_variable idle; // a task was queued
+    std::condition_variable done; // the last task finished
+
+    static int& self() {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    Scheduler() {
+        tasksStarted = true;
+        unsigned n = std::thread::hardware_concurrency();
+        target = n ? n : 1;
+        for (size_t i = 0; i < target; i++) addWorker();
+    }
+
+    void addWorker() {
+        size_t index = count.load();
+        workers[index] = new Worker();
+        count.store(index + 1, std::memory_order_release);
+        std::thread([this, index] { work((int)index); }).detach();
+    }
+
+    void work(int index) {
+        self() = index;
+        while (true) {
+            if (runOne()) continue;
+            std::unique_lock<std::mutex> hold(idleLock);
+            sleeping.fetch_add(1);
+            idle.wait(hold, [this] { return queued.load() > 0; });
+            sleeping.fetch_sub(1);
+        }
+    }
+
+    static TaskBase* pop(Worker& w, bool newest) {
+        std::lock_guard<std::mutex> hold(w.lock);
+        if (w.tasks.empty()) return nullptr;
+        TaskBase* task;
+        if (newest) {
+            task = w.tasks.back();
+            w.tasks.pop_back();
+        } else {
+            task = w.tasks.front();
+            w.tasks.pop_front();
+        }
+        return task;
+    }
+
+    TaskBase* take() {
+        int me = self();
+        if (me >= 0) {
+            if (TaskBase* task = pop(*workers[me], true)) return task;
+        }
+        size_t n = count.load(std::memory_order_acquire);
+        size_t start = me >= 0 ? (size_t)me + 1 : next.fetch_add(1, std::memory_order_relaxed);
+        for (size_t k = 0; k < n; k++) {
+            size_t victim = (start + k) % n;
+            if ((int)victim == me) continue;
+            if (TaskBase* task = pop(*workers[victim], false)) return task;
+        }
+        return nullptr;
+    }
+
+    bool runOne() {
+        if (queued.load() == 0) return false;
+        TaskBase* task = take();
+        if (!task) return false;
+        queued.fetch_sub(1);
+        task->run();
+        delete task;
+        output().flush(); // a task's lines come out when it finishes
+        if (unfinished.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> hold(idleLock);
+            done.notify_all();
+        }
+        return true;
+    }
+
+public:
+    // Never destroyed: workers are still parked when main returns, and a
+    // runtime error may call exit() from one of them.
+    static Scheduler& get() {
+        static Scheduler* scheduler = new Scheduler();
+        return *scheduler;
+    }
+
+    template <typename F>
+    void spawn(F&& body) {
+        TaskBase* task = new TaskOf<std::decay_t<F>>(std::forward<F>(body));
+        unfinished.fetch_add(1);
+        int me = self();
+        // Lines the main thread printed before the spawn come out first.
+        if (me < 0) output().flush();
+        Worker& w = *workers[me >= 0 ? (size_t)me : next.fetch_add(1, std::memory_order_relaxed) % count.load(std::memory_order_acquire)];
+        {
+            std::lock_guard<std::mutex> hold(w.lock);
+            w.tasks.push_back(task);
+        }
+        queued.fetch_add(1);
+        // Pairs with the sleeper's check of `queued` under idleLock.
+        if (sleeping.load() > 0) {
+            std::lock_guard<std::mutex> hold(idleLock);
+            idle.notify_one();
+        }
+    }
+
+    // Main's exit: helps run what is left, then returns once every task is done.
+    void waitAll() {
+        while (unfinished.load() > 0) {
+            if (runOne()) continue;
+            std::unique_lock<std::mutex> hold(idleLock);
+            done.wait_for(hold, std::chrono::milliseconds(1), [this] { return unfinished.load() == 0; });
+        }
+    }
+
+    // Nothing is left that could ever send to (or receive from) the main thread.
+    static bool deadlocked() {
+        return self() < 0 && (!tasksStarted || get().unfinished.load() == 0);
+    }
+
+    void enterBlocked() { if (self() >= 0) blocked.fetch_add(1); }
+    void leaveBlocked() { if (self() >= 0) blocked.fetch_sub(1); }
+
+    // Called periodically by a blocked task; see the class comment.
+    void compensate() {
+        if (queued.load() == 0 || sleeping.load() > 0) return;
+        std::lock_guard<std::mutex> hold(poolLock);
+        size_t n = count.load();
+        if (n >= MAX_WORKERS || n - (size_t)blocked.load() >= target) return;
+        if (queued.load() == 0 || sleeping.load() > 0) return;
+        addWorker();
+    }
+};
+
+// `запустити { ... }`: the body runs as a task with copies of the locals it uses.
+template <typename F>
+inline void spawn(F&& body) { Scheduler::get().spawn(std::forward<F>(body)); }
+
+// Emitted at the end of main() in programs that spawn: like the end of a
+// scope, the program ends once everything it started has finished.
+inline void waitForTasks() {
+    if (tasksStarted) Scheduler::get().waitAll();
+}
+
+// Slices for `паралельно для` over [from, to): a few per worker, so slices
+// that happen to run slower even out. One core runs the loop inline.
+inline int64_t parallelChunks(int64_t from, int64_t to) {
+    if (to <= from) return 0;
+    static const int64_t perMachine = [] {
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 1 ? 4 * (int64_t)n : (int64_t)1;
+    }();
+    return std::min(perMachine, to - from);
+}
+
+// Runs body(chunk, lo, hi) over `chunks` even slices of [from, to), the
+// first on the calling thread, and returns once every slice has finished.
+template <typename F>
+inline void parallelFor(int64_t from, int64_t to, int64_t chunks, const F& body) {
+    if (chunks <= 1) {
+        if (chunks == 1) body(0, from, to);
+        return;
+    }
+    int64_t size = (to - from) / chunks, extra = (to - from) % chunks;
+    auto start = [&](int64_t c) { return from + c * size + std::min(c, extra); };
+    // The count only changes under the lock, so a slice is done with the
+    // latch before the caller can see zero and return.
+    struct Latch {
+        std::mutex lock;
+        std::condition_variable done;
+        int64_t left;
+    } latch;
+    latch.left = chunks - 1;
+    Scheduler& scheduler = Scheduler::get();
+    for (int64_t c = 1; c < chunks; c++) {
+        int64_t lo = start(c), hi = start(c + 1);
+        scheduler.spawn([&body, &latch, c, lo, hi] {
+            body(c, lo, hi);
+            std::lock_guard<std::mutex> hold(latch.lock);
+            if (--latch.left == 0) latch.done.notify_one();
+        });
+    }
+    body(0, from, start(1));
+    std::unique_lock<std::mutex> hold(latch.lock);
+    if (latch.left == 0) return;
+    scheduler.enterBlocked();
+    while (!latch.done.wait_for(hold, std::chrono::milliseconds(1), [&] { return latch.left == 0; })) {
+        scheduler.compensate();
+    }
+    scheduler.leaveBlocked();
+}
+
+// Bounded MPMC ring (Vyukov): each cell carries a sequence number that says
+// whose turn it is, so senders and receivers each claim a cell with one CAS
+// and never take a lock. With one sender and one receiver the CAS never
+// fails, so the same ring serves SPSC pipes. Only a full (or empty) channel
+// falls back to waiting, after a short spin.
+template <typename T>
+struct ChannelRep : ChannelBase {
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; // next cell to send into
+    alignas(64) std::atomic<size_t> tail{0}; // next cell to receive from
+    alignas(64) std::atomic<int> waiting{0};
+    std::mutex lock; // only for waiting
+    std::condition_variable changed;
+
+    explicit ChannelRep(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) n *= 2;
+        cells.reset(new Cell[n]);
+        mask = n - 1;
+        for (size_t i = 0; i < n; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool trySend(T& v) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(v);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryReceive(T& out) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(cell.value); // leaves no handle behind in the ring
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void send(T v) {
+        if (!trySend(v)) waitUntil([&] { return trySend(v); }, "send on a full channel that no task receives from");
+        wake();
+    }
+
+    T receive() {
+        T out;
+        if (!tryReceive(out)) waitUntil([&] { return tryReceive(out); }, "receive from an empty channel that no task sends to");
+        wake();
+        return out;
+    }
+
+    void sendValue(const Value& v) override { send(element<T>(v)); }
+    Value receiveValue() override { return Value(receive()); }
+
+private:
+    void wake() {
+        // Orders our ring update before reading `waiting`; a waiter bumps
+        // `waiting` before retrying, so one of us sees the other.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> hold(lock);
+            changed.notify_all();
+        }
+    }
+
+    template <typename Ready>
+    void waitUntil(Ready ready, const char* deadlock) {
+        for (int i = 0; i < 128; i++) {
+            cpuRelax();
+            if (ready()) return;
+        }
+        std::unique_lock<std::mutex> hold(lock);
+        waiting.fetch_add(1);
+        if (!ready()) {
+            if (Scheduler::deadlocked()) runtimeError(deadlock);
+            Scheduler& scheduler = Scheduler::get();
+            scheduler.enterBlocked();
+            do {
+                scheduler.compensate();
+                changed.wait_for(hold, std::chrono::milliseconds(1));
+            } while (!ready());
+            scheduler.leaveBlocked();
+        }
+        waiting.fetch_sub(1);
+    }
+};
+
+// `Канал<T>`: a refcounted handle like List; every copy is the same channel.
+template <typename T>
+struct Channel {
+    ChannelRep<T>* rep;
+
+    explicit Channel(int64_t capacity = 64) {
+        if (capacity < 1) runtimeError("channel capacity must be at least 1");
+        rep = new ChannelRep<T>((size_t)capacity);
+    }
+    Channel(const Channel& other) : rep(other.rep) { retainRef(rep->refs); }
+    Channel(Channel&& other) noexcept : rep(other.rep) { other.rep = nullptr; }
+    Channel(const Value& v);
+    Channel& operator=(Channel other) noexcept {
+        std::swap(rep, other.rep);
+        return *this;
+    }
+    ~Channel() { if (rep && releaseRef(rep->refs)) delete rep; }
+
+    template <typename V>
+    void send(V&& v) const { rep->send(element<T>(std::forward<V>(v))); }
+    T receive() const { return rep->receive(); }
+};
+
+// Unlike a list, a channel is never copied into another element type: a
+// Value shares it, and only a Channel<T> of the same T can take it back.
+template <typename T>
+inline Channel<T>::Channel(const Value& v) {
+    if (v.type != VAL_CHANNEL) runtimeError("expected a channel");
+    rep = dynamic_cast<ChannelRep<T>*>(v.channelRep);
+    if (!rep) runtimeError("channel has a different element type");
+    retainRef(rep->refs);
+}
+
+template <typename T>
+inline void unbox(const Value& v, Channel<T>& out) { out = Channel<T>(v); }
+
+template <typename T>
+inline Value::Value(const Channel<T>& channel) : type(VAL_CHANNEL) {
+    channelRep = channel.rep;
+    retainRef(channelRep->refs);
+}
+
+inline ChannelBase& asChannel(const Value& v) {
+    if (v.type != VAL_CHANNEL) runtimeError("send or receive on a value that is not a channel");
+    return *v.channelRep;
+}
+
+template <typename T, typename V>
+inline void channelSend(const Channel<T>& channel, V&& v) { channel.send(std::forward<V>(v)); }
+
+template <typename V>
+inline void channelSend(const Value& channel, V&& v) { asChannel(channel).sendValue(Value(std::forward<V>(v))); }
+
+template <typename T>
+inline T channelReceive(const Channel<T>& channel) { return channel.receive(); }
+
+inline Value channelReceive(const Value& channel) { return asChannel(channel).receiveValue(); }
+
+#endif
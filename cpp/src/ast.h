@@ -1,14 +1,20 @@
-
 #ifndef AST_H
 #define AST_H
 
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
-#include <memory>
+#include "types.h"
 
 enum NodeType {
     PROGRAM,
     FUNCTION_DECL,
+    CLASS_DECL,
     BLOCK_STMT,
     IF_STMT,
     SWITCH_STMT,
@@ -17,136 +23,678 @@ enum NodeType {
     LET_STMT,
     ASSIGN_STMT,
     EXPR_STMT,
+    IMPORT_STMT,
+    FOR_STMT,
+    INDEX_ASSIGN_STMT,
+    FIELD_ASSIGN_STMT,
+    SPAWN_STMT, // last statement kind
     ASSIGN_EXPR,
     BINARY_EXPR,
     UNARY_EXPR,
     CALL_EXPR,
+    LIST_EXPR,
+    MAP_EXPR,
+    INDEX_EXPR,
+    FIELD_EXPR,
+    CHANNEL_EXPR,
+    LAMBDA_EXPR,
     LITERAL,
     IDENTIFIER
 };
 
+enum BinaryOp { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW, OP_LT, OP_GT, OP_LE, OP_GE, OP_EQ };
+enum UnaryOp { OP_NEG };
+enum LiteralKind { LIT_INT, LIT_FLOAT, LIT_BOOL, LIT_STRING, LIT_NONE };
+
+inline const char* opText(BinaryOp op) {
+    static const char* const text[] = {"+", "-", "*", "/", "%", "**", "<", ">", "<=", ">=", "=="};
+    return text[op];
+}
+
+inline const char* opText(UnaryOp) { return "-"; }
+
+// Runtime functions callable under any of their spellings, unless a user
+// function of the same name shadows them. Returns the runtime name, or
+// nullptr if `name` is not a builtin.
+inline const char* builtinName(std::string_view name) {
+    if (name == "довжина" || name == "length" || name == "len") return "length";
+    if (name == "дописати" || name == "push") return "push";
+    if (name == "має" || name == "has") return "has";
+    if (name == "отримати" || name == "get") return "get";
+    if (name == "видалити" || name == "remove") return "removeKey";
+    if (name == "ключі" || name == "keys") return "keys";
+    if (name == "мін" || name == "min") return "minimum";
+    if (name == "макс" || name == "max") return "maximum";
+    if (name == "скалярний_добуток" || name == "dot") return "dot";
+    if (name == "корінь" || name == "sqrt") return "squareRoot";
+    if (name == "сигнал" || name == "signal") return "makeSignal";
+    if (name == "обчислене" || name == "computed") return "makeComputed";
+    if (name == "ефект" || name == "effect") return "effect";
+    if (name == "пакет" || name == "batch") return "batch";
+    if (name == "потік" || name == "flow") return "streamOf";
+    if (name == "діапазон" || name == "range") return "streamRange";
+    if (name == "рядки" || name == "lines") return "streamLines";
+    if (name == "фільтр" || name == "filter") return "streamFilter";
+    if (name == "відобразити" || name == "map") return "streamMap";
+    if (name == "взяти" || name == "take") return "streamTake";
+    if (name == "зібрати" || name == "collect") return "streamCollect";
+    if (name == "сума" || name == "sum") return "streamSum";
+    if (name == "кількість" || name == "count") return "streamCount";
+    if (name == "кожен" || name == "each") return "streamEach";
+    if (name == "надіслати" || name == "send") return "channelSend";
+    if (name == "прийняти" || name == "receive" || name == "recv") return "channelReceive";
+    return nullptr;
+}
+
+// Bump allocator that owns every node of a Program. Nodes are trivially
+// destructible (names are views into arena memory, child lists are arena
+// arrays), so tearing the tree down is just releasing the blocks.
+class Arena {
+    static const size_t BLOCK_SIZE = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    size_t remaining = 0;
+
+public:
+    void* allocate(size_t size, size_t align) {
+        size_t pad = (align - (size_t)cursor % align) % align;
+        if (pad + size > remaining) {
+            size_t blockSize = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+            blocks.emplace_back(new char[blockSize]);
+            cursor = blocks.back().get();
+            remaining = blockSize;
+            pad = (align - (size_t)cursor % align) % align;
+        }
+        void* p = cursor + pad;
+        cursor += pad + size;
+        remaining -= pad + size;
+        return p;
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena nodes are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    std::string_view copy(std::string_view s) {
+        if (s.empty()) return std::string_view();
+        char* p = (char*)allocate(s.size(), 1);
+        memcpy(p, s.data(), s.size());
+        return std::string_view(p, s.size());
+    }
+};
+
+// Fixed-size array living in an Arena.
+template <typename T>
+struct List {
+    T* items = nullptr;
+    size_t count = 0;
+
+    List() {}
+    List(Arena& arena, const std::vector<T>& v) : count(v.size()) {
+        static_assert(std::is_trivially_copyable<T>::value, "arena lists hold plain data");
+        if (count == 0) return;
+        items = (T*)arena.allocate(sizeof(T) * count, alignof(T));
+        memcpy((void*)items, v.data(), sizeof(T) * count);
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) const { return items[i]; }
+    T* begin() const { return items; }
+    T* end() const { return items + count; }
+};
+
+// `line` and `column` are where the node starts in its module's source,
+// for `#line` directives and messages; 0 for nodes the optimizer made.
+// An expression is placed at the last token the parser read for it.
 struct Node {
     NodeType type;
-    virtual ~Node() {}
+    uint32_t line = 0;
+    uint32_t column = 0;
 };
 
-struct Expression : Node {};
+struct Expression : Node {
+    const Type* staticType = Type::value(); // filled in by TypeInference
+};
 struct Statement : Node {};
 
 struct Program : Node {
-    std::vector<std::unique_ptr<Statement>> body;
+    Arena arena;
+    List<Statement*> body;
+    std::string path; // of the source file, set by the module loader
     Program() { type = PROGRAM; }
 };
 
 struct Identifier : Expression {
-    std::string name;
-    Identifier(std::string n) : name(n) { type = IDENTIFIER; }
+    std::string_view name;
+    bool readsSignal = false; // set by TypeInference: the name is a сигнал, read for its value
+    Identifier(std::string_view n) : name(n) { type = IDENTIFIER; }
 };
 
 struct Literal : Expression {
-    std::string value; // Store as string for C++ emission simplicity
-    std::string valueType; // "int", "float", "bool", "string"
-    Literal(std::string v, std::string t) : value(v), valueType(t) { type = LITERAL; }
+    std::string_view value; // Source spelling, for C++ emission simplicity
+    LiteralKind kind;
+    Literal(std::string_view v, LiteralKind k) : value(v), kind(k) { type = LITERAL; }
 };
 
 struct BinaryExpr : Expression {
-    std::string op;
-    std::unique_ptr<Expression> left;
-    std::unique_ptr<Expression> right;
-    BinaryExpr(std::string o, std::unique_ptr<Expression> l, std::unique_ptr<Expression> r) 
-        : op(o), left(std::move(l)), right(std::move(r)) { type = BINARY_EXPR; }
+    BinaryOp op;
+    Expression* left;
+    Expression* right;
+    BinaryExpr(BinaryOp o, Expression* l, Expression* r)
+        : op(o), left(l), right(r) { type = BINARY_EXPR; }
 };
 
 struct UnaryExpr : Expression {
-    std::string op;
-    std::unique_ptr<Expression> right;
-    UnaryExpr(std::string o, std::unique_ptr<Expression> r) 
-        : op(o), right(std::move(r)) { type = UNARY_EXPR; }
+    UnaryOp op;
+    Expression* right;
+    UnaryExpr(UnaryOp o, Expression* r)
+        : op(o), right(r) { type = UNARY_EXPR; }
 };
 
+struct FunctionDecl;
+struct ClassDecl;
+
 struct CallExpr : Expression {
-    std::unique_ptr<Expression> callee;
-    std::vector<std::unique_ptr<Expression>> args;
-    CallExpr(std::unique_ptr<Expression> c, std::vector<std::unique_ptr<Expression>> a)
-        : callee(std::move(c)), args(std::move(a)) { type = CALL_EXPR; }
+    Expression* callee;
+    List<Expression*> args;
+    const char* builtin = nullptr; // runtime function, resolved by TypeInference
+    bool receiver = false;         // written `x.f(a)`, so args[0] is x
+    // Resolved by TypeInference: a method of args[0] (of the enclosing
+    // class when there is no receiver), or the class a call constructs
+    // (with a receiver: a дані object's копія).
+    FunctionDecl* method = nullptr;
+    ClassDecl* constructs = nullptr;
+    CallExpr(Expression* c, List<Expression*> a)
+        : callee(c), args(a) { type = CALL_EXPR; }
+};
+
+// `[a, b, c]`
+struct ListExpr : Expression {
+    List<Expression*> items;
+    ListExpr(List<Expression*> i) : items(i) { type = LIST_EXPR; }
+};
+
+// `{k: v, ...}`; keys[i] maps to values[i].
+struct MapExpr : Expression {
+    List<Expression*> keys;
+    List<Expression*> values;
+    MapExpr(List<Expression*> k, List<Expression*> v) : keys(k), values(v) { type = MAP_EXPR; }
+};
+
+// `target[index]`, on a list or a map
+struct IndexExpr : Expression {
+    Expression* target;
+    Expression* index;
+    bool readsSignal = false; // set by TypeInference: the element is a сигнал, read for its value
+    IndexExpr(Expression* t, Expression* i)
+        : target(t), index(i) { type = INDEX_EXPR; }
+};
+
+// `object.field`
+struct FieldExpr : Expression {
+    Expression* object;
+    std::string_view field;
+    FieldExpr(Expression* o, std::string_view f)
+        : object(o), field(f) { type = FIELD_EXPR; }
+};
+
+// `канал<T>()` or `канал<T>(capacity)`
+struct ChannelExpr : Expression {
+    std::string_view elementType;
+    Expression* capacity; // nullptr for the default
+    ChannelExpr(std::string_view e, Expression* c)
+        : elementType(e), capacity(c) { type = CHANNEL_EXPR; }
 };
 
 struct BlockStmt : Statement {
-    std::vector<std::unique_ptr<Statement>> statements;
-    BlockStmt() { type = BLOCK_STMT; }
+    List<Statement*> statements;
+    BlockStmt(List<Statement*> s) : statements(s) { type = BLOCK_STMT; }
+};
+
+// `запустити { }`: the body runs as a task, on copies of the locals it
+// uses; a `повернути` inside it ends the task.
+struct SpawnStmt : Statement {
+    BlockStmt* body;
+    SpawnStmt(BlockStmt* b) : body(b) { type = SPAWN_STMT; }
 };
 
 struct ReturnStmt : Statement {
-    std::unique_ptr<Expression> value;
-    ReturnStmt(std::unique_ptr<Expression> v) : value(std::move(v)) { type = RETURN_STMT; }
+    Expression* value;
+    ReturnStmt(Expression* v) : value(v) { type = RETURN_STMT; }
 };
 
 struct WhileStmt : Statement {
-    std::unique_ptr<Expression> condition;
-    std::unique_ptr<Statement> body;
-    WhileStmt(std::unique_ptr<Expression> c, std::unique_ptr<Statement> b)
-        : condition(std::move(c)), body(std::move(b)) { type = WHILE_STMT; }
+    Expression* condition;
+    Statement* body;
+    WhileStmt(Expression* c, Statement* b)
+        : condition(c), body(b) { type = WHILE_STMT; }
+};
+
+// `для x в xs { }` iterates a list; `для і від a до b { }` counts from a
+// up to, but not including, b. Exactly one of `iterable` and `from`/`to` is set.
+struct ForStmt : Statement {
+    std::string_view var;
+    Expression* iterable;
+    Expression* from;
+    Expression* to;
+    Statement* body;
+    bool parallel = false; // `паралельно для`; ranges only
+    bool fixed = false;    // nothing assigns to var (set by Optimizer)
+    ForStmt(std::string_view v, Expression* it, Expression* f, Expression* t, Statement* b)
+        : var(v), iterable(it), from(f), to(t), body(b) { type = FOR_STMT; }
 };
 
 struct IfStmt : Statement {
-    std::unique_ptr<Expression> condition;
-    std::unique_ptr<Statement> thenBranch;
-    std::unique_ptr<Statement> elseBranch;
-    IfStmt(std::unique_ptr<Expression> c, std::unique_ptr<Statement> t, std::unique_ptr<Statement> e)
-        : condition(std::move(c)), thenBranch(std::move(t)), elseBranch(std::move(e)) { type = IF_STMT; }
+    Expression* condition;
+    Statement* thenBranch;
+    Statement* elseBranch;
+    IfStmt(Expression* c, Statement* t, Statement* e)
+        : condition(c), thenBranch(t), elseBranch(e) { type = IF_STMT; }
 };
 
 struct SwitchStmt : Statement {
     struct Case {
-        std::string patternName; // "_" or variable name
-        std::unique_ptr<Expression> value; // nullptr if it's a variable pattern or default
-        std::unique_ptr<Expression> guard; // optional "if" condition
-        std::unique_ptr<Statement> body;
+        std::string_view patternName; // "_" or variable name
+        Expression* value; // nullptr if it's a variable pattern or default
+        Expression* guard; // optional "if" condition
+        Statement* body;
     };
-    std::unique_ptr<Expression> discriminant;
-    std::vector<Case> cases;
-    SwitchStmt(std::unique_ptr<Expression> d, std::vector<Case> c)
-        : discriminant(std::move(d)), cases(std::move(c)) { type = SWITCH_STMT; }
+    Expression* discriminant;
+    List<Case> cases;
+    SwitchStmt(Expression* d, List<Case> c)
+        : discriminant(d), cases(c) { type = SWITCH_STMT; }
 };
 
 struct FunctionDecl : Statement {
-    std::string name;
+    std::string_view name;
     struct Param {
-        std::string name;
-        std::string typeName; // "Value" by default
+        std::string_view name;
+        std::string_view typeName; // "Value" by default
+    };
+    List<Param> params;
+    std::string_view returnType; // "Value" by default
+    BlockStmt* body;
+    List<std::string_view> attributes; // `@name` markers in front of the declaration
+    FunctionDecl* generic = nullptr;   // a specialization's unannotated original (see TypeInference)
+    FunctionDecl(std::string_view n, List<Param> p, std::string_view rt, BlockStmt* b)
+        : name(n), params(p), returnType(rt), body(b) { type = FUNCTION_DECL; }
+
+    bool hasAttribute(std::string_view a) const {
+        for (std::string_view x : attributes) if (x == a) return true;
+        return false;
+    }
+};
+
+// `клас Точка(x: число, y: число) { нехай n = 0  функція f() { } }` or
+// `дані Користувач(імя: стрічка, вік: ціле)`. Objects are values, lowered
+// to plain C++ structs: the constructor's parameters are the first fields,
+// then come the body's lets, which start at their initializer (or zero).
+// Methods see the fields by their bare names and are called statically.
+struct ClassDecl : Statement {
+    struct Field {
+        std::string_view name;
+        std::string_view typeName; // "Value" until TypeInference fills in an unannotated let
+        Expression* initializer;   // nullptr for constructor parameters and bare lets
     };
-    std::vector<Param> params;
-    std::string returnType; // "Value" by default
-    std::unique_ptr<BlockStmt> body;
-    FunctionDecl(std::string n, std::vector<Param> p, std::string rt, std::unique_ptr<BlockStmt> b)
-        : name(n), params(p), returnType(rt), body(std::move(b)) { type = FUNCTION_DECL; }
+    std::string_view name;
+    List<Field> fields;
+    size_t parameters; // leading fields the constructor takes
+    List<FunctionDecl*> methods;
+    bool data;         // `дані`: compared and hashed field by field, and has копія()
+    List<std::string_view> attributes;
+    ClassDecl(std::string_view n, List<Field> f, size_t p, List<FunctionDecl*> m, bool d)
+        : name(n), fields(f), parameters(p), methods(m), data(d) { type = CLASS_DECL; }
+
+    const Field* field(std::string_view n) const {
+        for (const Field& f : fields) if (f.name == n) return &f;
+        return nullptr;
+    }
+    FunctionDecl* method(std::string_view n) const;
+
+    bool hasAttribute(std::string_view a) const {
+        for (std::string_view x : attributes) if (x == a) return true;
+        return false;
+    }
+    // `@soa`: a list of these keeps each field in its own array.
+    bool columns() const { return hasAttribute("soa") || hasAttribute("стовпці"); }
+};
+
+inline FunctionDecl* ClassDecl::method(std::string_view n) const {
+    for (FunctionDecl* m : methods) if (m->name == n) return m;
+    return nullptr;
+}
+
+// `(x: ціле) => x * 2` or `() => { ... }`. Like a `запустити` body, a
+// lambda works on copies of the variables it uses. A block body's result
+// is whatever its `повернути` gives, or none.
+struct LambdaExpr : Expression {
+    List<FunctionDecl::Param> params;
+    Expression* result; // expression body, or
+    BlockStmt* body;    // block body
+    LambdaExpr(List<FunctionDecl::Param> p, Expression* r, BlockStmt* b)
+        : params(p), result(r), body(b) { type = LAMBDA_EXPR; }
 };
 
 struct LetStmt : Statement {
-    std::string name;
-    std::string typeName; // "Value" by default
-    std::unique_ptr<Expression> initializer;
-    LetStmt(std::string n, std::string t, std::unique_ptr<Expression> i)
-        : name(n), typeName(t), initializer(std::move(i)) { type = LET_STMT; }
+    std::string_view name;
+    std::string_view typeName; // "Value" by default
+    Expression* initializer;
+    bool fixed = false; // the only declaration of name in its scope, never assigned (set by Optimizer)
+    LetStmt(std::string_view n, std::string_view t, Expression* i)
+        : name(n), typeName(t), initializer(i) { type = LET_STMT; }
 };
 
 struct ExprStmt : Statement {
-    std::unique_ptr<Expression> expr;
-    ExprStmt(std::unique_ptr<Expression> e) : expr(std::move(e)) { type = EXPR_STMT; }
+    Expression* expr;
+    ExprStmt(Expression* e) : expr(e) { type = EXPR_STMT; }
 };
 
 struct AssignStmt : Statement {
-    std::string name;
-    std::unique_ptr<Expression> value;
-    AssignStmt(std::string n, std::unique_ptr<Expression> v)
-        : name(n), value(std::move(v)) { type = ASSIGN_STMT; }
+    std::string_view name;
+    Expression* value;
+    const Type* signal = nullptr; // set by TypeInference when the name is a сигнал
+    AssignStmt(std::string_view n, Expression* v)
+        : name(n), value(v) { type = ASSIGN_STMT; }
+};
+
+// `імпорт "шлях.uas"`; resolved by the ModuleLoader, ignored by later passes.
+struct ImportStmt : Statement {
+    std::string_view path;
+    ImportStmt(std::string_view p) : path(p) { type = IMPORT_STMT; }
+};
+
+struct IndexAssignStmt : Statement {
+    IndexExpr* target;
+    Expression* value;
+    IndexAssignStmt(IndexExpr* t, Expression* v)
+        : target(t), value(v) { type = INDEX_ASSIGN_STMT; }
+};
+
+// `p.x = v`, also through indexes and other fields: `ps[і].швидкість.x = v`
+struct FieldAssignStmt : Statement {
+    FieldExpr* target;
+    Expression* value;
+    FieldAssignStmt(FieldExpr* t, Expression* v)
+        : target(t), value(v) { type = FIELD_ASSIGN_STMT; }
 };
 
 struct AssignExpr : Expression {
-    std::string name;
-    std::unique_ptr<Expression> value;
-    AssignExpr(std::string n, std::unique_ptr<Expression> v)
-        : name(n), value(std::move(v)) { type = ASSIGN_EXPR; }
+    std::string_view name;
+    Expression* value;
+    const Type* signal = nullptr; // as in AssignStmt
+    AssignExpr(std::string_view n, Expression* v)
+        : name(n), value(v) { type = ASSIGN_EXPR; }
+};
+
+// Deep copy of a function body into `arena`, for the specializations
+// TypeInference makes. Names and spellings stay views into the original.
+struct Cloner {
+    Arena& arena;
+
+    template <typename T>
+    T* copy(T* node) { return arena.make<T>(*node); }
+
+    template <typename T>
+    List<T> clone(const List<T>& list) {
+        std::vector<T> items(list.begin(), list.end());
+        for (T& item : items) item = clone(item);
+        return List<T>(arena, items);
+    }
+
+    BlockStmt* clone(BlockStmt* blk) { return blk ? (BlockStmt*)clone((Statement*)blk) : nullptr; }
+
+    Statement* clone(Statement* stmt) {
+        if (!stmt) return nullptr;
+        switch (stmt->type) {
+            case FUNCTION_DECL: {
+                FunctionDecl* s = copy((FunctionDecl*)stmt);
+                s->body = clone(s->body);
+                return s;
+            }
+            case BLOCK_STMT: {
+                BlockStmt* s = copy((BlockStmt*)stmt);
+                s->statements = clone(s->statements);
+                return s;
+            }
+            case IF_STMT: {
+                IfStmt* s = copy((IfStmt*)stmt);
+                s->condition = clone(s->condition);
+                s->thenBranch = clone(s->thenBranch);
+                s->elseBranch = clone(s->elseBranch);
+                return s;
+            }
+            case SWITCH_STMT: {
+                SwitchStmt* s = copy((SwitchStmt*)stmt);
+                s->discriminant = clone(s->discriminant);
+                std::vector<SwitchStmt::Case> cases(s->cases.begin(), s->cases.end());
+                for (auto& c : cases) {
+                    c.value = clone(c.value);
+                    c.guard = clone(c.guard);
+                    c.body = clone(c.body);
+                }
+                s->cases = List<SwitchStmt::Case>(arena, cases);
+                return s;
+            }
+            case WHILE_STMT: {
+                WhileStmt* s = copy((WhileStmt*)stmt);
+                s->condition = clone(s->condition);
+                s->body = clone(s->body);
+                return s;
+            }
+            case FOR_STMT: {
+                ForStmt* s = copy((ForStmt*)stmt);
+                s->iterable = clone(s->iterable);
+                s->from = clone(s->from);
+                s->to = clone(s->to);
+                s->body = clone(s->body);
+                return s;
+            }
+            case SPAWN_STMT: {
+                SpawnStmt* s = copy((SpawnStmt*)stmt);
+                s->body = clone(s->body);
+                return s;
+            }
+            case RETURN_STMT: {
+                ReturnStmt* s = copy((ReturnStmt*)stmt);
+                s->value = clone(s->value);
+                return s;
+            }
+            case LET_STMT: {
+                LetStmt* s = copy((LetStmt*)stmt);
+                s->initializer = clone(s->initializer);
+                return s;
+            }
+            case ASSIGN_STMT: {
+                AssignStmt* s = copy((AssignStmt*)stmt);
+                s->value = clone(s->value);
+                return s;
+            }
+            case EXPR_STMT: {
+                ExprStmt* s = copy((ExprStmt*)stmt);
+                s->expr = clone(s->expr);
+                return s;
+            }
+            case INDEX_ASSIGN_STMT: {
+                IndexAssignStmt* s = copy((IndexAssignStmt*)stmt);
+                s->target = (IndexExpr*)clone(s->target);
+                s->value = clone(s->value);
+                return s;
+            }
+            case FIELD_ASSIGN_STMT: {
+                FieldAssignStmt* s = copy((FieldAssignStmt*)stmt);
+                s->target = (FieldExpr*)clone(s->target);
+                s->value = clone(s->value);
+                return s;
+            }
+            case IMPORT_STMT: return copy((ImportStmt*)stmt);
+            default:
+                return stmt; // classes are never nested in a function
+        }
+    }
+
+    Expression* clone(Expression* expr) {
+        if (!expr) return nullptr;
+        switch (expr->type) {
+            case IDENTIFIER: return copy((Identifier*)expr);
+            case LITERAL: return copy((Literal*)expr);
+            case BINARY_EXPR: {
+                BinaryExpr* e = copy((BinaryExpr*)expr);
+                e->left = clone(e->left);
+                e->right = clone(e->right);
+                return e;
+            }
+            case UNARY_EXPR: {
+                UnaryExpr* e = copy((UnaryExpr*)expr);
+                e->right = clone(e->right);
+                return e;
+            }
+            case CALL_EXPR: {
+                CallExpr* e = copy((CallExpr*)expr);
+                e->callee = clone(e->callee);
+                e->args = clone(e->args);
+                return e;
+            }
+            case LIST_EXPR: {
+                ListExpr* e = copy((ListExpr*)expr);
+                e->items = clone(e->items);
+                return e;
+            }
+            case MAP_EXPR: {
+                MapExpr* e = copy((MapExpr*)expr);
+                e->keys = clone(e->keys);
+                e->values = clone(e->values);
+                return e;
+            }
+            case INDEX_EXPR: {
+                IndexExpr* e = copy((IndexExpr*)expr);
+                e->target = clone(e->target);
+                e->index = clone(e->index);
+                return e;
+            }
+            case FIELD_EXPR: {
+                FieldExpr* e = copy((FieldExpr*)expr);
+                e->object = clone(e->object);
+                return e;
+            }
+            case CHANNEL_EXPR: {
+                ChannelExpr* e = copy((ChannelExpr*)expr);
+                e->capacity = clone(e->capacity);
+                return e;
+            }
+            case LAMBDA_EXPR: {
+                LambdaExpr* e = copy((LambdaExpr*)expr);
+                e->result = clone(e->result);
+                e->body = clone(e->body);
+                return e;
+            }
+            case ASSIGN_EXPR: {
+                AssignExpr* e = copy((AssignExpr*)expr);
+                e->value = clone(e->value);
+                return e;
+            }
+            default:
+                return expr;
+        }
+    }
 };
 
+inline void walk(Expression* e, const std::function<void(Expression*)>& onExpr);
+
+// Every statement and expression under `stmt`, in source order; either
+// callback may be null.
+inline void walk(Statement* stmt, const std::function<void(Statement*)>& onStmt,
+                 const std::function<void(Expression*)>& onExpr) {
+    if (!stmt) return;
+    if (onStmt) onStmt(stmt);
+    auto expr = [&](Expression* e) { if (e && onExpr) walk(e, onExpr); };
+    switch (stmt->type) {
+        case BLOCK_STMT:
+            for (Statement* s : ((BlockStmt*)stmt)->statements) walk(s, onStmt, onExpr);
+            break;
+        case IF_STMT:
+            expr(((IfStmt*)stmt)->condition);
+            walk(((IfStmt*)stmt)->thenBranch, onStmt, onExpr);
+            walk(((IfStmt*)stmt)->elseBranch, onStmt, onExpr);
+            break;
+        case SWITCH_STMT:
+            expr(((SwitchStmt*)stmt)->discriminant);
+            for (auto& c : ((SwitchStmt*)stmt)->cases) {
+                expr(c.value);
+                expr(c.guard);
+                walk(c.body, onStmt, onExpr);
+            }
+            break;
+        case WHILE_STMT:
+            expr(((WhileStmt*)stmt)->condition);
+            walk(((WhileStmt*)stmt)->body, onStmt, onExpr);
+            break;
+        case FOR_STMT:
+            expr(((ForStmt*)stmt)->iterable);
+            expr(((ForStmt*)stmt)->from);
+            expr(((ForStmt*)stmt)->to);
+            walk(((ForStmt*)stmt)->body, onStmt, onExpr);
+            break;
+        case SPAWN_STMT: walk(((SpawnStmt*)stmt)->body, onStmt, onExpr); break;
+        case INDEX_ASSIGN_STMT:
+            expr(((IndexAssignStmt*)stmt)->target);
+            expr(((IndexAssignStmt*)stmt)->value);
+            break;
+        case FIELD_ASSIGN_STMT:
+            expr(((FieldAssignStmt*)stmt)->target);
+            expr(((FieldAssignStmt*)stmt)->value);
+            break;
+        case RETURN_STMT: expr(((ReturnStmt*)stmt)->value); break;
+        case LET_STMT: expr(((LetStmt*)stmt)->initializer); break;
+        case ASSIGN_STMT: expr(((AssignStmt*)stmt)->value); break;
+        case EXPR_STMT: expr(((ExprStmt*)stmt)->expr); break;
+        default: break;
+    }
+}
+
+inline void walk(Expression* e, const std::function<void(Expression*)>& onExpr) {
+    onExpr(e);
+    switch (e->type) {
+        case ASSIGN_EXPR: walk(((AssignExpr*)e)->value, onExpr); break;
+        case BINARY_EXPR:
+            walk(((BinaryExpr*)e)->left, onExpr);
+            walk(((BinaryExpr*)e)->right, onExpr);
+            break;
+        case UNARY_EXPR: walk(((UnaryExpr*)e)->right, onExpr); break;
+        case CALL_EXPR: {
+            CallExpr* call = (CallExpr*)e;
+            walk(call->callee, onExpr);
+            for (size_t i = 0; i < call->args.size(); i++) {
+                // A копія's `field = value` arguments name fields, not variables.
+                Expression* arg = call->args[i];
+                if (i > 0 && call->constructs && call->receiver) arg = ((AssignExpr*)arg)->value;
+                walk(arg, onExpr);
+            }
+            break;
+        }
+        case LIST_EXPR:
+            for (Expression* item : ((ListExpr*)e)->items) walk(item, onExpr);
+            break;
+        case MAP_EXPR:
+            for (Expression* k : ((MapExpr*)e)->keys) walk(k, onExpr);
+            for (Expression* v : ((MapExpr*)e)->values) walk(v, onExpr);
+            break;
+        case INDEX_EXPR:
+            walk(((IndexExpr*)e)->target, onExpr);
+            walk(((IndexExpr*)e)->index, onExpr);
+            break;
+        case FIELD_EXPR: walk(((FieldExpr*)e)->object, onExpr); break;
+        case CHANNEL_EXPR: if (((ChannelExpr*)e)->capacity) walk(((ChannelExpr*)e)->capacity, onExpr); break;
+        case LAMBDA_EXPR:
+            // Statements of a block body are not reported: its returns
+            // and writes stay inside the lambda.
+            if (((LambdaExpr*)e)->result) walk(((LambdaExpr*)e)->result, onExpr);
+            else walk(((LambdaExpr*)e)->body, nullptr, onExpr);
+            break;
+        default: break;
+    }
+}
+
 #endif
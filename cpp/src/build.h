@@ -0,0 +1,372 @@
+#ifndef BUILD_H
+#define BUILD_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef UAS_CXX
+#define UAS_CXX "clang++"
+#endif
+
+#ifndef UAS_RUNTIME_DIR
+#define UAS_RUNTIME_DIR "cpp/runtime"
+#endif
+
+// Native build driver: pipes transpiled C++ straight into the compiler and
+// keeps the resulting binaries in a content-addressed cache, so re-running
+// an unchanged script skips the C++ compile entirely. The runtime headers
+// are compiled once into a cached precompiled header that every build reuses.
+class NativeBuilder {
+public:
+    std::string cxx;
+    std::string runtimeDir;
+    std::string cacheDir;
+    std::vector<std::string> flags = {"-std=c++17", "-O3", "-pthread"};
+    std::vector<std::string> linkFlags;
+    bool usePch = true;
+
+    NativeBuilder() {
+        cxx = envOr("UAS_CXX", UAS_CXX);
+        runtimeDir = envOr("UAS_RUNTIME", UAS_RUNTIME_DIR);
+        cacheDir = defaultCacheDir();
+        if (getenv("UAS_NO_PCH")) usePch = false;
+    }
+
+    // Optimization tiers: "fast" for quick edit-run cycles, "release" (the
+    // default) for benchmarks, "native" for this machine only. Flags are part
+    // of every cache key, so switching tiers never reuses a stale binary.
+    bool setTier(const std::string& tier) {
+        linkFlags.clear();
+        if (tier == "fast") {
+            flags = {"-std=c++17", "-O1", "-pthread"};
+            if (onPath("ld.lld")) linkFlags.push_back("-fuse-ld=lld");
+        } else if (tier == "release") {
+            flags = {"-std=c++17", "-O3", "-pthread"};
+        } else if (tier == "native") {
+            flags = {"-std=c++17", "-O3", "-march=native", "-flto", "-pthread"};
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Returns the path of a binary built from cppCode, or "" on failure.
+    std::string build(const std::string& cppCode) {
+        std::string binary = cacheDir + "/" + toHex(cacheKey(cppCode));
+        if (access(binary.c_str(), X_OK) == 0) return binary;
+
+        if (!makeDirs(cacheDir)) {
+            std::cerr << "Could not create cache directory " << cacheDir << std::endl;
+            return "";
+        }
+        // Build next to the final name and rename, so a concurrent or
+        // interrupted build never leaves a truncated binary in the cache.
+        std::string tmp = binary + ".tmp" + std::to_string(getpid());
+        std::string pch = usePch ? precompiledHeader() : "";
+        if (!compile(cppCode, tmp, pch)) {
+            unlink(tmp.c_str());
+            return "";
+        }
+        if (rename(tmp.c_str(), binary.c_str()) != 0) {
+            std::cerr << "Could not move binary into cache: " << binary << std::endl;
+            unlink(tmp.c_str());
+            return "";
+        }
+        return binary;
+    }
+
+    // One separately compiled module: its header is included by the
+    // modules that import it, under a name derived from its contents.
+    struct ModuleUnit {
+        std::string headerName;
+        std::string header;
+        std::string source;
+    };
+
+    static std::string headerName(const std::string& header) {
+        return "m-" + toHex(fnv1a(1469598103934665603ULL, header)) + ".h";
+    }
+
+    // Compiles each module to a cached object, running the missing ones in
+    // parallel, and links them. A module's object key covers its source,
+    // whose #includes name its imports' headers by content, so only
+    // modules whose code or imported signatures changed are rebuilt.
+    std::string buildModules(const std::vector<ModuleUnit>& units) {
+        std::string moduleDir = cacheDir + "/modules";
+        if (!makeDirs(moduleDir)) {
+            std::cerr << "Could not create cache directory " << moduleDir << std::endl;
+            return "";
+        }
+        std::string pch = usePch ? precompiledHeader() : "";
+        uint64_t base = runtimeKey();
+
+        std::vector<std::string> objects;
+        std::vector<std::string> jobs;
+        std::vector<std::string> pending; // tmp objects, renamed when all succeed
+        uint64_t linkKey = base;
+        for (const auto& f : linkFlags) linkKey = fnv1a(linkKey, f);
+        for (const auto& unit : units) {
+            if (!writeOnce(moduleDir + "/" + unit.headerName, unit.header)) {
+                std::cerr << "Could not write " << unit.headerName << std::endl;
+                return "";
+            }
+            std::string key = toHex(fnv1a(base, unit.source));
+            std::string object = moduleDir + "/" + key + ".o";
+            linkKey = fnv1a(linkKey, key);
+            objects.push_back(object);
+            if (access(object.c_str(), R_OK) == 0) continue;
+
+            std::string src = moduleDir + "/" + key + ".cpp";
+            if (!writeOnce(src, unit.source)) {
+                std::cerr << "Could not write " << src << std::endl;
+                return "";
+            }
+            std::string tmp = object + ".tmp" + std::to_string(getpid());
+            std::string cmd = cxx;
+            for (const auto& f : flags) cmd += " " + f;
+            if (!pch.empty()) cmd += " -include " + quote(pch);
+            cmd += " -I" + quote(runtimeDir) + " -I" + quote(moduleDir) + " -c " + quote(src) + " -o " + quote(tmp);
+            jobs.push_back(cmd);
+            pending.push_back(object);
+        }
+
+        std::string binary = cacheDir + "/" + toHex(linkKey);
+        if (jobs.empty() && access(binary.c_str(), X_OK) == 0) return binary;
+
+        bool ok = runParallel(jobs);
+        for (const auto& object : pending) {
+            std::string tmp = object + ".tmp" + std::to_string(getpid());
+            if (!ok || rename(tmp.c_str(), object.c_str()) != 0) {
+                unlink(tmp.c_str());
+                ok = false;
+            }
+        }
+        if (!ok) {
+            std::cerr << "Error: Native compilation failed" << std::endl;
+            return "";
+        }
+
+        std::string tmp = binary + ".tmp" + std::to_string(getpid());
+        std::string cmd = cxx;
+        for (const auto& f : flags) cmd += " " + f;
+        for (const auto& object : objects) cmd += " " + quote(object);
+        cmd += " -o " + quote(tmp);
+        for (const auto& f : linkFlags) cmd += " " + f;
+        int status = system(cmd.c_str());
+        if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+            rename(tmp.c_str(), binary.c_str()) != 0) {
+            std::cerr << "Error: Linking failed" << std::endl;
+            unlink(tmp.c_str());
+            return "";
+        }
+        return binary;
+    }
+
+    static bool copyFile(const std::string& from, const std::string& to) {
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary | std::ios::trunc);
+        if (!in || !out) return false;
+        out << in.rdbuf();
+        out.close();
+        return out.good() && chmod(to.c_str(), 0755) == 0;
+    }
+
+private:
+    bool compile(const std::string& cppCode, const std::string& output, const std::string& pch) {
+        std::string cmd = cxx;
+        for (const auto& f : flags) cmd += " " + f;
+        if (!pch.empty()) cmd += " -include " + quote(pch);
+        cmd += " -I" + quote(runtimeDir) + " -x c++ - -o " + quote(output);
+        for (const auto& f : linkFlags) cmd += " " + f;
+
+        FILE* pipe = popen(cmd.c_str(), "w");
+        if (!pipe) {
+            std::cerr << "Could not start compiler: " << cxx << std::endl;
+            return false;
+        }
+        fwrite(cppCode.data(), 1, cppCode.size(), pipe);
+        int status = pclose(pipe);
+        if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Error: Native compilation failed" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Runs shell commands with at most one per core (or $UAS_JOBS) at a time.
+    static bool runParallel(const std::vector<std::string>& commands) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t limit = cores > 0 ? (size_t)cores : 1;
+        if (const char* jobs = getenv("UAS_JOBS")) limit = std::max(1, atoi(jobs));
+
+        bool ok = true;
+        size_t next = 0, running = 0;
+        while (next < commands.size() || running > 0) {
+            while (running < limit && next < commands.size()) {
+                pid_t pid = fork();
+                if (pid == 0) {
+                    execl("/bin/sh", "sh", "-c", commands[next].c_str(), (char*)nullptr);
+                    _exit(127);
+                }
+                if (pid < 0) {
+                    ok = false;
+                    next = commands.size();
+                    break;
+                }
+                next++;
+                running++;
+            }
+            if (running == 0) break;
+            int status;
+            if (wait(&status) < 0) break;
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+        }
+        return ok;
+    }
+
+    // Content-addressed files never change, so an existing one is kept.
+    static bool writeOnce(const std::string& path, const std::string& content) {
+        if (access(path.c_str(), R_OK) == 0) return true;
+        std::string tmp = path + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out << content;
+            if (!out.good()) return false;
+        }
+        return rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    // Returns the stub header to pass via -include, building its .gch on
+    // first use. The stub has its own name because a quoted include of
+    // "runtime.h" from a file called runtime.h would find itself. Any
+    // failure just means compiling without a PCH.
+    std::string precompiledHeader() {
+        std::string dir = cacheDir + "/pch-" + toHex(runtimeKey());
+        std::string stub = dir + "/uas_pch.h";
+        std::string gch = stub + ".gch";
+        if (access(gch.c_str(), R_OK) == 0) return stub;
+        if (!makeDirs(dir)) return "";
+
+        std::ofstream(stub) << "#include \"runtime.h\"\n";
+        std::string tmp = gch + ".tmp" + std::to_string(getpid());
+        std::string cmd = cxx;
+        for (const auto& f : flags) cmd += " " + f;
+        cmd += " -I" + quote(runtimeDir) + " -x c++-header " + quote(stub) + " -o " + quote(tmp);
+        int status = system(cmd.c_str());
+        if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+            rename(tmp.c_str(), gch.c_str()) != 0) {
+            unlink(tmp.c_str());
+            return "";
+        }
+        return stub;
+    }
+
+    // Everything that can change the produced binary goes into the key:
+    // compiler, flags, the runtime headers and the generated source.
+    uint64_t cacheKey(const std::string& cppCode) {
+        uint64_t h = runtimeKey();
+        for (const auto& f : linkFlags) h = fnv1a(h, f);
+        return fnv1a(h, cppCode);
+    }
+
+    uint64_t runtimeKey() {
+        uint64_t h = 1469598103934665603ULL;
+        h = fnv1a(h, cxx);
+        for (const auto& f : flags) h = fnv1a(h, f);
+        for (const auto& path : runtimeFiles()) {
+            std::ifstream in(path, std::ios::binary);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            h = fnv1a(h, path);
+            h = fnv1a(h, buffer.str());
+        }
+        return h;
+    }
+
+    std::vector<std::string> runtimeFiles() {
+        std::vector<std::string> files;
+        if (DIR* dir = opendir(runtimeDir.c_str())) {
+            while (dirent* entry = readdir(dir)) {
+                std::string name = entry->d_name;
+                if (name.size() > 2 && name.compare(name.size() - 2, 2, ".h") == 0) {
+                    files.push_back(runtimeDir + "/" + name);
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    static uint64_t fnv1a(uint64_t h, const std::string& data) {
+        for (unsigned char c : data) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        // Separator so ("ab", "c") and ("a", "bc") hash differently.
+        h ^= 0xff;
+        h *= 1099511628211ULL;
+        return h;
+    }
+
+    static std::string toHex(uint64_t v) {
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)v);
+        return buf;
+    }
+
+    static bool onPath(const std::string& tool) {
+        const char* path = getenv("PATH");
+        std::stringstream dirs(path ? path : "");
+        std::string dir;
+        while (std::getline(dirs, dir, ':')) {
+            if (!dir.empty() && access((dir + "/" + tool).c_str(), X_OK) == 0) return true;
+        }
+        return false;
+    }
+
+    static std::string envOr(const char* name, const char* fallback) {
+        const char* v = getenv(name);
+        return (v && *v) ? v : fallback;
+    }
+
+    static std::string defaultCacheDir() {
+        if (const char* dir = getenv("UAS_CACHE_DIR")) return dir;
+        if (const char* xdg = getenv("XDG_CACHE_HOME")) return std::string(xdg) + "/uas";
+        if (const char* home = getenv("HOME")) return std::string(home) + "/.cache/uas";
+        return "/tmp/uas-cache";
+    }
+
+    static bool makeDirs(const std::string& path) {
+        for (size_t i = 1; i <= path.size(); i++) {
+            if (i == path.size() || path[i] == '/') {
+                std::string part = path.substr(0, i);
+                if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) return false;
+            }
+        }
+        return true;
+    }
+
+    static std::string quote(const std::string& s) {
+        std::string out = "'";
+        for (char c : s) {
+            if (c == '\'') out += "'\\''";
+            else out += c;
+        }
+        return out + "'";
+    }
+};
+
+#endif
@@ -1,38 +1,110 @@
-
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include "lexer.h"
-#include "parser.h"
+#include <unistd.h>
+#include "modules.h"
 #include "transpiler.h"
+#include "build.h"
+
+static void usage() {
+    std::cerr << "Usage: uas_transpiler <file.uas>" << std::endl;
+    std::cerr << "       uas_transpiler --build [tier] <file.uas> [-o output]" << std::endl;
+    std::cerr << "       uas_transpiler --run [tier] <file.uas> [args...]" << std::endl;
+    std::cerr << "Tiers: --fast (-O1, lld), --release (-O3, default), --native (-march=native -flto)" << std::endl;
+    std::cerr << "--profile: time every function; the program prints a profile and writes uas-profile.folded at exit" << std::endl;
+    std::cerr << "--debug: compile with -g, so gdb and perf show .uas lines; --no-lines: emit no #line directives" << std::endl;
+}
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: uas_transpiler <file.uas>" << std::endl;
+        usage();
         return 1;
     }
     
-    std::string path = argv[1];
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Could not open file " << path << std::endl;
+    enum { EMIT, BUILD, RUN } mode = EMIT;
+    int argi = 1;
+    std::string output;
+    std::string tier = "release";
+    bool profile = false;
+    bool debug = false;
+    bool lines = true;
+    for (; argi < argc && argv[argi][0] == '-' && argv[argi][1] == '-'; argi++) {
+        std::string opt = argv[argi];
+        if (opt == "--build") mode = BUILD;
+        else if (opt == "--run") mode = RUN;
+        else if (opt == "--fast" || opt == "--release" || opt == "--native") tier = opt.substr(2);
+        else if (opt == "--profile") profile = true;
+        else if (opt == "--debug") debug = true;
+        else if (opt == "--no-lines") lines = false;
+        else {
+            std::cerr << "Unknown option " << opt << std::endl;
+            usage();
+            return 1;
+        }
+    }
+    if (argi >= argc) {
+        usage();
         return 1;
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
-    
-    Lexer lexer(source);
-    auto tokens = lexer.tokenize();
+    std::string path = argv[argi++];
+    if (mode == BUILD && argi + 1 < argc && std::string(argv[argi]) == "-o") {
+        output = argv[argi + 1];
+        argi += 2;
+    }
     
-    Parser parser(tokens);
-    auto program = parser.parse();
+    ModuleLoader loader;
+    if (!loader.load(path)) return 1;
     
-    Transpiler transpiler;
-    std::string cppCode = transpiler.transpile(program.get());
+    NativeBuilder builder;
+    builder.setTier(tier);
+    if (debug) builder.flags.push_back("-g");
+    std::string binary;
+    if (mode == EMIT || loader.order.size() == 1) {
+        // Printing, or a single module: one translation unit.
+        Transpiler transpiler;
+        transpiler.profile = profile;
+        transpiler.lines = lines;
+        std::string cppCode = transpiler.transpile(loader.programs(), loader.initNames());
+        if (mode == EMIT) {
+            std::cout << cppCode;
+            return 0;
+        }
+        binary = builder.build(cppCode);
+    } else {
+        // A module graph: one object per module, compiled in parallel.
+        std::map<Module*, std::string> headers;
+        std::vector<NativeBuilder::ModuleUnit> units;
+        for (Module* m : loader.order) {
+            std::vector<std::string> includes;
+            for (Module* dep : m->imports) includes.push_back(headers[dep]);
+            bool entry = m == loader.entry();
+            Transpiler transpiler;
+            transpiler.profile = profile;
+            transpiler.lines = lines;
+            auto code = transpiler.transpileModule(m->program.get(), m->initName, includes,
+                                                   entry ? loader.initNames() : std::vector<std::string>(), entry);
+            headers[m] = NativeBuilder::headerName(code.header);
+            units.push_back({headers[m], code.header, code.source});
+        }
+        binary = builder.buildModules(units);
+    }
+    if (binary.empty()) return 1;
     
-    std::cout << cppCode;
+    if (mode == BUILD) {
+        if (output.empty()) {
+            std::cout << binary << std::endl;
+        } else if (!NativeBuilder::copyFile(binary, output)) {
+            std::cerr << "Could not write " << output << std::endl;
+            return 1;
+        }
+        return 0;
+    }
     
-    return 0;
+    // --run: the script's own arguments follow the file name.
+    std::vector<char*> args;
+    args.push_back((char*)binary.c_str());
+    for (int i = argi; i < argc; i++) args.push_back(argv[i]);
+    args.push_back(nullptr);
+    execv(binary.c_str(), args.data());
+    std::cerr << "Could not execute " << binary << std::endl;
+    return 1;
 }
@@ -0,0 +1,1355 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include "ast.h"
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+// Local type inference. Propagates literal and return types through lets,
+// assignments, binary expressions and calls, then writes the result back
+// into the same typeName/returnType fields a user annotation would fill,
+// so the Transpiler only falls back to Value for genuinely dynamic code.
+class TypeInference {
+    typedef std::map<std::string_view, const Type*> Scope;
+
+    std::map<std::string_view, FunctionDecl*> functions;
+    std::map<std::string_view, const Type*> returnTypes;
+    std::map<std::string_view, ClassDecl*> classes;
+    std::map<FunctionDecl*, ClassDecl*> owners;       // methods, by their class
+    std::map<FunctionDecl*, const Type*> methodTypes; // methods' return types
+    std::map<const ClassDecl::Field*, const Type*> fieldTypes;
+    std::set<ClassDecl::Field*> inferField;           // body lets without a type annotation
+    std::set<FunctionDecl*> inferReturn;   // functions and methods without a return annotation
+    std::set<LetStmt*> inferLet;           // lets without a type annotation
+    std::map<LetStmt*, FunctionDecl*> letOwner;
+    std::map<FunctionDecl*, Scope> scopes; // nullptr is the top-level scope
+    std::map<FunctionDecl*, std::set<std::string_view>> inferable;
+
+    FunctionDecl* currentFn = nullptr;
+    ClassDecl* currentClass = nullptr; // whose fields bare names also reach
+    // Enclosing `запустити` (nullptr) and block lambda bodies, innermost
+    // last: a return there ends that body, and a lambda's returns give
+    // its result type.
+    std::vector<const Type**> closures;
+    const Type* stageElement = nullptr; // what a stream stage passes the function being inferred
+    bool changed = false;
+    std::string path;         // of the program, for messages
+    const Node* at = nullptr; // innermost statement or expression being inferred, for messages
+    std::set<Expression*> wholes; // typed Type::whole(), which staticType spells число
+    std::map<std::string_view, ForStmt*> counters; // whose body is being inferred, by variable
+    std::set<ForStmt*> integerCounters;            // ranges whose counter a ціле demanded
+    std::map<ForStmt*, const Type*> counterTypes;
+
+    // Monomorphization; see specialization().
+    struct Site {
+        FunctionDecl* caller;  // nullptr at top level
+        FunctionDecl* generic; // the function the source names
+        FunctionDecl* target;  // it or a specialization; nullptr while an argument's type is unknown
+    };
+    static const size_t MAX_SPECIALIZATIONS = 8; // per function; further calls take the generic one
+    Arena* arena = nullptr;
+    std::map<std::pair<FunctionDecl*, std::vector<const Type*>>, FunctionDecl*> specializations;
+    std::vector<FunctionDecl*> clones;                       // in the order they were made
+    std::map<FunctionDecl*, std::set<size_t>> dynamicParams; // parameters a specialization's body widens
+    std::map<CallExpr*, Site> sites;                         // every call of a function of this module
+    std::set<FunctionDecl*> referenced;                      // functions named other than as a callee
+    std::map<FunctionDecl*, std::string> deferred;           // errors in generic functions, fatal if they stay
+
+public:
+    // Set for an imported module: other modules call its functions as
+    // declared, so an unannotated one stays even when every call in this
+    // module goes to a specialization.
+    bool library = false;
+
+    // Makes a function of an already inferred module callable from this one.
+    void declare(FunctionDecl* fn) {
+        returnTypes[fn->name] = Type::fromName(fn->returnType);
+    }
+
+    // The same for a class; its field and method types are already final.
+    void declare(ClassDecl* cls) {
+        classes[cls->name] = cls;
+        Type::object(cls->name);
+        for (const auto& f : cls->fields) fieldTypes[&f] = Type::fromName(f.typeName);
+        for (FunctionDecl* m : cls->methods) {
+            owners[m] = cls;
+            methodTypes[m] = Type::fromName(m->returnType);
+        }
+    }
+
+    void run(Program* program) {
+        arena = &program->arena;
+        path = program->path;
+        // Class names first: annotations anywhere may use them.
+        for (Statement* stmt : program->body) {
+            if (stmt->type == CLASS_DECL) Type::object(((ClassDecl*)stmt)->name);
+        }
+        for (Statement* stmt : program->body) {
+            if (stmt->type != CLASS_DECL) continue;
+            ClassDecl* cls = (ClassDecl*)stmt;
+            at = cls;
+            if (classes.count(cls->name)) error("class " + std::string(cls->name) + " is declared twice");
+            declare(cls);
+            for (auto& f : cls->fields) {
+                if (f.typeName != "Value" || !f.initializer) continue;
+                inferField.insert(&f);
+                fieldTypes[&f] = Type::unknown();
+            }
+            for (FunctionDecl* m : cls->methods) {
+                at = m;
+                if (cls->field(m->name)) error(std::string(cls->name) + " has a field and a method named " + std::string(m->name));
+                if (m->returnType != "Value") continue;
+                inferReturn.insert(m);
+                methodTypes[m] = Type::unknown();
+            }
+        }
+        at = nullptr;
+        for (Statement* stmt : program->body) {
+            if (stmt->type != FUNCTION_DECL) continue;
+            FunctionDecl* fn = (FunctionDecl*)stmt;
+            functions[fn->name] = fn;
+            if (fn->returnType == "Value") {
+                inferReturn.insert(fn);
+                returnTypes[fn->name] = Type::unknown();
+            } else {
+                returnTypes[fn->name] = Type::fromName(fn->returnType);
+            }
+        }
+
+        // Types only ever move up the lattice, so this reaches a fixpoint.
+        do {
+            changed = false;
+            for (Statement* stmt : program->body) {
+                if (stmt->type == FUNCTION_DECL) inferFunction((FunctionDecl*)stmt);
+                if (stmt->type == CLASS_DECL) inferClass((ClassDecl*)stmt);
+            }
+            for (size_t i = 0; i < clones.size(); i++) inferFunction(clones[i]);
+            currentFn = nullptr;
+            for (Statement* stmt : program->body) {
+                if (stmt->type != FUNCTION_DECL) inferStmt(stmt);
+            }
+        } while (changed);
+        placeSpecializations(program);
+
+        // A list spelling is owned by its interned Type, so the views stay valid.
+        for (FunctionDecl* fn : inferReturn) fn->returnType = Type::resolved(returnSlot(fn))->name();
+        for (ClassDecl::Field* f : inferField) f->typeName = Type::resolved(fieldTypes[f])->name();
+        for (LetStmt* let : inferLet) {
+            FunctionDecl* owner = letOwner[let];
+            let->typeName = Type::resolved(scopes[owner][let->name])->name();
+        }
+        exactIntegers(program);
+    }
+
+private:
+    void inferFunction(FunctionDecl* fn) {
+        currentFn = fn;
+        Scope& scope = scopes[fn];
+        for (const auto& p : fn->params) scope[p.name] = Type::fromName(p.typeName);
+        inferStmt(fn->body);
+    }
+
+    // Field initializers see the fields (which C++ constructs in order)
+    // and nothing else, so they are inferred in an empty top-level scope.
+    void inferClass(ClassDecl* cls) {
+        currentClass = cls;
+        currentFn = nullptr;
+        Scope outer;
+        std::swap(outer, scopes[nullptr]);
+        for (auto& f : cls->fields) {
+            if (!f.initializer) continue;
+            const Type* t = Type::settled(infer(f.initializer));
+            if (!inferField.count(&f)) continue;
+            const Type* joined = Type::join(fieldTypes[&f], t);
+            if (joined != fieldTypes[&f]) {
+                fieldTypes[&f] = joined;
+                changed = true;
+            }
+        }
+        std::swap(outer, scopes[nullptr]);
+        for (FunctionDecl* m : cls->methods) inferFunction(m);
+        currentClass = nullptr;
+    }
+
+    // Where a function's (or method's) return type is kept.
+    const Type*& returnSlot(FunctionDecl* fn) {
+        if (owners.count(fn)) return methodTypes[fn];
+        return returnTypes[fn->name];
+    }
+
+    ClassDecl* classOf(const Type* t) {
+        if (t->kind != TY_CLASS) return nullptr;
+        auto it = classes.find(t->spelling);
+        return it == classes.end() ? nullptr : it->second;
+    }
+
+    const Type* fieldType(ClassDecl* cls, std::string_view name) {
+        const ClassDecl::Field* f = cls ? cls->field(name) : nullptr;
+        return f ? fieldTypes[f] : nullptr;
+    }
+
+    // Objects have no dynamic form, so a Value cannot hold one: joining an
+    // object with anything else is an error rather than a silent Value.
+    void checkJoin(const Type* a, const Type* b, const std::string& what) {
+        if (losesObject(a, b)) error(what + " mixes " + std::string(a->name()) + " with " + std::string(b->name()));
+    }
+
+    static bool losesObject(const Type* a, const Type* b) {
+        if (a->kind == TY_UNKNOWN || b->kind == TY_UNKNOWN || a == b) return false;
+        if (a->kind == TY_CLASS || b->kind == TY_CLASS) return true;
+        if (a->kind != b->kind) return false;
+        if (a->kind == TY_MAP && losesObject(a->key, b->key)) return true;
+        return a->element && b->element && losesObject(a->element, b->element);
+    }
+
+    // `message` and where it arose, as the parser reports it.
+    std::string located(const std::string& message) const {
+        if (!at || !at->line) return message;
+        std::string where = "line " + std::to_string(at->line) + ", column " + std::to_string(at->column);
+        return message + " (" + (path.empty() ? where : path + ", " + where) + ")";
+    }
+
+    [[noreturn]] void error(const std::string& message) const {
+        std::cerr << "Error: " << located(message) << std::endl;
+        exit(1);
+    }
+
+    // Widens a variable declared by an unannotated let.
+    void assign(std::string_view name, const Type* t) {
+        if (!inferable[currentFn].count(name)) {
+            widenParameter(name, t);
+            return;
+        }
+        Scope& scope = scopes[currentFn];
+        const Type* old = scope.count(name) ? scope[name] : Type::unknown();
+        checkJoin(old, t, std::string(name));
+        const Type* joined = Type::join(old, t);
+        scope[name] = joined;
+        if (joined != old) changed = true;
+    }
+
+    // An integer literal is число like any other number, and so is what
+    // unannotated code computes from them, so it gets what the dynamic
+    // version would. Such a Type::whole() becomes ціле only where that is
+    // what it meets: an annotated let, parameter, field or result, a ціле
+    // operand, a list position. The literals and unannotated lets it is
+    // made of then turn ціле too. Returns the type `e` now has.
+    const Type* narrow(Expression* e, const Type* t, const Type* want) {
+        if (want->kind == TY_INT && t == Type::whole()) {
+            makeInteger(e);
+            return Type::integer();
+        }
+        if (want->kind == TY_LIST && e->type == LIST_EXPR && t->kind == TY_LIST) {
+            const Type* element = Type::unknown();
+            for (Expression* item : ((ListExpr*)e)->items) element = Type::join(element, narrow(item, inferred(item), want->element));
+            return settle(e, Type::list(element));
+        }
+        if (want->kind == TY_MAP && e->type == MAP_EXPR && t->kind == TY_MAP) {
+            MapExpr* m = (MapExpr*)e;
+            const Type* key = Type::unknown();
+            const Type* value = Type::unknown();
+            for (Expression* k : m->keys) key = Type::join(key, narrow(k, inferred(k), want->key));
+            for (Expression* v : m->values) value = Type::join(value, narrow(v, inferred(v), want->element));
+            return settle(e, Type::map(key, value));
+        }
+        return t;
+    }
+
+    // What is still unknown in `t` (the elements of a `[]`) stays unknown
+    // for the variable, so later pushes and stores decide it.
+    static const Type* settle(Expression* e, const Type* t) {
+        e->staticType = Type::resolved(t);
+        return t;
+    }
+
+    // Only literals, lets and arithmetic on them are whole (see infer()).
+    void makeInteger(Expression* e) {
+        e->staticType = Type::integer();
+        wholes.erase(e);
+        switch (e->type) {
+            case IDENTIFIER: {
+                std::string_view name = ((Identifier*)e)->name;
+                auto loop = counters.find(name);
+                if (loop == counters.end() || !loop->second) assign(name, Type::integer());
+                else if (integerCounters.insert(loop->second).second) changed = true; // see rangeType()
+                break;
+            }
+            case UNARY_EXPR: makeInteger(((UnaryExpr*)e)->right); break;
+            case BINARY_EXPR:
+                makeInteger(((BinaryExpr*)e)->left);
+                makeInteger(((BinaryExpr*)e)->right);
+                break;
+            default: break;
+        }
+    }
+
+    const Type* inferred(Expression* e) { return wholes.count(e) ? Type::whole() : e->staticType; }
+
+    static bool integerLiteral(Expression* e) {
+        return e->type == LITERAL && ((Literal*)e)->kind == LIT_INT;
+    }
+
+    // A range's counter. Between whole or ціле bounds it only holds
+    // integers, but it is whole like a literal, so `p = p * і` computes
+    // what the dynamic version does. Only once a ціле demands the counter
+    // (an index, an annotated let, a паралельно loop) do it and its whole
+    // bounds turn ціле.
+    const Type* rangeType(ForStmt* s, const Type* a, const Type* b) {
+        if (a->kind == TY_UNKNOWN || b->kind == TY_UNKNOWN) return Type::unknown();
+        if ((a->kind == TY_INT || a == Type::whole()) && (b->kind == TY_INT || b == Type::whole())) {
+            if (s->parallel) integerCounters.insert(s); // chunks are ranges of ціле
+            if (!integerCounters.count(s)) return Type::whole();
+            narrow(s->from, a, Type::integer());
+            narrow(s->to, b, Type::integer());
+            return Type::integer();
+        }
+        if (a->isNumeric() && b->isNumeric()) return Type::number();
+        return Type::value();
+    }
+
+    // Once the types are final. A whole value is число, but where it is
+    // sure to be an integer of magnitude below 2^53, int64_t computes just
+    // what double would, faster: a fixed counter of a range between such
+    // bounds, a fixed let of such a value, and + - * % on them that stay
+    // below 2^53 and cannot make -0. Those are emitted ціле; no result
+    // changes, and as types are final nothing else turns ціле with them.
+    struct Span {
+        double lo, hi;
+    };
+    std::map<std::string_view, Span> spans; // such variables in scope
+    // Names in an exponent of the scope: a ціле one would make `**` ipow(),
+    // which can round differently from pow().
+    std::set<std::string_view> powered;
+
+    void exactIntegers(Program* program) {
+        std::vector<Statement*> top;
+        for (Statement* stmt : program->body) {
+            if (stmt->type == FUNCTION_DECL) exactScope({((FunctionDecl*)stmt)->body});
+            if (stmt->type == CLASS_DECL) {
+                for (FunctionDecl* m : ((ClassDecl*)stmt)->methods) exactScope({m->body});
+            }
+            if (stmt->type != FUNCTION_DECL && stmt->type != CLASS_DECL) top.push_back(stmt);
+        }
+        exactScope(top);
+    }
+
+    void exactScope(const std::vector<Statement*>& body) {
+        spans.clear();
+        powered.clear();
+        for (Statement* stmt : body) {
+            walk(stmt, nullptr, [&](Expression* e) {
+                if (e->type != BINARY_EXPR || ((BinaryExpr*)e)->op != OP_POW) return;
+                walk(((BinaryExpr*)e)->right, [&](Expression* x) {
+                    if (x->type == IDENTIFIER) powered.insert(((Identifier*)x)->name);
+                });
+            });
+        }
+        for (Statement* stmt : body) exactStmt(stmt);
+    }
+
+    // Runs `body` with `name` holding `span`, or nothing exact if null.
+    template <typename F>
+    void within(std::string_view name, const Span* span, F body) {
+        auto old = spans.find(name);
+        bool had = old != spans.end();
+        Span saved = had ? old->second : Span{0, 0};
+        if (span) spans[name] = *span;
+        else spans.erase(name);
+        body();
+        if (had) spans[name] = saved;
+        else spans.erase(name);
+    }
+
+    void exactStmt(Statement* stmt) {
+        if (!stmt) return;
+        switch (stmt->type) {
+            case BLOCK_STMT: {
+                std::map<std::string_view, Span> outer = spans; // its lets end with it
+                for (Statement* s : ((BlockStmt*)stmt)->statements) exactStmt(s);
+                spans = outer;
+                break;
+            }
+            case IF_STMT:
+                exact(((IfStmt*)stmt)->condition);
+                exactStmt(((IfStmt*)stmt)->thenBranch);
+                exactStmt(((IfStmt*)stmt)->elseBranch);
+                break;
+            case SWITCH_STMT: {
+                SwitchStmt* s = (SwitchStmt*)stmt;
+                exact(s->discriminant);
+                for (auto& c : s->cases) {
+                    within(c.patternName, nullptr, [&] {
+                        if (c.value) exact(c.value);
+                        if (c.guard) exact(c.guard);
+                        exactStmt(c.body);
+                    });
+                }
+                break;
+            }
+            case WHILE_STMT:
+                exact(((WhileStmt*)stmt)->condition);
+                exactStmt(((WhileStmt*)stmt)->body);
+                break;
+            case FOR_STMT: {
+                ForStmt* s = (ForStmt*)stmt;
+                if (s->iterable) {
+                    Span values;
+                    bool known = s->fixed && !powered.count(s->var) && s->iterable->staticType->kind == TY_STREAM ? streamSpan(s->iterable, values) : (exact(s->iterable), false);
+                    within(s->var, known ? &values : nullptr, [&] { exactStmt(s->body); });
+                    break;
+                }
+                // The bounds turn ціле with the counter only, which the loop
+                // then declares int64_t.
+                Span a, b;
+                bool counter = s->fixed && !powered.count(s->var) && counterTypes[s] == Type::whole() && bound(s->from, a) && bound(s->to, b);
+                if (!counter) {
+                    exactWithin(s->from);
+                    exactWithin(s->to);
+                    within(s->var, nullptr, [&] { exactStmt(s->body); });
+                    break;
+                }
+                for (Expression* e : {s->from, s->to}) {
+                    if (numeric(e)) markInteger(e);
+                    else exactWithin(e);
+                }
+                Span values{a.lo, std::max(a.hi, b.hi)};
+                within(s->var, &values, [&] { exactStmt(s->body); });
+                break;
+            }
+            case INDEX_ASSIGN_STMT:
+                exact(((IndexAssignStmt*)stmt)->target);
+                exact(((IndexAssignStmt*)stmt)->value);
+                break;
+            case FIELD_ASSIGN_STMT:
+                exact(((FieldAssignStmt*)stmt)->target);
+                exact(((FieldAssignStmt*)stmt)->value);
+                break;
+            case SPAWN_STMT:
+                exactStmt(((SpawnStmt*)stmt)->body);
+                break;
+            case RETURN_STMT:
+                if (((ReturnStmt*)stmt)->value) exact(((ReturnStmt*)stmt)->value);
+                break;
+            case LET_STMT: {
+                LetStmt* s = (LetStmt*)stmt;
+                Span value;
+                bool whole = s->fixed && !powered.count(s->name) && inferLet.count(s) && s->typeName == "число" && numeric(s->initializer) && span(s->initializer, value);
+                exact(s->initializer);
+                if (whole) {
+                    s->typeName = Type::integer()->name();
+                    spans[s->name] = value;
+                } else {
+                    spans.erase(s->name);
+                }
+                break;
+            }
+            case ASSIGN_STMT:
+                exact(((AssignStmt*)stmt)->value);
+                break;
+            case EXPR_STMT:
+                exact(((ExprStmt*)stmt)->expr);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void exact(Expression* e) {
+        Span s;
+        if (numeric(e) && span(e, s)) markInteger(e);
+        else exactWithin(e);
+    }
+
+    void exactWithin(Expression* e) {
+        switch (e->type) {
+            case ASSIGN_EXPR:
+                exact(((AssignExpr*)e)->value);
+                break;
+            case BINARY_EXPR:
+                exact(((BinaryExpr*)e)->left);
+                if (((BinaryExpr*)e)->op == OP_POW) exactWithin(((BinaryExpr*)e)->right); // stays pow()
+                else exact(((BinaryExpr*)e)->right);
+                break;
+            case UNARY_EXPR:
+                exact(((UnaryExpr*)e)->right);
+                break;
+            case CALL_EXPR: {
+                CallExpr* c = (CallExpr*)e;
+                std::string_view op = c->builtin ? c->builtin : "";
+                if ((op == "streamSum" || op == "streamCount" || op == "streamCollect" || op == "streamEach") && !c->args.empty()) {
+                    Span values;
+                    bool known = streamSpan(c->args[0], values);
+                    for (size_t i = 1; i < c->args.size(); i++) exactStage(c->args[i], known ? &values : nullptr, nullptr);
+                    break;
+                }
+                for (Expression* arg : c->args) exact(arg);
+                break;
+            }
+            case LIST_EXPR:
+                for (Expression* item : ((ListExpr*)e)->items) exact(item);
+                break;
+            case MAP_EXPR:
+                for (Expression* k : ((MapExpr*)e)->keys) exact(k);
+                for (Expression* v : ((MapExpr*)e)->values) exact(v);
+                break;
+            case INDEX_EXPR:
+                exact(((IndexExpr*)e)->target);
+                exact(((IndexExpr*)e)->index);
+                break;
+            case FIELD_EXPR:
+                exact(((FieldExpr*)e)->object);
+                break;
+            case CHANNEL_EXPR:
+                if (((ChannelExpr*)e)->capacity) exact(((ChannelExpr*)e)->capacity);
+                break;
+            case LAMBDA_EXPR:
+                exactStage(e, nullptr, nullptr);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // A pipeline is one loop (see Transpiler::streamLoop) whose variable
+    // each stage's type declares. Over a range of exact bounds the stages
+    // that keep it exact turn Потік<ціле>, and the lambdas they call take
+    // their element with its span. Returns whether `e`'s elements are exact.
+    bool streamSpan(Expression* e, Span& out) {
+        CallExpr* c = e->type == CALL_EXPR ? (CallExpr*)e : nullptr;
+        std::string_view op = c && c->builtin ? c->builtin : "";
+        if (op == "streamRange" && c->args.size() == 2 && e->staticType == Type::stream(Type::number())) {
+            Span a, b;
+            if (!bound(c->args[0], a) || !bound(c->args[1], b)) {
+                exactWithin(e);
+                return false;
+            }
+            for (Expression* arg : c->args) {
+                if (numeric(arg)) markInteger(arg);
+                else exactWithin(arg);
+            }
+            out = Span{a.lo, std::max(a.hi, b.hi)};
+        } else if ((op == "streamFilter" || op == "streamTake" || op == "streamMap") && c->args.size() == 2) {
+            Span in;
+            bool known = streamSpan(c->args[0], in);
+            Span result;
+            bool mapped = false;
+            if (op == "streamTake") exact(c->args[1]);
+            else mapped = exactStage(c->args[1], known ? &in : nullptr, op == "streamMap" ? &result : nullptr);
+            if (!known || (op == "streamMap" && !mapped)) return false;
+            out = op == "streamMap" ? result : in;
+        } else {
+            exact(e);
+            return false;
+        }
+        e->staticType = Type::stream(Type::integer());
+        return true;
+    }
+
+    // A lambda, or a stage's function given elements in `in` (null when
+    // they are not exact). With `result`, returns whether the lambda's
+    // result is exact, and then it returns ціле.
+    bool exactStage(Expression* f, const Span* in, Span* result) {
+        if (f->type != LAMBDA_EXPR) {
+            exact(f);
+            return false;
+        }
+        LambdaExpr* l = (LambdaExpr*)f;
+        std::map<std::string_view, Span> outer = spans;
+        for (const auto& p : l->params) spans.erase(p.name);
+        if (in && !l->params.empty() && l->params[0].typeName == "Value" && !powered.count(l->params[0].name)) spans[l->params[0].name] = *in;
+        bool exactResult = false;
+        if (l->result) {
+            exactResult = result && numeric(l->result) && span(l->result, *result);
+            exact(l->result);
+        } else {
+            exactStmt(l->body);
+        }
+        spans = outer;
+        if (exactResult) l->staticType = Type::function(Type::integer());
+        return exactResult;
+    }
+
+    // A range bound: exact, or a ціле, which a counter below it cannot
+    // outgrow in any loop that ends.
+    bool bound(Expression* e, Span& out) {
+        if (e->staticType->kind == TY_INT) {
+            out = Span{-9007199254740992.0, 9007199254740992.0};
+            return true;
+        }
+        return numeric(e) && span(e, out);
+    }
+
+    static bool numeric(Expression* e) { return e->staticType->kind == TY_NUMBER; }
+
+    // The values a число `e` can take, if computing it in int64_t is exact.
+    bool span(Expression* e, Span& out) {
+        const double limit = 9007199254740992.0; // 2^53
+        switch (e->type) {
+            case LITERAL: {
+                Literal* lit = (Literal*)e;
+                if (lit->kind != LIT_INT) return false;
+                double v = strtod(std::string(lit->value).c_str(), nullptr);
+                out = Span{v, v};
+                break;
+            }
+            case IDENTIFIER: {
+                auto it = spans.find(((Identifier*)e)->name);
+                if (it == spans.end()) return false;
+                out = it->second;
+                break;
+            }
+            case UNARY_EXPR: {
+                Span a;
+                if (!span(((UnaryExpr*)e)->right, a) || (a.lo <= 0 && a.hi >= 0)) return false; // -0
+                out = Span{-a.hi, -a.lo};
+                break;
+            }
+            case BINARY_EXPR: {
+                BinaryExpr* b = (BinaryExpr*)e;
+                Span l, r;
+                if (!span(b->left, l) || !span(b->right, r)) return false;
+                bool zeroL = l.lo <= 0 && l.hi >= 0;
+                bool zeroR = r.lo <= 0 && r.hi >= 0;
+                switch (b->op) {
+                    case OP_ADD: out = Span{l.lo + r.lo, l.hi + r.hi}; break;
+                    case OP_SUB: out = Span{l.lo - r.hi, l.hi - r.lo}; break;
+                    case OP_MUL: {
+                        // 0 times a negative is -0 in double.
+                        if (!(l.lo >= 0 && r.lo >= 0) && (zeroL || zeroR)) return false;
+                        double p[] = {l.lo * r.lo, l.lo * r.hi, l.hi * r.lo, l.hi * r.hi};
+                        out = Span{*std::min_element(p, p + 4), *std::max_element(p, p + 4)};
+                        break;
+                    }
+                    case OP_MOD: {
+                        // fmod keeps the dividend's sign, so a negative one can give -0.
+                        if (l.lo < 0 || zeroR) return false;
+                        out = Span{0, std::min(l.hi, std::max(-r.lo, r.hi) - 1)};
+                        break;
+                    }
+                    default:
+                        return false;
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+        return out.lo > -limit && out.hi < limit;
+    }
+
+    // Only what span() accepts: literals, variables and arithmetic.
+    void markInteger(Expression* e) {
+        e->staticType = Type::integer();
+        if (e->type == UNARY_EXPR) markInteger(((UnaryExpr*)e)->right);
+        if (e->type == BINARY_EXPR) {
+            markInteger(((BinaryExpr*)e)->left);
+            markInteger(((BinaryExpr*)e)->right);
+        }
+    }
+
+    void inferStmt(Statement* stmt) {
+        if (!stmt) return;
+        const Node* outer = at;
+        if (stmt->line) at = stmt;
+        switch (stmt->type) {
+            case BLOCK_STMT:
+                for (Statement* s : ((BlockStmt*)stmt)->statements) inferStmt(s);
+                break;
+            case IF_STMT: {
+                IfStmt* s = (IfStmt*)stmt;
+                infer(s->condition);
+                inferStmt(s->thenBranch);
+                inferStmt(s->elseBranch);
+                break;
+            }
+            case SWITCH_STMT: {
+                SwitchStmt* s = (SwitchStmt*)stmt;
+                infer(s->discriminant);
+                for (auto& c : s->cases) {
+                    // Bindings are emitted as `Value name = _sw`.
+                    if (!c.patternName.empty() && c.patternName != "_") {
+                        scopes[currentFn][c.patternName] = Type::value();
+                    }
+                    if (c.value) infer(c.value);
+                    if (c.guard) infer(c.guard);
+                    inferStmt(c.body);
+                }
+                break;
+            }
+            case WHILE_STMT: {
+                WhileStmt* s = (WhileStmt*)stmt;
+                infer(s->condition);
+                inferStmt(s->body);
+                break;
+            }
+            case FOR_STMT: {
+                ForStmt* s = (ForStmt*)stmt;
+                const Type* t;
+                if (s->iterable) {
+                    // Lists yield their elements, maps their keys.
+                    const Type* c = infer(s->iterable);
+                    t = c->kind == TY_LIST || c->kind == TY_STREAM ? c->element : c->kind == TY_MAP ? c->key : c->kind == TY_UNKNOWN ? c : Type::value();
+                } else {
+                    const Type* from = infer(s->from);
+                    const Type* to = infer(s->to);
+                    t = rangeType(s, from, to);
+                }
+                // Like a switch binding, the loop variable has a fixed type;
+                // loops reusing a name can each give it their own.
+                scopes[currentFn][s->var] = t;
+                auto known = counterTypes.find(s);
+                if (known == counterTypes.end() || known->second != t) {
+                    counterTypes[s] = t;
+                    changed = true;
+                }
+                // A body's demands on a whole counter go to this loop.
+                ForStmt* outer = counters.count(s->var) ? counters[s->var] : nullptr;
+                counters[s->var] = !s->iterable && t == Type::whole() ? s : nullptr;
+                inferStmt(s->body);
+                counters[s->var] = outer;
+                break;
+            }
+            case INDEX_ASSIGN_STMT: {
+                IndexAssignStmt* s = (IndexAssignStmt*)stmt;
+                const Type* element = infer(s->target);
+                const Type* t = narrow(s->value, infer(s->value), element);
+                if (s->target->readsSignal) t = Type::signal(t); // the store writes the signal
+                Expression* container = s->target->target;
+                if (container->type == IDENTIFIER) {
+                    // Storing into a list or map declared by an inferable let widens it.
+                    std::string_view name = ((Identifier*)container)->name;
+                    if (container->staticType->kind == TY_MAP) assign(name, Type::map(infer(s->target->index), t));
+                    else assign(name, Type::list(t));
+                }
+                break;
+            }
+            case FIELD_ASSIGN_STMT: {
+                FieldAssignStmt* s = (FieldAssignStmt*)stmt;
+                const Type* field = infer(s->target);
+                checkJoin(field, narrow(s->value, infer(s->value), field), "." + std::string(s->target->field));
+                break;
+            }
+            case SPAWN_STMT:
+                closures.push_back(nullptr);
+                inferStmt(((SpawnStmt*)stmt)->body);
+                closures.pop_back();
+                break;
+            case RETURN_STMT: {
+                ReturnStmt* s = (ReturnStmt*)stmt;
+                const Type* t = s->value ? infer(s->value) : Type::value();
+                if (s->value && closures.empty() && currentFn && !inferReturn.count(currentFn)) t = narrow(s->value, t, returnSlot(currentFn));
+                t = Type::settled(t);
+                if (!closures.empty()) {
+                    if (closures.back()) *closures.back() = Type::join(*closures.back(), t);
+                } else if (currentFn && inferReturn.count(currentFn)) {
+                    const Type*& slot = returnSlot(currentFn);
+                    checkJoin(slot, t, "the result of " + std::string(currentFn->name));
+                    const Type* joined = Type::join(slot, t);
+                    if (joined != slot) {
+                        slot = joined;
+                        changed = true;
+                    }
+                }
+                break;
+            }
+            case LET_STMT: {
+                LetStmt* s = (LetStmt*)stmt;
+                // An unannotated let keeps what earlier passes made of it.
+                const Type* declared = s->typeName == "Value" ? variable(s->name) : Type::fromName(s->typeName);
+                const Type* t = narrow(s->initializer, infer(s->initializer), declared);
+                if (s->typeName == "Value") {
+                    inferLet.insert(s);
+                    letOwner[s] = currentFn;
+                    inferable[currentFn].insert(s->name);
+                    assign(s->name, t);
+                } else {
+                    scopes[currentFn][s->name] = Type::fromName(s->typeName);
+                }
+                break;
+            }
+            case ASSIGN_STMT: {
+                AssignStmt* s = (AssignStmt*)stmt;
+                s->signal = signalNamed(s->name);
+                const Type* t = narrow(s->value, infer(s->value), variable(s->name));
+                assign(s->name, s->signal ? Type::signal(t) : t);
+                break;
+            }
+            case EXPR_STMT:
+                infer(((ExprStmt*)stmt)->expr);
+                break;
+            case FUNCTION_DECL:
+                break; // nested functions are not supported by the transpiler
+            default:
+                break;
+        }
+        at = outer;
+    }
+
+    const Type* infer(Expression* expr) {
+        const Node* outer = at;
+        if (expr->line) at = expr;
+        const Type* t = inferExpr(expr);
+        at = outer;
+        expr->staticType = Type::resolved(t);
+        if (t == Type::whole()) wholes.insert(expr);
+        else wholes.erase(expr);
+        return t;
+    }
+
+    const Type* inferExpr(Expression* expr) {
+        switch (expr->type) {
+            case LITERAL: {
+                Literal* lit = (Literal*)expr;
+                switch (lit->kind) {
+                    case LIT_STRING: return Type::string();
+                    case LIT_BOOL: return Type::boolean();
+                    case LIT_INT: return Type::whole(); // see narrow()
+                    case LIT_FLOAT: return Type::number();
+                    default: return Type::value();
+                }
+            }
+            case IDENTIFIER: {
+                Identifier* id = (Identifier*)expr;
+                Scope& scope = scopes[currentFn];
+                auto it = scope.find(id->name);
+                if (it == scope.end()) {
+                    auto fn = functions.find(id->name);
+                    if (fn != functions.end()) referenced.insert(fn->second);
+                    const Type* field = fieldType(currentClass, id->name);
+                    return field ? field : Type::value();
+                }
+                id->readsSignal = it->second->kind == TY_SIGNAL;
+                return id->readsSignal ? it->second->element : it->second;
+            }
+            case ASSIGN_EXPR: {
+                AssignExpr* e = (AssignExpr*)expr;
+                e->signal = signalNamed(e->name);
+                const Type* t = narrow(e->value, infer(e->value), variable(e->name));
+                assign(e->name, e->signal ? Type::signal(t) : t);
+                Scope& scope = scopes[currentFn];
+                if (!scope.count(e->name)) return Type::value();
+                return e->signal ? scope[e->name]->element : scope[e->name];
+            }
+            case LAMBDA_EXPR: {
+                // Parameters shadow the enclosing scope's names while the
+                // body is inferred. An unannotated stream stage parameter
+                // takes the stream's element type.
+                LambdaExpr* e = (LambdaExpr*)expr;
+                const Type* element = e->params.size() == 1 ? stageElement : nullptr;
+                stageElement = nullptr;
+                Scope& scope = scopes[currentFn];
+                std::vector<std::pair<std::string_view, const Type*>> shadowed;
+                for (const auto& p : e->params) {
+                    auto it = scope.find(p.name);
+                    shadowed.push_back({p.name, it == scope.end() ? nullptr : it->second});
+                    scope[p.name] = element && p.typeName == "Value" ? element : Type::fromName(p.typeName);
+                }
+                const Type* result = Type::unknown();
+                if (e->result) {
+                    result = infer(e->result);
+                } else {
+                    closures.push_back(&result);
+                    inferStmt(e->body);
+                    closures.pop_back();
+                    if (result->kind == TY_UNKNOWN) result = Type::value();
+                }
+                for (auto it = shadowed.rbegin(); it != shadowed.rend(); ++it) {
+                    if (it->second) scope[it->first] = it->second;
+                    else scope.erase(it->first);
+                }
+                return Type::function(result);
+            }
+            case UNARY_EXPR: {
+                const Type* t = infer(((UnaryExpr*)expr)->right);
+                if (t->isNumeric() || t->kind == TY_UNKNOWN) return t;
+                return Type::value();
+            }
+            case BINARY_EXPR:
+                return inferBinary((BinaryExpr*)expr);
+            case CALL_EXPR: {
+                CallExpr* e = (CallExpr*)expr;
+                if (const Type* t = inferObjectCall(e)) return t;
+                const char* builtin = nullptr;
+                if (e->callee->type == IDENTIFIER) {
+                    std::string_view name = ((Identifier*)e->callee)->name;
+                    Scope& scope = scopes[currentFn];
+                    auto local = scope.find(name);
+                    bool lambda = local != scope.end() && local->second->kind == TY_FUNCTION;
+                    if (!returnTypes.count(name) && !lambda) builtin = builtinName(name);
+                }
+                std::vector<const Type*> argTypes;
+                for (Expression* arg : e->args) {
+                    if (builtin && argTypes.size() == 1 && takesElement(builtin)) stageElement = argTypes[0]->streamed();
+                    argTypes.push_back(infer(arg));
+                    stageElement = nullptr;
+                }
+                if (e->callee->type == IDENTIFIER) {
+                    std::string_view name = ((Identifier*)e->callee)->name;
+                    auto it = returnTypes.find(name);
+                    if (functions.count(name)) {
+                        FunctionDecl* fn = specialization(e, functions[name], argTypes);
+                        if (!fn) return Type::unknown();
+                        checkArguments(fn->params, e->args, 0, argTypes, name);
+                        return returnSlot(fn);
+                    }
+                    if (it != returnTypes.end()) return it->second;
+                    e->builtin = builtin;
+                    if (e->builtin) return inferBuiltin(e, argTypes);
+                    const Type* callee = infer(e->callee);
+                    if (callee->kind == TY_FUNCTION) return callee->element;
+                } else {
+                    infer(e->callee);
+                }
+                return Type::value();
+            }
+            case LIST_EXPR: {
+                const Type* element = Type::unknown();
+                for (Expression* item : ((ListExpr*)expr)->items) {
+                    const Type* t = infer(item);
+                    checkJoin(element, t, "a list");
+                    element = Type::join(element, t);
+                }
+                return Type::list(element);
+            }
+            case MAP_EXPR: {
+                MapExpr* e = (MapExpr*)expr;
+                const Type* key = Type::unknown();
+                const Type* value = Type::unknown();
+                for (Expression* k : e->keys) {
+                    const Type* t = infer(k);
+                    checkJoin(key, t, "a map's keys");
+                    key = Type::join(key, t);
+                }
+                for (Expression* v : e->values) {
+                    const Type* t = infer(v);
+                    checkJoin(value, t, "a map's values");
+                    value = Type::join(value, t);
+                }
+                return Type::map(key, value);
+            }
+            case CHANNEL_EXPR: {
+                ChannelExpr* e = (ChannelExpr*)expr;
+                if (e->capacity) infer(e->capacity);
+                return Type::channel(Type::fromName(e->elementType));
+            }
+            case INDEX_EXPR: {
+                IndexExpr* e = (IndexExpr*)expr;
+                const Type* t = infer(e->target);
+                const Type* index = infer(e->index);
+                if (t->kind != TY_LIST && t->kind != TY_MAP) return t->kind == TY_UNKNOWN ? t : Type::value();
+                narrow(e->index, index, t->kind == TY_LIST ? Type::integer() : t->key);
+                e->readsSignal = t->element->kind == TY_SIGNAL;
+                return e->readsSignal ? t->element->element : t->element;
+            }
+            case FIELD_EXPR: {
+                FieldExpr* e = (FieldExpr*)expr;
+                const Type* t = infer(e->object);
+                if (t->kind == TY_UNKNOWN) return t;
+                const Type* field = fieldType(classOf(t), e->field);
+                if (field) return field;
+                if (t->kind == TY_CLASS) error(std::string(t->name()) + " has no field " + std::string(e->field));
+                std::string message = "." + std::string(e->field) + " needs a клас or дані object, not " + std::string(t->name());
+                // `p.x` on an unannotated parameter is fine in the
+                // specializations that give p a class.
+                if (!generic(currentFn)) error(message);
+                deferred.emplace(currentFn, located(message));
+                return Type::value();
+            }
+            default:
+                return Type::value();
+        }
+    }
+
+    // Calls that involve a class: a constructor `Точка(1, 2)`, a method
+    // `p.відстань()` (or, inside the class, `відстань()`) and a дані
+    // object's `u.копія(вік = 31)`. nullptr for any other call.
+    const Type* inferObjectCall(CallExpr* e) {
+        if (e->callee->type != IDENTIFIER) return nullptr;
+        std::string_view name = ((Identifier*)e->callee)->name;
+        auto local = scopes[currentFn].find(name);
+        if (local != scopes[currentFn].end() && !e->receiver) return nullptr; // a lambda variable
+        if (!e->receiver) {
+            auto it = classes.find(name);
+            if (it != classes.end()) {
+                ClassDecl* cls = it->second;
+                std::vector<const Type*> argTypes;
+                for (Expression* arg : e->args) argTypes.push_back(infer(arg));
+                if (argTypes.size() != cls->parameters) {
+                    error(std::string(name) + " takes " + std::to_string(cls->parameters) + " arguments, not " + std::to_string(argTypes.size()));
+                }
+                for (size_t i = 0; i < argTypes.size(); i++) {
+                    const Type* field = fieldTypes[&cls->fields[i]];
+                    checkJoin(field, narrow(e->args[i], argTypes[i], field), std::string(name) + "'s " + std::string(cls->fields[i].name));
+                }
+                e->constructs = cls;
+                return Type::object(cls->name);
+            }
+            FunctionDecl* m = currentClass ? currentClass->method(name) : nullptr;
+            if (!m) return nullptr;
+            e->method = m;
+            std::vector<const Type*> argTypes;
+            for (Expression* arg : e->args) argTypes.push_back(infer(arg));
+            checkArguments(m->params, e->args, 0, argTypes, name);
+            return methodTypes[m];
+        }
+
+        const Type* self = infer(e->args[0]);
+        ClassDecl* cls = classOf(self);
+        if (!cls) {
+            // Until the receiver's type is known, a method name promises nothing.
+            if (self->kind != TY_UNKNOWN || !isMethodName(name)) return nullptr;
+            for (size_t i = 1; i < e->args.size(); i++) infer(e->args[i]);
+            return Type::unknown();
+        }
+        if (cls->data && (name == "копія" || name == "copy") && !cls->method(name)) {
+            // Each argument is `поле = значення`.
+            for (size_t i = 1; i < e->args.size(); i++) {
+                Expression* arg = e->args[i];
+                if (arg->type != ASSIGN_EXPR) error(std::string(name) + " takes field = value arguments");
+                AssignExpr* a = (AssignExpr*)arg;
+                const Type* field = fieldType(cls, a->name);
+                if (!field) error(std::string(cls->name) + " has no field " + std::string(a->name));
+                checkJoin(field, narrow(a->value, infer(a->value), field), "." + std::string(a->name));
+                a->staticType = field;
+            }
+            e->constructs = cls;
+            return self;
+        }
+        FunctionDecl* m = cls->method(name);
+        if (!m) return nullptr;
+        e->method = m;
+        std::vector<const Type*> argTypes;
+        for (size_t i = 1; i < e->args.size(); i++) argTypes.push_back(infer(e->args[i]));
+        checkArguments(m->params, e->args, 1, argTypes, name);
+        return methodTypes[m];
+    }
+
+    // Monomorphization: a call that passes typed arguments to unannotated
+    // parameters goes to a copy of the function with those parameters
+    // annotated, one copy per distinct tuple of argument types, so
+    // `фібоначчі(30)` runs on double all the way down. Calls with Value
+    // arguments keep the generic function. A parameter that the body of a
+    // copy widens (`n = n + "!"` for a число) stays Value in every copy.
+    // nullptr while an argument's type is still unknown.
+    FunctionDecl* specialization(CallExpr* e, FunctionDecl* fn, const std::vector<const Type*>& argTypes) {
+        Site& site = sites[e];
+        site = Site{currentFn, fn, fn};
+        if (argTypes.size() != fn->params.size()) return fn; // an arity error
+        std::vector<const Type*> key;
+        bool typed = false;
+        for (size_t i = 0; i < argTypes.size(); i++) {
+            if (argTypes[i]->kind == TY_UNKNOWN) return site.target = nullptr;
+            const Type* lent = fn->params[i].typeName == "Value" && !dynamicParams[fn].count(i) ? lends(argTypes[i]) : nullptr;
+            key.push_back(lent);
+            typed = typed || lent;
+        }
+        if (!typed) return fn;
+        FunctionDecl*& clone = specializations[{fn, key}];
+        if (!clone) {
+            size_t made = 0;
+            for (FunctionDecl* c : clones) made += c->generic == fn;
+            if (made >= MAX_SPECIALIZATIONS) return fn;
+            clone = specialize(fn, key);
+        }
+        return site.target = clone;
+    }
+
+    // A function of this module with an unannotated parameter, which calls
+    // may specialize.
+    bool generic(FunctionDecl* fn) {
+        if (!fn || fn->generic || owners.count(fn)) return false;
+        for (const auto& p : fn->params) {
+            if (p.typeName == "Value") return true;
+        }
+        return false;
+    }
+
+    // The type an argument of type `t` lends its parameter, or nullptr.
+    // A copy must compute exactly what the generic function does on
+    // Value, where every number is a double: a ціле lends число, since
+    // int64_t math would overflow where the Value one does not, and
+    // anything holding ціле elements lends nothing. Otherwise the type
+    // must be concrete and spelled in C++, so no lambda or stream inside.
+    static const Type* lends(const Type* t) {
+        if (t->isNumeric()) return Type::number();
+        return t->kind != TY_VALUE && t->kind != TY_SIGNAL && lendable(t) ? t : nullptr;
+    }
+
+    static bool lendable(const Type* t) {
+        if (t->kind == TY_UNKNOWN || t->kind == TY_FUNCTION || t->kind == TY_STREAM || t->kind == TY_INT) return false;
+        return (!t->key || lendable(t->key)) && (!t->element || lendable(t->element));
+    }
+
+    // `фібоначчі__число`: the name says the parameter types, for gdb and perf.
+    FunctionDecl* specialize(FunctionDecl* fn, const std::vector<const Type*>& key) {
+        FunctionDecl* clone = (FunctionDecl*)Cloner{*arena}.clone(fn);
+        std::vector<FunctionDecl::Param> params(fn->params.begin(), fn->params.end());
+        std::string name = std::string(fn->name) + "_";
+        for (size_t i = 0; i < params.size(); i++) {
+            if (key[i]) params[i].typeName = key[i]->name();
+            name += "_";
+            for (char c : params[i].typeName) name += isalnum((unsigned char)c) || (unsigned char)c > 127 ? c : '_';
+        }
+        clone->name = arena->copy(name);
+        clone->params = List<FunctionDecl::Param>(*arena, params);
+        clone->generic = fn;
+        if (fn->returnType == "Value") {
+            inferReturn.insert(clone);
+            returnTypes[clone->name] = Type::unknown();
+        } else {
+            returnTypes[clone->name] = Type::fromName(fn->returnType);
+        }
+        clones.push_back(clone);
+        changed = true;
+        return clone;
+    }
+
+    // Storing into a parameter of a specialization something its type
+    // cannot hold (`n = n + "!"` for a число, a string pushed onto a
+    // Список<число>) makes that parameter dynamic for the function.
+    void widenParameter(std::string_view name, const Type* t) {
+        if (!currentFn || !currentFn->generic) return;
+        FunctionDecl* fn = currentFn->generic;
+        for (size_t i = 0; i < fn->params.size(); i++) {
+            if (fn->params[i].name != name || fn->params[i].typeName != "Value") continue;
+            const Type* p = Type::fromName(currentFn->params[i].typeName);
+            if (Type::join(p, t) != p && dynamicParams[fn].insert(i).second) changed = true;
+        }
+    }
+
+    // Once inference is done: every call names its target, the
+    // specializations something reachable calls join the program, and
+    // (outside a library) a generic function only specialized calls
+    // reached, and nothing names as a value, is dropped. An error deferred
+    // in a generic function that stays is reported now.
+    void placeSpecializations(Program* program) {
+        if (clones.empty() && deferred.empty()) return;
+        std::set<FunctionDecl*> droppable;
+        for (FunctionDecl* c : clones) {
+            if (!library && !referenced.count(c->generic)) droppable.insert(c->generic);
+        }
+        std::map<FunctionDecl*, std::vector<const Site*>> callsIn;
+        for (const auto& s : sites) callsIn[s.second.caller].push_back(&s.second);
+        std::set<FunctionDecl*> live;
+        std::vector<FunctionDecl*> work;
+        auto reach = [&](FunctionDecl* fn) {
+            if (live.insert(fn).second) work.push_back(fn);
+        };
+        reach(nullptr);
+        for (const auto& o : owners) reach(o.first); // methods
+        for (Statement* stmt : program->body) {
+            if (stmt->type == FUNCTION_DECL && !droppable.count((FunctionDecl*)stmt)) reach((FunctionDecl*)stmt);
+        }
+        while (!work.empty()) {
+            FunctionDecl* fn = work.back();
+            work.pop_back();
+            for (const Site* s : callsIn[fn]) reach(s->target ? s->target : s->generic);
+        }
+
+        at = nullptr; // the messages are located already
+        for (const auto& d : deferred) {
+            if (live.count(d.first)) error(d.second);
+        }
+        for (auto& s : sites) {
+            if (!live.count(s.second.caller)) continue;
+            CallExpr* e = s.first;
+            if (s.second.target) ((Identifier*)e->callee)->name = s.second.target->name;
+            else e->staticType = Type::resolved(returnSlot(s.second.generic)); // undecided: the generic one
+        }
+        std::vector<Statement*> body;
+        for (Statement* stmt : program->body) {
+            if (stmt->type != FUNCTION_DECL || live.count((FunctionDecl*)stmt)) body.push_back(stmt);
+        }
+        for (FunctionDecl* c : clones) {
+            if (live.count(c)) body.push_back(c);
+        }
+        program->body = List<Statement*>(*arena, body);
+    }
+
+    bool isMethodName(std::string_view name) {
+        for (const auto& c : classes) {
+            if (c.second->method(name) || (c.second->data && (name == "копія" || name == "copy"))) return true;
+        }
+        return false;
+    }
+
+    // An object passed where the parameter's type is something else.
+    // argTypes[i] is the type of args[first + i].
+    void checkArguments(const List<FunctionDecl::Param>& params, const List<Expression*>& args, size_t first,
+                        const std::vector<const Type*>& argTypes, std::string_view fn) {
+        if (argTypes.size() != params.size()) {
+            error(std::string(fn) + " takes " + std::to_string(params.size()) + " arguments, not " + std::to_string(argTypes.size()));
+        }
+        for (size_t i = 0; i < params.size(); i++) {
+            const Type* param = Type::fromName(params[i].typeName);
+            checkJoin(param, narrow(args[first + i], argTypes[i], param), std::string(fn) + "'s " + std::string(params[i].name));
+        }
+    }
+
+    // Stages whose second argument is called with each element.
+    static bool takesElement(std::string_view builtin) {
+        return builtin == "streamFilter" || builtin == "streamMap" || builtin == "streamEach";
+    }
+
+    // The result of calling `f`, a lambda or a function name, whose type is `t`.
+    const Type* resultOf(Expression* f, const Type* t) {
+        if (t->kind == TY_FUNCTION) return t->element;
+        if (f->type == IDENTIFIER) {
+            auto it = returnTypes.find(((Identifier*)f)->name);
+            if (it != returnTypes.end()) return it->second;
+        }
+        return Type::value();
+    }
+
+    const Type* inferBuiltin(CallExpr* e, const std::vector<const Type*>& argTypes) {
+        std::string_view name = e->builtin;
+        if (name == "length") return Type::integer();
+        if (name == "has" || name == "removeKey") return Type::boolean();
+        const Type* container = argTypes.empty() ? Type::value() : argTypes[0];
+        if (name == "get") {
+            // The stored value or the default, so `m[k] = отримати(m, k, 0) + 1` types m.
+            if (container->kind == TY_UNKNOWN) return container;
+            if (container->kind != TY_MAP || argTypes.size() != 3) return Type::value();
+            return Type::join(container->element, narrow(e->args[2], argTypes[2], container->element));
+        }
+        if ((name == "minimum" || name == "maximum" || name == "squareRoot") && argTypes.size() == 1) {
+            // мін(xs), макс(xs) and корінь(x) or корінь(xs).
+            const Type* t = argTypes[0];
+            if (t->kind == TY_UNKNOWN || (t->kind == TY_LIST && t->element->kind == TY_UNKNOWN)) return Type::unknown();
+            bool numbers = t->kind == TY_LIST && t->element->isNumeric();
+            if (name == "squareRoot") return t->isNumeric() ? Type::number() : numbers ? Type::list(Type::number()) : Type::value();
+            return numbers ? t->element : Type::value();
+        }
+        if (name == "dot") {
+            if (argTypes.size() != 2) return Type::value();
+            const Type* a = argTypes[0];
+            const Type* b = argTypes[1];
+            if (a->kind == TY_UNKNOWN || b->kind == TY_UNKNOWN) return Type::unknown();
+            if (a->kind != TY_LIST || b->kind != TY_LIST) return Type::value();
+            if (a->element->kind == TY_UNKNOWN || b->element->kind == TY_UNKNOWN) return Type::unknown();
+            if (!a->element->isNumeric() || !b->element->isNumeric()) return Type::value();
+            return Type::join(a->element, b->element);
+        }
+        if (name == "minimum" || name == "maximum") {
+            if (argTypes.size() != 2) return Type::value();
+            if (argTypes[0]->kind == TY_UNKNOWN || argTypes[1]->kind == TY_UNKNOWN) return Type::unknown();
+            const Type* a = narrow(e->args[0], argTypes[0], argTypes[1]);
+            const Type* b = narrow(e->args[1], argTypes[1], a);
+            if (a->kind == TY_INT && b->kind == TY_INT) return Type::integer();
+            if (a->isNumeric() && b->isNumeric()) return Type::number();
+            return Type::value();
+        }
+        if (name == "makeSignal") return Type::signal(container);
+        if (name == "makeComputed") {
+            if (container->kind == TY_FUNCTION) return Type::signal(container->element);
+            return container->kind == TY_UNKNOWN ? container : Type::value();
+        }
+        if (name == "streamOf") {
+            // One list argument streams its elements.
+            if (argTypes.size() == 1 && argTypes[0]->kind == TY_LIST) return Type::stream(argTypes[0]->streamed());
+            const Type* element = Type::unknown();
+            for (const Type* t : argTypes) element = Type::join(element, t);
+            return Type::stream(element);
+        }
+        if (name == "streamRange") {
+            if (argTypes.size() != 2) return Type::value();
+            // Its elements meet no ціле, so like an undemanded counter, whole
+            // bounds give число.
+            const Type* t = argTypes[0]->kind == TY_UNKNOWN || argTypes[1]->kind == TY_UNKNOWN ? Type::unknown()
+                          : argTypes[0]->kind == TY_INT && argTypes[1]->kind == TY_INT ? Type::integer()
+                          : argTypes[0]->isNumeric() && argTypes[1]->isNumeric() ? Type::number() : Type::value();
+            return t->isNumeric() ? Type::stream(t) : t;
+        }
+        if (name == "streamLines") return Type::stream(Type::string());
+        if (name.substr(0, 6) == "stream") {
+            // Every other stage and sink takes a stream, or a list as one.
+            const Type* element = argTypes.empty() ? nullptr : argTypes[0]->streamed();
+            if (!element) return Type::value();
+            if (name == "streamFilter" || name == "streamTake") return Type::stream(element);
+            if (name == "streamMap") return Type::stream(argTypes.size() == 2 ? resultOf(e->args[1], argTypes[1]) : Type::value());
+            if (name == "streamCollect") return Type::list(element);
+            if (name == "streamCount") return Type::integer();
+            if (name == "streamSum") return element->isNumeric() || element->kind == TY_UNKNOWN ? element : Type::value();
+            return Type::value();
+        }
+        if (name == "channelReceive") {
+            if (container->kind == TY_CHANNEL) return container->element;
+            return container->kind == TY_UNKNOWN ? container : Type::value();
+        }
+        if (name == "keys") return Type::list(container->kind == TY_MAP ? container->key : container->kind == TY_UNKNOWN ? container : Type::value());
+        if (name == "push" && e->args.size() == 2 && e->args[0]->type == IDENTIFIER) {
+            // Appending to a list declared by an inferable let widens its element type.
+            const Type* element = container->kind == TY_LIST ? container->element : Type::unknown();
+            assign(((Identifier*)e->args[0])->name, Type::list(narrow(e->args[1], argTypes[1], element)));
+        }
+        return Type::value();
+    }
+
+    // What a store into `name` must hold: its type, or its signal's
+    // element; unknown for a name not in scope.
+    const Type* variable(std::string_view name) {
+        Scope& scope = scopes[currentFn];
+        auto it = scope.find(name);
+        if (it == scope.end()) {
+            const Type* field = fieldType(currentClass, name);
+            return field ? field : Type::unknown();
+        }
+        return it->second->kind == TY_SIGNAL ? it->second->element : it->second;
+    }
+
+    // The signal type of `name`, if it names one.
+    const Type* signalNamed(std::string_view name) {
+        Scope& scope = scopes[currentFn];
+        auto it = scope.find(name);
+        return it != scope.end() && it->second->kind == TY_SIGNAL ? it->second : nullptr;
+    }
+
+    const Type* inferBinary(BinaryExpr* e) {
+        const Type* l = infer(e->left);
+        const Type* r = infer(e->right);
+        BinaryOp op = e->op;
+        l = narrow(e->left, l, r);
+        r = narrow(e->right, r, l);
+        // A whole literal exponent keeps `x ** 2` a multiplication, and
+        // only such a power of a ціле is ціле: `n ** -1` is 0.5 for 2.
+        bool wholePower = op == OP_POW && integerLiteral(e->right) && ((Literal*)e->right)->value[0] != '-';
+        if (wholePower) r = narrow(e->right, r, Type::integer());
+
+        // Concatenation with a string always yields a string, whatever the other side is.
+        if (op == OP_ADD && (l->kind == TY_STRING || r->kind == TY_STRING)) return Type::string();
+        if (l->kind == TY_UNKNOWN || r->kind == TY_UNKNOWN) return Type::unknown();
+
+        bool comparison = op == OP_LT || op == OP_GT || op == OP_LE || op == OP_GE || op == OP_EQ;
+        bool arithmetic = op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV;
+        if (arithmetic && (l->kind == TY_LIST || r->kind == TY_LIST)) {
+            // Elementwise on numeric lists; a number on either side applies to every element.
+            const Type* a = l->kind == TY_LIST ? l->element : l;
+            const Type* b = r->kind == TY_LIST ? r->element : r;
+            if (a->kind == TY_UNKNOWN || b->kind == TY_UNKNOWN) return Type::unknown();
+            if (!a->isNumeric() || !b->isNumeric()) return Type::value();
+            return Type::list(op == OP_DIV ? Type::number() : Type::join(a, b));
+        }
+        if (l->isNumeric() && r->isNumeric()) {
+            if (comparison) return Type::boolean();
+            if (op == OP_DIV) return Type::number(); // division is always real-valued
+            if (op == OP_POW) return (l->kind == TY_INT || l == Type::whole()) && wholePower ? l : Type::number();
+            return Type::join(l, r);
+        }
+        if (op == OP_EQ && l == r && (l->kind == TY_STRING || l->kind == TY_BOOL)) return Type::boolean();
+        if (l->kind == TY_CLASS || r->kind == TY_CLASS) {
+            ClassDecl* cls = classOf(l);
+            if (op != OP_EQ || l != r || !cls->data) {
+                error(std::string(opText(op)) + " does not apply to " + std::string(l->name()) + " and " + std::string(r->name()) +
+                      (op == OP_EQ && l == r ? ": only дані objects compare" : ""));
+            }
+            return Type::boolean();
+        }
+        return Type::value();
+    }
+};
+
+#endif
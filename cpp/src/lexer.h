@@ -4,113 +4,243 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <array>
 #include <cctype>
+#include <cstdint>
 
 enum TokenType {
     TOK_FN, TOK_LET, TOK_IF, TOK_ELSE, TOK_RETURN, TOK_WHILE,
-    TOK_SWITCH, TOK_CASE, TOK_DEFAULT,
+    TOK_SWITCH, TOK_CASE, TOK_DEFAULT, TOK_IMPORT, TOK_FOR, TOK_SPAWN, TOK_PARALLEL, TOK_CLASS,
     TOK_TRUE, TOK_FALSE, TOK_NONE,
     TOK_IDENTIFIER, TOK_NUMBER, TOK_STRING,
-    TOK_LPAREN, TOK_RPAREN, TOK_LBRACE, TOK_RBRACE,
+    TOK_LPAREN, TOK_RPAREN, TOK_LBRACE, TOK_RBRACE, TOK_LBRACKET, TOK_RBRACKET,
     TOK_PLUS, TOK_MINUS, TOK_STAR, TOK_SLASH, TOK_PERCENT, TOK_POWER,
-    TOK_LT, TOK_GT, TOK_LE, TOK_GE, TOK_EQ_EQ, TOK_EQ, TOK_ARROW, TOK_COMMA, TOK_COLON, TOK_SEMICOLON,
+    TOK_LT, TOK_GT, TOK_LE, TOK_GE, TOK_EQ_EQ, TOK_EQ, TOK_ARROW, TOK_COMMA, TOK_COLON, TOK_SEMICOLON, TOK_AT, TOK_DOT,
+    TOK_PIPE, TOK_BAR,
     TOK_EOF, TOK_UNKNOWN
 };
 
+// Keyword spellings, English and Ukrainian. Add new keywords here; the
+// perfect hash below is regenerated at compile time.
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+constexpr Keyword KEYWORDS[] = {
+    {"fn", TOK_FN}, {"fun", TOK_FN}, {"функція", TOK_FN},
+    {"let", TOK_LET}, {"нехай", TOK_LET}, {"змінна", TOK_LET},
+    {"if", TOK_IF}, {"якщо", TOK_IF},
+    {"else", TOK_ELSE}, {"інакше", TOK_ELSE},
+    {"return", TOK_RETURN}, {"повернути", TOK_RETURN},
+    {"while", TOK_WHILE}, {"поки", TOK_WHILE},
+    {"true", TOK_TRUE}, {"так", TOK_TRUE}, {"істина", TOK_TRUE},
+    {"false", TOK_FALSE}, {"ні", TOK_FALSE}, {"хиба", TOK_FALSE},
+    {"null", TOK_NONE}, {"нічого", TOK_NONE},
+    {"switch", TOK_SWITCH}, {"вибір", TOK_SWITCH}, {"співпадіння", TOK_SWITCH},
+    {"case", TOK_CASE}, {"варіант", TOK_CASE},
+    {"default", TOK_DEFAULT}, {"типово", TOK_DEFAULT},
+    {"import", TOK_IMPORT}, {"імпорт", TOK_IMPORT},
+    {"for", TOK_FOR}, {"для", TOK_FOR},
+    {"spawn", TOK_SPAWN}, {"запустити", TOK_SPAWN},
+    {"parallel", TOK_PARALLEL}, {"паралельно", TOK_PARALLEL},
+    {"class", TOK_CLASS}, {"клас", TOK_CLASS},
+};
+
+constexpr size_t KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+constexpr size_t KEYWORD_SLOTS = 256; // power of two, > 2x KEYWORD_COUNT
+
+constexpr size_t maxKeywordLength() {
+    size_t n = 0;
+    for (const auto& k : KEYWORDS) n = k.text.size() > n ? k.text.size() : n;
+    return n;
+}
+
+constexpr size_t KEYWORD_MAX_LENGTH = maxKeywordLength();
+
+// Bit n is set when some keyword is n bytes long.
+constexpr uint32_t keywordLengths() {
+    uint32_t mask = 0;
+    for (const auto& k : KEYWORDS) mask |= 1u << k.text.size();
+    return mask;
+}
+
+constexpr uint32_t KEYWORD_LENGTH_MASK = keywordLengths();
+static_assert(KEYWORD_MAX_LENGTH < 32, "KEYWORD_LENGTH_MASK holds lengths below 32");
+static_assert((KEYWORD_LENGTH_MASK & 3u) == 0, "keywordHash() assumes keywords of at least two bytes");
+
+// Seeded hash over the length and the first and last two raw UTF-8 bytes,
+// so classifying an identifier costs the same whatever its length. Only
+// called with 2 <= text.size() (every keyword is at least two bytes).
+constexpr uint32_t keywordHash(std::string_view text, uint32_t seed) {
+    size_t n = text.size();
+    uint32_t h = (2166136261u ^ seed) * 16777619u;
+    h = (h ^ (uint32_t)n) * 16777619u;
+    h = (h ^ (uint8_t)text[0]) * 16777619u;
+    h = (h ^ (uint8_t)text[1]) * 16777619u;
+    h = (h ^ (uint8_t)text[n - 2]) * 16777619u;
+    h = (h ^ (uint8_t)text[n - 1]) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+// Slot -> index into KEYWORDS (-1 = empty) for the first seed that maps
+// every keyword to a distinct slot.
+struct KeywordTable {
+    uint32_t seed = 0;
+    std::array<int8_t, KEYWORD_SLOTS> slots{};
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    for (uint32_t seed = 0; seed < 100000; seed++) {
+        KeywordTable table;
+        table.seed = seed;
+        for (auto& slot : table.slots) slot = -1;
+        bool perfect = true;
+        for (size_t i = 0; i < KEYWORD_COUNT && perfect; i++) {
+            auto& slot = table.slots[keywordHash(KEYWORDS[i].text, seed) & (KEYWORD_SLOTS - 1)];
+            if (slot != -1) perfect = false;
+            else slot = (int8_t)i;
+        }
+        if (perfect) return table;
+    }
+    return KeywordTable{~0u, {}};
+}
+
+constexpr KeywordTable KEYWORD_TABLE = buildKeywordTable();
+static_assert(KEYWORD_TABLE.seed != ~0u, "no perfect hash seed for KEYWORDS; grow KEYWORD_SLOTS");
+
+// One hash and at most one string compare per identifier.
+inline TokenType lookupKeyword(std::string_view text) {
+    if (text.size() > KEYWORD_MAX_LENGTH || !(KEYWORD_LENGTH_MASK & (1u << text.size()))) return TOK_IDENTIFIER;
+    int8_t i = KEYWORD_TABLE.slots[keywordHash(text, KEYWORD_TABLE.seed) & (KEYWORD_SLOTS - 1)];
+    if (i >= 0 && KEYWORDS[i].text == text) return KEYWORDS[i].type;
+    return TOK_IDENTIFIER;
+}
+
+// Tokens never own their text: it is a view into the source buffer, which
+// must outlive the parse. `line` and `column` count from 1; the column is
+// in bytes, as C++ compilers count it.
 struct Token {
     TokenType type;
-    std::string text;
+    std::string_view text;
+    size_t offset;
+    uint32_t line;
+    uint32_t column;
 };
 
 class Lexer {
-    std::string source;
+    std::string_view source;
     size_t pos;
+    uint32_t line = 1;
+    size_t lineStart = 0; // offset of the first byte of `line`
     
 public:
-    Lexer(std::string src) : source(src), pos(0) {}
+    Lexer(std::string_view src) : source(src), pos(0) {}
     
-    std::vector<Token> tokenize() {
-        std::vector<Token> tokens;
+    // Pulls the next token; returns TOK_EOF forever once the source is exhausted.
+    Token next() {
         while (pos < source.length()) {
             char c = source[pos];
             if (isspace(c)) {
+                if (c == '\n') newline(pos);
                 pos++;
                 continue;
             }
             
             if (isalpha(c) || (uint8_t)c > 127 || c == '_') { // Support Unicode letters roughly
-                tokens.push_back(identifier());
-            } else if (isdigit(c)) {
-                tokens.push_back(number());
-            } else {
-                switch (c) {
-                    case '(': tokens.push_back({TOK_LPAREN, "("}); pos++; break;
-                    case ')': tokens.push_back({TOK_RPAREN, ")"}); pos++; break;
-                    case '{': tokens.push_back({TOK_LBRACE, "{"}); pos++; break;
-                    case '}': tokens.push_back({TOK_RBRACE, "}"}); pos++; break;
-                    case '+': tokens.push_back({TOK_PLUS, "+"}); pos++; break;
-                    case '-': tokens.push_back({TOK_MINUS, "-"}); pos++; break;
-                    case '*': 
-                        if (match('*')) { tokens.push_back({TOK_POWER, "**"}); }
-                        else { tokens.push_back({TOK_STAR, "*"}); }
-                        pos++; 
-                        break;
-                    case '%': tokens.push_back({TOK_PERCENT, "%"}); pos++; break;
-                    case '/': 
-                        if (match('/')) {
-                             // Comment
-                             while (pos < source.length() && source[pos] != '\n') pos++;
-                        } else {
-                            tokens.push_back({TOK_SLASH, "/"}); pos++;
-                        }
-                        break;
-                    case '<': 
-                        if (match('=')) tokens.push_back({TOK_LE, "<="});
-                        else tokens.push_back({TOK_LT, "<"}); 
-                        pos++;
-                        break;
-                    case '>': 
-                        if (match('=')) tokens.push_back({TOK_GE, ">="});
-                        else tokens.push_back({TOK_GT, ">"}); 
-                        pos++;
-                        break;
-                    case '=': 
-                        if (match('=')) tokens.push_back({TOK_EQ_EQ, "=="});
-                        else if (match('>')) tokens.push_back({TOK_ARROW, "=>"});
-                        else tokens.push_back({TOK_EQ, "="});
-                        pos++;
-                        break;
-                    case ',': tokens.push_back({TOK_COMMA, ","}); pos++; break;
-                    case ':': tokens.push_back({TOK_COLON, ":"}); pos++; break;
-                    case ';': tokens.push_back({TOK_SEMICOLON, ";"}); pos++; break;
-                    case '"': tokens.push_back(string_lit()); break;
-                    default: 
-                        pos++; // skip unknown
-                        break;
-                }
+                return identifier();
+            }
+            if (isdigit(c)) {
+                return number();
+            }
+            
+            size_t start = pos++;
+            switch (c) {
+                case '(': return make(TOK_LPAREN, start);
+                case ')': return make(TOK_RPAREN, start);
+                case '{': return make(TOK_LBRACE, start);
+                case '}': return make(TOK_RBRACE, start);
+                case '[': return make(TOK_LBRACKET, start);
+                case ']': return make(TOK_RBRACKET, start);
+                case '+': return make(TOK_PLUS, start);
+                case '-': return make(TOK_MINUS, start);
+                case '*': return make(match('*') ? TOK_POWER : TOK_STAR, start);
+                case '%': return make(TOK_PERCENT, start);
+                case '/':
+                    if (match('/')) {
+                        // Comment
+                        while (pos < source.length() && source[pos] != '\n') pos++;
+                        continue;
+                    }
+                    return make(TOK_SLASH, start);
+                case '<': return make(match('=') ? TOK_LE : TOK_LT, start);
+                case '>': return make(match('=') ? TOK_GE : TOK_GT, start);
+                case '=':
+                    if (match('=')) return make(TOK_EQ_EQ, start);
+                    if (match('>')) return make(TOK_ARROW, start);
+                    return make(TOK_EQ, start);
+                case ',': return make(TOK_COMMA, start);
+                case ':': return make(TOK_COLON, start);
+                case ';': return make(TOK_SEMICOLON, start);
+                case '@': return make(TOK_AT, start);
+                case '.': return make(TOK_DOT, start);
+                case '|': return make(match('>') ? TOK_PIPE : TOK_BAR, start);
+                case '"':
+                    pos = start;
+                    return string_lit();
+                default:
+                    continue; // skip unknown
             }
         }
-        tokens.push_back({TOK_EOF, ""});
+        return token(TOK_EOF, source.substr(source.length()), source.length());
+    }
+    
+    // Convenience wrapper for callers that want the whole stream at once.
+    std::vector<Token> tokenize() {
+        std::vector<Token> tokens;
+        do {
+            tokens.push_back(next());
+        } while (tokens.back().type != TOK_EOF);
         return tokens;
     }
     
+    // Token spanning from `start` up to the current position.
+    Token make(TokenType type, size_t start) {
+        return token(type, source.substr(start, pos - start), start);
+    }
+
+    // `start` is on the current line.
+    Token token(TokenType type, std::string_view text, size_t start) {
+        return {type, text, start, line, (uint32_t)(start - lineStart + 1)};
+    }
+
+    void newline(size_t at) {
+        line++;
+        lineStart = at + 1;
+    }
+    
     bool match(char expected) {
-        if (pos + 1 < source.length() && source[pos + 1] == expected) {
+        if (pos < source.length() && source[pos] == expected) {
             pos++;
             return true;
         }
         return false;
     }
     
+    // A string may span lines; its token is placed at the opening quote.
     Token string_lit() {
+        Token t = token(TOK_STRING, {}, pos);
         pos++; // Skip opening quote
         size_t start = pos;
         while (pos < source.length() && source[pos] != '"') {
+            if (source[pos] == '\n') newline(pos);
             pos++;
         }
-        std::string text = source.substr(start, pos - start);
+        t.text = source.substr(start, pos - start);
+        t.offset = start;
         if (pos < source.length()) pos++; // Skip closing quote
-        return {TOK_STRING, text};
+        return t;
     }
 
     Token identifier() {
@@ -118,30 +248,19 @@ public:
         while (pos < source.length() && (isalnum(source[pos]) || source[pos] == '_' || (uint8_t)source[pos] > 127)) {
             pos++;
         }
-        std::string text = source.substr(start, pos - start);
-        TokenType type = TOK_IDENTIFIER;
-        if (text == "fn" || text == "функція" || text == "fun") type = TOK_FN;
-        else if (text == "let" || text == "нехай" || text == "змінна") type = TOK_LET;
-        else if (text == "if" || text == "якщо") type = TOK_IF;
-        else if (text == "else" || text == "інакше") type = TOK_ELSE;
-        else if (text == "return" || text == "повернути") type = TOK_RETURN;
-        else if (text == "while" || text == "поки") type = TOK_WHILE;
-        else if (text == "true" || text == "так" || text == "істина") type = TOK_TRUE;
-        else if (text == "false" || text == "ні" || text == "хиба") type = TOK_FALSE;
-        else if (text == "null" || text == "нічого") type = TOK_NONE;
-        else if (text == "switch" || text == "вибір" || text == "співпадіння") type = TOK_SWITCH;
-        else if (text == "case" || text == "варіант") type = TOK_CASE;
-        else if (text == "default" || text == "типово") type = TOK_DEFAULT;
-        
-        return {type, text};
+        std::string_view text = source.substr(start, pos - start);
+        return token(lookupKeyword(text), text, start);
     }
     
     Token number() {
         size_t start = pos;
-        while (pos < source.length() && (isdigit(source[pos]) || source[pos] == '.')) {
+        while (pos < source.length() && isdigit(source[pos])) pos++;
+        // A fractional part makes it a float literal; a bare integer stays "ціле".
+        if (pos + 1 < source.length() && source[pos] == '.' && isdigit(source[pos + 1])) {
             pos++;
+            while (pos < source.length() && isdigit(source[pos])) pos++;
         }
-        return {TOK_NUMBER, source.substr(start, pos - start)};
+        return make(TOK_NUMBER, start);
     }
 };
 
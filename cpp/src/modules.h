@@ -0,0 +1,166 @@
+#ifndef MODULES_H
+#define MODULES_H
+
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "optimizer.h"
+#include "inference.h"
+
+// Read-only mapping of a source file; tokens are views into it, so it
+// stays mapped for the lifetime of the process.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        size = (size_t)st.st_size;
+        if (size > 0) {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                return false;
+            }
+            madvise(p, size, MADV_SEQUENTIAL);
+            data = (const char*)p;
+        }
+        close(fd);
+        return true;
+    }
+
+    std::string_view view() const { return std::string_view(data ? data : "", size); }
+};
+
+struct Module {
+    std::string path; // canonical
+    std::string initName; // runs the module's top-level code
+    MappedFile source;
+    std::unique_ptr<Program> program;
+    std::vector<Module*> imports; // direct imports only
+};
+
+// Loads an entry file and everything it imports, then runs the front end
+// passes on each module. Imports resolve relative to the importing file;
+// a module's functions are visible to the modules that import it directly.
+class ModuleLoader {
+    std::vector<std::unique_ptr<Module>> modules;
+    std::map<std::string, Module*> byPath;
+    std::vector<Module*> loading; // current import chain, for cycle errors
+
+public:
+    std::vector<Module*> order; // dependencies first, entry last
+
+    bool load(const std::string& entryPath) {
+        if (!loadModule(entryPath)) return false;
+        analyze();
+        return true;
+    }
+
+    Module* entry() const { return order.back(); }
+
+    std::vector<Program*> programs() const {
+        std::vector<Program*> out;
+        for (Module* m : order) out.push_back(m->program.get());
+        return out;
+    }
+
+    // Init functions of every module but the entry, in the order they run.
+    std::vector<std::string> initNames() const {
+        std::vector<std::string> out;
+        for (size_t i = 0; i + 1 < order.size(); i++) out.push_back(order[i]->initName);
+        return out;
+    }
+
+private:
+    Module* loadModule(const std::string& path) {
+        char resolved[PATH_MAX];
+        if (!realpath(path.c_str(), resolved)) {
+            std::cerr << "Could not open file " << path << std::endl;
+            return nullptr;
+        }
+        std::string canonical = resolved;
+        for (Module* m : loading) {
+            if (m->path == canonical) {
+                std::cerr << "Error: circular import of " << path << std::endl;
+                return nullptr;
+            }
+        }
+        auto it = byPath.find(canonical);
+        if (it != byPath.end()) return it->second;
+
+        modules.emplace_back(new Module());
+        Module* m = modules.back().get();
+        m->path = canonical;
+        m->initName = "_init_" + hexHash(canonical);
+        byPath[canonical] = m;
+        if (!m->source.open(canonical)) {
+            std::cerr << "Could not open file " << path << std::endl;
+            return nullptr;
+        }
+        // Tokens are pulled lazily by the parser, so only the AST is ever held.
+        Lexer lexer(m->source.view());
+        m->program = Parser(lexer, canonical).parse();
+
+        loading.push_back(m);
+        std::string dir = canonical.substr(0, canonical.rfind('/') + 1);
+        for (Statement* stmt : m->program->body) {
+            if (stmt->type != IMPORT_STMT) continue;
+            std::string target(((ImportStmt*)stmt)->path);
+            Module* dep = loadModule(target[0] == '/' ? target : dir + target);
+            if (!dep) return nullptr;
+            m->imports.push_back(dep);
+        }
+        loading.pop_back();
+        order.push_back(m);
+        return m;
+    }
+
+    void analyze() {
+        for (Module* m : order) {
+            // Folding runs first so inference sees the simplified tree.
+            Optimizer optimizer;
+            optimizer.run(m->program.get());
+
+            TypeInference inference;
+            inference.library = m != entry();
+            for (Module* dep : m->imports) {
+                for (Statement* stmt : dep->program->body) {
+                    if (stmt->type == FUNCTION_DECL) inference.declare((FunctionDecl*)stmt);
+                    if (stmt->type == CLASS_DECL) inference.declare((ClassDecl*)stmt);
+                }
+            }
+            inference.run(m->program.get());
+        }
+    }
+
+    // Stable across runs, so unchanged modules keep their cached objects.
+    static std::string hexHash(const std::string& s) {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : s) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+        return buf;
+    }
+};
+
+#endif
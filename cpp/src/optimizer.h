@@ -0,0 +1,561 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+// AST-level optimizations run before type inference:
+//  - folds constant arithmetic, comparisons and string concatenation;
+//  - propagates lets that are initialized with a constant and never
+//    reassigned, so `нехай n: число = 30` reaches its uses as a literal,
+//    and then drops the let;
+//  - removes dead if/while/switch arms whose condition is a constant.
+// Everything it creates is allocated from the Program's arena.
+class Optimizer {
+    struct Usage {
+        int declarations = 0;
+        int assignments = 0;
+        int reads = 0;
+        int replaced = 0; // reads fold() turned into the constant
+    };
+
+    Arena* arena = nullptr;
+    std::map<std::string_view, Usage> usage;         // per function / top-level scope
+    std::map<std::string_view, Literal*> constants;
+    std::vector<BlockStmt*> blocks;                  // being optimized, innermost last
+    std::vector<std::pair<LetStmt*, BlockStmt*>> propagated; // and the block holding each; nullptr at top level
+
+public:
+    void run(Program* program) {
+        arena = &program->arena;
+
+        for (Statement* stmt : program->body) {
+            if (stmt->type == FUNCTION_DECL) optimizeFunction((FunctionDecl*)stmt);
+            if (stmt->type != CLASS_DECL) continue;
+            ClassDecl* cls = (ClassDecl*)stmt;
+            beginScope();
+            for (auto& f : cls->fields) {
+                if (f.initializer) f.initializer = fold(f.initializer);
+            }
+            for (FunctionDecl* m : cls->methods) optimizeFunction(m);
+        }
+
+        beginScope();
+        for (Statement* stmt : program->body) {
+            if (stmt->type != FUNCTION_DECL && stmt->type != CLASS_DECL) collect(stmt);
+        }
+        std::vector<Statement*> body;
+        for (Statement* stmt : program->body) {
+            Statement* s = stmt->type == FUNCTION_DECL || stmt->type == CLASS_DECL ? stmt : optimize(stmt);
+            if (s) body.push_back(s);
+        }
+        program->body = List<Statement*>(*arena, body);
+        program->body = dropPropagated(program->body);
+    }
+
+private:
+    void optimizeFunction(FunctionDecl* fn) {
+        beginScope();
+        for (const auto& p : fn->params) usage[p.name].declarations++;
+        collect(fn->body);
+        optimizeBlock(fn->body);
+        dropPropagated({});
+    }
+
+    void beginScope() {
+        usage.clear();
+        constants.clear();
+        propagated.clear();
+    }
+
+    // Once the scope is done, a propagated let whose every read was
+    // replaced is dead, and C++ would only warn that it is unused. Removes
+    // those from their blocks, or from `top`, the top level's statements,
+    // and returns what is left of `top`.
+    List<Statement*> dropPropagated(List<Statement*> top) {
+        std::map<BlockStmt*, std::vector<LetStmt*>> dead;
+        for (const auto& p : propagated) {
+            const Usage& u = usage[p.first->name];
+            if (u.replaced == u.reads) dead[p.second].push_back(p.first);
+        }
+        for (auto& d : dead) {
+            List<Statement*>& statements = d.first ? d.first->statements : top;
+            std::vector<Statement*> kept;
+            for (Statement* stmt : statements) {
+                if (std::find(d.second.begin(), d.second.end(), stmt) == d.second.end()) kept.push_back(stmt);
+            }
+            statements = List<Statement*>(*arena, kept);
+        }
+        return top;
+    }
+
+    // --- Usage analysis (declarations and assignments per name) ---
+
+    void collect(Statement* stmt) {
+        if (!stmt) return;
+        switch (stmt->type) {
+            case BLOCK_STMT:
+                for (Statement* s : ((BlockStmt*)stmt)->statements) collect(s);
+                break;
+            case IF_STMT: {
+                IfStmt* s = (IfStmt*)stmt;
+                collect(s->condition);
+                collect(s->thenBranch);
+                collect(s->elseBranch);
+                break;
+            }
+            case SWITCH_STMT: {
+                SwitchStmt* s = (SwitchStmt*)stmt;
+                collect(s->discriminant);
+                for (auto& c : s->cases) {
+                    if (!c.patternName.empty() && c.patternName != "_") usage[c.patternName].declarations++;
+                    if (c.value) collect(c.value);
+                    if (c.guard) collect(c.guard);
+                    collect(c.body);
+                }
+                break;
+            }
+            case WHILE_STMT:
+                collect(((WhileStmt*)stmt)->condition);
+                collect(((WhileStmt*)stmt)->body);
+                break;
+            case FOR_STMT: {
+                ForStmt* s = (ForStmt*)stmt;
+                usage[s->var].declarations++;
+                if (s->iterable) collect(s->iterable);
+                if (s->from) collect(s->from);
+                if (s->to) collect(s->to);
+                collect(s->body);
+                break;
+            }
+            case INDEX_ASSIGN_STMT:
+                collect(((IndexAssignStmt*)stmt)->target);
+                collect(((IndexAssignStmt*)stmt)->value);
+                break;
+            case FIELD_ASSIGN_STMT:
+                collect(((FieldAssignStmt*)stmt)->target);
+                collect(((FieldAssignStmt*)stmt)->value);
+                break;
+            case SPAWN_STMT:
+                collect(((SpawnStmt*)stmt)->body);
+                break;
+            case RETURN_STMT:
+                if (((ReturnStmt*)stmt)->value) collect(((ReturnStmt*)stmt)->value);
+                break;
+            case LET_STMT:
+                usage[((LetStmt*)stmt)->name].declarations++;
+                collect(((LetStmt*)stmt)->initializer);
+                break;
+            case ASSIGN_STMT:
+                usage[((AssignStmt*)stmt)->name].assignments++;
+                collect(((AssignStmt*)stmt)->value);
+                break;
+            case EXPR_STMT:
+                collect(((ExprStmt*)stmt)->expr);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void collect(Expression* expr) {
+        switch (expr->type) {
+            case IDENTIFIER:
+                usage[((Identifier*)expr)->name].reads++;
+                break;
+            case ASSIGN_EXPR:
+                usage[((AssignExpr*)expr)->name].assignments++;
+                collect(((AssignExpr*)expr)->value);
+                break;
+            case BINARY_EXPR:
+                collect(((BinaryExpr*)expr)->left);
+                collect(((BinaryExpr*)expr)->right);
+                break;
+            case UNARY_EXPR:
+                collect(((UnaryExpr*)expr)->right);
+                break;
+            case CALL_EXPR:
+                collect(((CallExpr*)expr)->callee);
+                for (Expression* arg : ((CallExpr*)expr)->args) collect(arg);
+                break;
+            case LIST_EXPR:
+                for (Expression* item : ((ListExpr*)expr)->items) collect(item);
+                break;
+            case MAP_EXPR:
+                for (Expression* k : ((MapExpr*)expr)->keys) collect(k);
+                for (Expression* v : ((MapExpr*)expr)->values) collect(v);
+                break;
+            case INDEX_EXPR:
+                collect(((IndexExpr*)expr)->target);
+                collect(((IndexExpr*)expr)->index);
+                break;
+            case FIELD_EXPR:
+                collect(((FieldExpr*)expr)->object);
+                break;
+            case CHANNEL_EXPR:
+                if (((ChannelExpr*)expr)->capacity) collect(((ChannelExpr*)expr)->capacity);
+                break;
+            case LAMBDA_EXPR: {
+                LambdaExpr* e = (LambdaExpr*)expr;
+                for (const auto& p : e->params) usage[p.name].declarations++;
+                if (e->result) collect(e->result);
+                else collect(e->body);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // --- Statements ---
+
+    void optimizeBlock(BlockStmt* blk) {
+        blocks.push_back(blk);
+        std::vector<Statement*> statements;
+        for (Statement* stmt : blk->statements) {
+            Statement* s = optimize(stmt);
+            if (s) statements.push_back(s);
+        }
+        blk->statements = List<Statement*>(*arena, statements);
+        blocks.pop_back();
+    }
+
+    // Returns the replacement statement, or nullptr if it is dead.
+    Statement* optimize(Statement* stmt) {
+        switch (stmt->type) {
+            case BLOCK_STMT:
+                optimizeBlock((BlockStmt*)stmt);
+                return stmt;
+            case IF_STMT: {
+                IfStmt* s = (IfStmt*)stmt;
+                s->condition = fold(s->condition);
+                if (s->condition->type == LITERAL) {
+                    Statement* taken = isTruthy((Literal*)s->condition) ? s->thenBranch : s->elseBranch;
+                    return taken ? optimize(taken) : nullptr;
+                }
+                s->thenBranch = optimize(s->thenBranch);
+                if (!s->thenBranch) s->thenBranch = emptyBlock();
+                if (s->elseBranch) s->elseBranch = optimize(s->elseBranch);
+                return stmt;
+            }
+            case SWITCH_STMT:
+                return optimizeSwitch((SwitchStmt*)stmt);
+            case WHILE_STMT: {
+                WhileStmt* s = (WhileStmt*)stmt;
+                s->condition = fold(s->condition);
+                if (s->condition->type == LITERAL && !isTruthy((Literal*)s->condition)) return nullptr;
+                s->body = optimize(s->body);
+                if (!s->body) s->body = emptyBlock();
+                return stmt;
+            }
+            case FOR_STMT: {
+                ForStmt* s = (ForStmt*)stmt;
+                if (s->iterable) s->iterable = fold(s->iterable);
+                if (s->from) s->from = fold(s->from);
+                if (s->to) s->to = fold(s->to);
+                s->fixed = usage[s->var].assignments == 0;
+                s->body = optimize(s->body);
+                if (!s->body) s->body = emptyBlock();
+                return stmt;
+            }
+            case INDEX_ASSIGN_STMT: {
+                IndexAssignStmt* s = (IndexAssignStmt*)stmt;
+                fold(s->target); // an IndexExpr folds in place
+                s->value = fold(s->value);
+                return stmt;
+            }
+            case FIELD_ASSIGN_STMT: {
+                FieldAssignStmt* s = (FieldAssignStmt*)stmt;
+                fold(s->target); // so does a FieldExpr
+                s->value = fold(s->value);
+                return stmt;
+            }
+            case SPAWN_STMT:
+                optimizeBlock(((SpawnStmt*)stmt)->body);
+                return stmt;
+            case RETURN_STMT: {
+                ReturnStmt* s = (ReturnStmt*)stmt;
+                if (s->value) s->value = fold(s->value);
+                return stmt;
+            }
+            case LET_STMT: {
+                LetStmt* s = (LetStmt*)stmt;
+                s->initializer = fold(s->initializer);
+                const Usage& u = usage[s->name];
+                s->fixed = u.declarations == 1 && u.assignments == 0;
+                if (s->fixed && s->initializer->type == LITERAL) {
+                    Literal* lit = asDeclaredType((Literal*)s->initializer, s->typeName);
+                    if (lit) {
+                        constants[s->name] = lit;
+                        propagated.push_back({s, blocks.empty() ? nullptr : blocks.back()});
+                    }
+                }
+                return stmt;
+            }
+            case ASSIGN_STMT: {
+                AssignStmt* s = (AssignStmt*)stmt;
+                s->value = fold(s->value);
+                return stmt;
+            }
+            case EXPR_STMT: {
+                ExprStmt* s = (ExprStmt*)stmt;
+                s->expr = fold(s->expr);
+                return stmt;
+            }
+            default:
+                return stmt;
+        }
+    }
+
+    Statement* optimizeSwitch(SwitchStmt* s) {
+        s->discriminant = fold(s->discriminant);
+        Literal* known = s->discriminant->type == LITERAL ? (Literal*)s->discriminant : nullptr;
+
+        std::vector<SwitchStmt::Case> live;
+        for (auto& c : s->cases) {
+            if (c.value) c.value = fold(c.value);
+            if (c.guard) c.guard = fold(c.guard);
+            if (c.guard && c.guard->type == LITERAL && !isTruthy((Literal*)c.guard)) continue;
+            if (c.guard && c.guard->type == LITERAL) c.guard = nullptr; // always true
+
+            bool catchAll = !c.value && !c.guard;
+            int match = (known && c.value && c.value->type == LITERAL) ? equals(known, (Literal*)c.value) : -1;
+            if (match == 0) continue; // can never match
+
+            c.body = optimize(c.body);
+            if (!c.body) c.body = emptyBlock();
+            live.push_back(c);
+            // Nothing after an arm that is certain to match can run.
+            if (catchAll || (match == 1 && !c.guard)) break;
+        }
+        if (live.empty()) return nullptr;
+        s->cases = List<SwitchStmt::Case>(*arena, live);
+        return s;
+    }
+
+    BlockStmt* emptyBlock() {
+        return arena->make<BlockStmt>(List<Statement*>());
+    }
+
+    // --- Expressions ---
+
+    Expression* fold(Expression* expr) {
+        switch (expr->type) {
+            case IDENTIFIER: {
+                auto it = constants.find(((Identifier*)expr)->name);
+                if (it == constants.end()) return expr;
+                usage[it->first].replaced++;
+                return arena->make<Literal>(it->second->value, it->second->kind);
+            }
+            case ASSIGN_EXPR:
+                ((AssignExpr*)expr)->value = fold(((AssignExpr*)expr)->value);
+                return expr;
+            case CALL_EXPR: {
+                CallExpr* e = (CallExpr*)expr;
+                for (auto& arg : e->args) arg = fold(arg);
+                return expr;
+            }
+            case LIST_EXPR:
+                for (auto& item : ((ListExpr*)expr)->items) item = fold(item);
+                return expr;
+            case MAP_EXPR:
+                for (auto& k : ((MapExpr*)expr)->keys) k = fold(k);
+                for (auto& v : ((MapExpr*)expr)->values) v = fold(v);
+                return expr;
+            case INDEX_EXPR: {
+                IndexExpr* e = (IndexExpr*)expr;
+                e->target = fold(e->target);
+                e->index = fold(e->index);
+                return expr;
+            }
+            case FIELD_EXPR:
+                ((FieldExpr*)expr)->object = fold(((FieldExpr*)expr)->object);
+                return expr;
+            case CHANNEL_EXPR: {
+                ChannelExpr* e = (ChannelExpr*)expr;
+                if (e->capacity) e->capacity = fold(e->capacity);
+                return expr;
+            }
+            case LAMBDA_EXPR: {
+                LambdaExpr* e = (LambdaExpr*)expr;
+                if (e->result) e->result = fold(e->result);
+                else optimizeBlock(e->body);
+                return expr;
+            }
+            case UNARY_EXPR: {
+                UnaryExpr* e = (UnaryExpr*)expr;
+                e->right = fold(e->right);
+                if (e->right->type != LITERAL) return expr;
+                Literal* lit = (Literal*)e->right;
+                if (lit->kind == LIT_INT && lit->value[0] != '-') return literal("-" + std::string(lit->value), LIT_INT);
+                if (lit->kind == LIT_FLOAT) return floatLiteral(-toDouble(lit));
+                return expr;
+            }
+            case BINARY_EXPR: {
+                BinaryExpr* e = (BinaryExpr*)expr;
+                e->left = fold(e->left);
+                e->right = fold(e->right);
+                if (e->left->type != LITERAL || e->right->type != LITERAL) return expr;
+                Expression* folded = foldBinary(e->op, (Literal*)e->left, (Literal*)e->right);
+                return folded ? folded : expr;
+            }
+            default:
+                return expr;
+        }
+    }
+
+    // Returns nullptr whenever the runtime result could differ from what we
+    // would compute here (overflow, division by zero, float formatting).
+    Expression* foldBinary(BinaryOp op, Literal* l, Literal* r) {
+        bool numeric = isNumeric(l) && isNumeric(r);
+
+        if (op == OP_ADD && (l->kind == LIT_STRING || r->kind == LIT_STRING)) {
+            // Floats are formatted by the runtime, so only exact spellings fold.
+            if (l->kind == LIT_FLOAT || r->kind == LIT_FLOAT) return nullptr;
+            if (l->kind == LIT_NONE || r->kind == LIT_NONE) return nullptr;
+            // Joining raw spellings could merge escape sequences.
+            if (hasEscapes(l, r)) return nullptr;
+            return literal(spelling(l) + spelling(r), LIT_STRING);
+        }
+
+        if (op == OP_EQ) {
+            int eq = equals(l, r);
+            return eq < 0 ? nullptr : boolLiteral(eq == 1);
+        }
+
+        if (!numeric) return nullptr;
+
+        if (l->kind == LIT_INT && r->kind == LIT_INT) {
+            long long a, b, out;
+            if (!toInt(l, a) || !toInt(r, b) || !exact(a) || !exact(b)) return nullptr;
+            switch (op) {
+                case OP_ADD: if (__builtin_add_overflow(a, b, &out)) return nullptr; return intLiteral(out);
+                case OP_SUB: if (__builtin_sub_overflow(a, b, &out)) return nullptr; return intLiteral(out);
+                case OP_MUL: if (__builtin_mul_overflow(a, b, &out)) return nullptr; return intLiteral(out);
+                case OP_MOD: if (b == 0 || (a == LLONG_MIN && b == -1)) return nullptr; return intLiteral(a % b);
+                case OP_POW: {
+                    if (b < 0) return nullptr;
+                    out = 1;
+                    for (long long i = 0; i < b; i++) {
+                        if (__builtin_mul_overflow(out, a, &out)) return nullptr;
+                    }
+                    return intLiteral(out);
+                }
+                case OP_DIV: return b == 0 ? nullptr : floatLiteral((double)a / (double)b);
+                case OP_LT: return boolLiteral(a < b);
+                case OP_GT: return boolLiteral(a > b);
+                case OP_LE: return boolLiteral(a <= b);
+                case OP_GE: return boolLiteral(a >= b);
+                default: return nullptr;
+            }
+        }
+
+        double a = toDouble(l), b = toDouble(r);
+        switch (op) {
+            case OP_ADD: return floatLiteral(a + b);
+            case OP_SUB: return floatLiteral(a - b);
+            case OP_MUL: return floatLiteral(a * b);
+            case OP_DIV: return floatLiteral(a / b);
+            case OP_MOD: return floatLiteral(fmod(a, b));
+            case OP_POW: return floatLiteral(pow(a, b));
+            case OP_LT: return boolLiteral(a < b);
+            case OP_GT: return boolLiteral(a > b);
+            case OP_LE: return boolLiteral(a <= b);
+            case OP_GE: return boolLiteral(a >= b);
+            default: return nullptr;
+        }
+    }
+
+    // 1 = equal, 0 = different, -1 = unknown. Mirrors Value's operator==.
+    static int equals(Literal* l, Literal* r) {
+        if (isNumeric(l) && isNumeric(r)) {
+            long long a, b;
+            if (l->kind == LIT_INT && r->kind == LIT_INT && toInt(l, a) && toInt(r, b)) return a == b ? 1 : 0;
+            return toDouble(l) == toDouble(r) ? 1 : 0;
+        }
+        if (l->kind != r->kind) return 0;
+        if (l->kind == LIT_STRING && hasEscapes(l, r)) return -1;
+        return l->value == r->value ? 1 : 0;
+    }
+
+    // Mirrors isTruthy(): bools and non-zero numbers are true, everything else false.
+    static bool isTruthy(Literal* lit) {
+        if (lit->kind == LIT_BOOL) return lit->value == "true";
+        if (isNumeric(lit)) return toDouble(lit) != 0;
+        return false;
+    }
+
+    // A constant propagated into a typed let must keep the let's type.
+    Literal* asDeclaredType(Literal* lit, std::string_view typeName) {
+        const Type* declared = Type::fromName(typeName);
+        switch (declared->kind) {
+            case TY_VALUE: return lit;
+            case TY_NUMBER:
+                if (lit->kind == LIT_FLOAT) return lit;
+                if (lit->kind == LIT_INT) return literal(std::string(lit->value) + ".0", LIT_FLOAT);
+                return nullptr;
+            case TY_INT: return nullptr; // an integer literal alone is число; the C++ compiler folds an int64_t
+            case TY_BOOL: return lit->kind == LIT_BOOL ? lit : nullptr;
+            case TY_STRING: return lit->kind == LIT_STRING ? lit : nullptr;
+            default: return nullptr;
+        }
+    }
+
+    // How toString() renders a literal that is not a float.
+    static std::string spelling(Literal* lit) {
+        long long v;
+        if (lit->kind == LIT_INT && toInt(lit, v)) return std::to_string(v);
+        return std::string(lit->value);
+    }
+
+    static bool hasEscapes(Literal* l, Literal* r) {
+        return l->value.find('\\') != std::string_view::npos || r->value.find('\\') != std::string_view::npos;
+    }
+
+    static bool isNumeric(Literal* lit) { return lit->kind == LIT_INT || lit->kind == LIT_FLOAT; }
+
+    static double toDouble(Literal* lit) { return strtod(std::string(lit->value).c_str(), nullptr); }
+
+    static bool toInt(Literal* lit, long long& out) {
+        errno = 0;
+        out = strtoll(std::string(lit->value).c_str(), nullptr, 10);
+        return errno == 0;
+    }
+
+    Literal* literal(const std::string& text, LiteralKind kind) {
+        return arena->make<Literal>(arena->copy(text), kind);
+    }
+
+    Literal* intLiteral(long long v) {
+        if (!exact(v)) return nullptr;
+        return literal(std::to_string(v), LIT_INT);
+    }
+
+    // Beyond 2^53 a double, which an unannotated literal is, rounds, so
+    // integer math there is left to the runtime.
+    static bool exact(long long v) { return v <= (1LL << 53) && v >= -(1LL << 53); }
+
+    Literal* boolLiteral(bool b) {
+        return arena->make<Literal>(b ? "true" : "false", LIT_BOOL);
+    }
+
+    // Round-trip precision, and always spelled as a float so it stays число.
+    Literal* floatLiteral(double d) {
+        if (!std::isfinite(d)) return nullptr;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.17g", d);
+        std::string text = buf;
+        if (text.find_first_of(".e") == std::string::npos) text += ".0";
+        return literal(text, LIT_FLOAT);
+    }
+};
+
+#endif
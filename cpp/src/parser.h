@@ -4,132 +4,270 @@
 #include "lexer.h"
 #include "ast.h"
 
+// Pulls tokens from the lexer on demand. The grammar needs at most one token
+// of lookahead past the cursor plus previous(), so a tiny ring buffer is
+// enough and front-end memory stays flat regardless of input size.
 class Parser {
-    std::vector<Token> tokens;
-    size_t current;
+    static const size_t WINDOW = 4; // power of two
+    Lexer& lexer;
+    Token window[WINDOW];
+    size_t lexed;   // tokens pulled from the lexer so far
+    size_t current; // absolute index of the token under the cursor
+    Arena* arena = nullptr; // owned by the Program being parsed
+    std::string path;       // of the source, for messages
     
 public:
-    Parser(std::vector<Token> t) : tokens(t), current(0) {}
+    Parser(Lexer& l, std::string path = "") : lexer(l), lexed(0), current(0), path(std::move(path)) {}
     
     std::unique_ptr<Program> parse() {
         auto prog = std::make_unique<Program>();
+        prog->path = path;
+        arena = &prog->arena;
+        std::vector<Statement*> body;
         while (!isAtEnd()) {
-            prog->body.push_back(declaration());
+            body.push_back(declaration());
         }
+        prog->body = List<Statement*>(*arena, body);
         return prog;
     }
     
-    std::unique_ptr<Statement> declaration() {
+    // Placed at the token just read; declaration() moves a statement to
+    // its first token.
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* node = arena->make<T>(std::forward<Args>(args)...);
+        if (current > 0) place(node, previous());
+        return node;
+    }
+
+    static void place(Node* node, const Token& t) {
+        node->line = t.line;
+        node->column = t.column;
+    }
+    
+    Statement* declaration() {
+        if (check(TOK_AT)) return attributedDecl();
+        Token first = peek();
+        Statement* stmt = unplacedDeclaration();
+        place(stmt, first);
+        return stmt;
+    }
+
+    Statement* unplacedDeclaration() {
         if (match(TOK_FN)) return functionDecl();
+        if (match(TOK_CLASS)) return classDecl(false);
+        if (matchData()) return classDecl(true);
         if (match(TOK_LET)) return letDecl();
+        if (match(TOK_IMPORT)) {
+            std::string_view path = arena->copy(consume(TOK_STRING, "Expected module path after import").text);
+            if (check(TOK_SEMICOLON)) advance();
+            return make<ImportStmt>(path);
+        }
         
         // Check for Assignment: ID = Expr
-        if (isName(peek()) && current + 1 < tokens.size() && tokens[current + 1].type == TOK_EQ) {
+        if (isName(peek()) && peekNext().type == TOK_EQ) {
             Token name = advance();
             advance(); // consume '='
             auto value = expression();
             if (check(TOK_SEMICOLON)) advance();
-            return std::make_unique<AssignStmt>(name.text, std::move(value));
+            return make<AssignStmt>(arena->copy(name.text), value);
         }
         
         return statement();
     }
     
-    std::unique_ptr<Statement> functionDecl() {
+    // `@мемо функція ...` or `@soa дані ...`: attributes apply to function
+    // and class declarations.
+    Statement* attributedDecl() {
+        std::vector<std::string_view> attributes;
+        while (match(TOK_AT)) {
+            attributes.push_back(arena->copy(consume(TOK_IDENTIFIER, "Expected attribute name after @").text));
+        }
+        bool data = matchData();
+        if (data || match(TOK_CLASS)) {
+            ClassDecl* cls = (ClassDecl*)classDecl(data);
+            cls->attributes = List<std::string_view>(*arena, attributes);
+            return cls;
+        }
+        consume(TOK_FN, "Expected function or class declaration after attribute");
+        FunctionDecl* fn = (FunctionDecl*)functionDecl();
+        fn->attributes = List<std::string_view>(*arena, attributes);
+        return fn;
+    }
+    
+    // After `функція`; the function is placed there.
+    Statement* functionDecl() {
+        Token keyword = previous();
         Token name = consume(TOK_IDENTIFIER, "Expected function name");
         consume(TOK_LPAREN, "Expected (");
+        List<FunctionDecl::Param> params = parameters();
+        
+        std::string_view returnType = "Value";
+        if (match(TOK_COLON)) returnType = typeName();
+        
+        consume(TOK_LBRACE, "Expected {");
+        auto body = block();
+        FunctionDecl* fn = make<FunctionDecl>(arena->copy(name.text), params, returnType, body);
+        place(fn, keyword);
+        return fn;
+    }
+
+    // `дані` (`data`) is a name like any other, except at the start of a
+    // declaration: `дані Користувач(...)` or `data class User(...)`.
+    // Consumes it, and a `клас` after it, there.
+    bool matchData() {
+        if (!check(TOK_IDENTIFIER) || (peek().text != "дані" && peek().text != "data")) return false;
+        TokenType next = peekNext().type;
+        if (next != TOK_IDENTIFIER && next != TOK_CLASS) return false;
+        advance();
+        match(TOK_CLASS);
+        return true;
+    }
+
+    // `Точка(x: число, y: число) { ... }` after `клас` or `дані`. The
+    // constructor's parameter list and the body are each optional.
+    Statement* classDecl(bool data) {
+        Token keyword = previous();
+        std::string_view name = arena->copy(consume(TOK_IDENTIFIER, "Expected class name").text);
+        std::vector<ClassDecl::Field> fields;
+        if (match(TOK_LPAREN)) {
+            for (const auto& p : parameters()) fields.push_back({p.name, p.typeName, nullptr});
+        }
+        size_t constructorFields = fields.size();
+        std::vector<FunctionDecl*> methods;
+        if (match(TOK_LBRACE)) {
+            while (!check(TOK_RBRACE) && !isAtEnd()) {
+                if (match(TOK_FN)) methods.push_back((FunctionDecl*)functionDecl());
+                else if (match(TOK_LET)) fields.push_back(fieldDecl());
+                else error("Expected нехай or функція in a class body");
+            }
+            consume(TOK_RBRACE, "Expected } after class body");
+        }
+        ClassDecl* cls = make<ClassDecl>(name, List<ClassDecl::Field>(*arena, fields), constructorFields,
+                                         List<FunctionDecl*>(*arena, methods), data);
+        place(cls, keyword);
+        return cls;
+    }
+
+    // `нехай n: ціле`, `нехай n = 0` or both, in a class body.
+    ClassDecl::Field fieldDecl() {
+        std::string_view name = arena->copy(consume(TOK_IDENTIFIER, "Expected field name").text);
+        std::string_view type = "Value";
+        Expression* init = nullptr;
+        if (match(TOK_COLON)) type = typeName();
+        if (match(TOK_EQ)) init = expression();
+        else if (type == "Value") error("A field needs a type or an initializer");
+        if (check(TOK_SEMICOLON)) advance();
+        return {name, type, init};
+    }
+
+    // `a: ціле, b)`, after the opening parenthesis (or `a, b|` after a `|`).
+    List<FunctionDecl::Param> parameters(TokenType close = TOK_RPAREN) {
         std::vector<FunctionDecl::Param> params;
-        if (!check(TOK_RPAREN)) {
+        if (!check(close)) {
             do {
-                std::string paramName = consume(TOK_IDENTIFIER, "Expected param name").text;
-                std::string paramType = "Value";
-                if (match(TOK_COLON)) {
-                    paramType = consume(TOK_IDENTIFIER, "Expected type name").text;
-                }
+                std::string_view paramName = arena->copy(consume(TOK_IDENTIFIER, "Expected param name").text);
+                std::string_view paramType = "Value";
+                if (match(TOK_COLON)) paramType = typeName();
                 params.push_back({paramName, paramType});
             } while (match(TOK_COMMA));
         }
-        consume(TOK_RPAREN, "Expected )");
-        
-        std::string returnType = "Value";
-        if (match(TOK_COLON)) {
-             returnType = consume(TOK_IDENTIFIER, "Expected return type").text;
-        }
-        
-        consume(TOK_LBRACE, "Expected {");
-        auto body = block();
-        return std::make_unique<FunctionDecl>(name.text, params, returnType, std::move(body));
+        consume(close, close == TOK_BAR ? "Expected | after lambda parameters" : "Expected )");
+        return List<FunctionDecl::Param>(*arena, params);
     }
     
-    bool isName(Token t) {
+    // `ціле` or a generic such as `Список<число>`. Returned without spaces,
+    // which is the spelling Type::fromName() understands.
+    std::string_view typeName() {
+        std::string spelling(consume(TOK_IDENTIFIER, "Expected type name").text);
+        if (match(TOK_LT)) {
+            spelling += '<';
+            do {
+                if (spelling.back() != '<') spelling += ',';
+                spelling += typeName();
+            } while (match(TOK_COMMA));
+            consume(TOK_GT, "Expected > after type arguments");
+            spelling += '>';
+        }
+        return arena->copy(spelling);
+    }
+
+    bool isName(const Token& t) {
         return t.type == TOK_IDENTIFIER || t.type == TOK_TRUE || t.type == TOK_FALSE || t.type == TOK_NONE;
     }
 
-    std::unique_ptr<Statement> letDecl() {
+    Statement* letDecl() {
         Token name = advance(); // already matched TOK_LET
         if (!isName(name)) {
              name = consume(TOK_IDENTIFIER, "Expected variable name");
         }
-        std::string nameStr = name.text;
+        std::string_view nameStr = arena->copy(name.text);
         
-        std::string typeName = "Value";
-        if (match(TOK_COLON)) {
-            typeName = consume(TOK_IDENTIFIER, "Expected type name").text;
-        }
+        std::string_view typeName = "Value";
+        if (match(TOK_COLON)) typeName = this->typeName();
         
         consume(TOK_EQ, "Expected =");
         auto init = expression();
         if (check(TOK_SEMICOLON)) advance();
-        return std::make_unique<LetStmt>(nameStr, typeName, std::move(init));
+        return make<LetStmt>(nameStr, typeName, init);
     }
     
-    std::unique_ptr<Statement> statement() {
+    Statement* statement() {
         if (match(TOK_IF)) return ifStmt();
         if (match(TOK_SWITCH)) return switchStmt();
         if (match(TOK_WHILE)) return whileStmt();
+        if (match(TOK_FOR)) return forStmt();
+        if (match(TOK_PARALLEL)) {
+            consume(TOK_FOR, "Expected for/для after parallel");
+            ForStmt* loop = (ForStmt*)forStmt();
+            if (!loop->from) error("A parallel loop needs a from/від ... to/до range");
+            loop->parallel = true;
+            return loop;
+        }
         if (match(TOK_RETURN)) return returnStmt();
+        if (match(TOK_SPAWN)) {
+            consume(TOK_LBRACE, "Expected { after spawn");
+            return make<SpawnStmt>(block());
+        }
         if (match(TOK_LBRACE)) {
-            auto blk = block();
-            std::vector<std::unique_ptr<Statement>> stmts;
-            // Wrap block in statement wrapper? 
             // BlockStmt is Statement.
-            return blk;
+            return block();
         }
         return exprStmt();
 
     }
     
-    std::unique_ptr<BlockStmt> block() {
-        auto blk = std::make_unique<BlockStmt>();
+    BlockStmt* block() {
+        std::vector<Statement*> statements;
         while (!check(TOK_RBRACE) && !isAtEnd()) {
-            blk->statements.push_back(declaration());
+            statements.push_back(declaration());
         }
         consume(TOK_RBRACE, "Expected }");
-        return blk;
+        return make<BlockStmt>(List<Statement*>(*arena, statements));
     }
     
-    std::unique_ptr<Statement> ifStmt() {
+    Statement* ifStmt() {
         // Do not manualy consume parens, let expression parser handle grouping if present.
         auto cond = expression();
         consume(TOK_LBRACE, "Expected { after condition"); 
         auto thenBranch = block();
-        std::unique_ptr<Statement> elseBranch = nullptr;
+        Statement* elseBranch = nullptr;
         if (match(TOK_ELSE)) {
             consume(TOK_LBRACE, "Expected { after else");
             elseBranch = block();
         }
-        return std::make_unique<IfStmt>(std::move(cond), std::move(thenBranch), std::move(elseBranch));
+        return make<IfStmt>(cond, thenBranch, elseBranch);
     }
     
-    std::unique_ptr<Statement> switchStmt() {
+    Statement* switchStmt() {
         auto discriminant = expression();
         consume(TOK_LBRACE, "Expected { after switch discriminant");
         std::vector<SwitchStmt::Case> cases;
         while (!check(TOK_RBRACE) && !isAtEnd()) {
             if (match(TOK_CASE)) {
-                std::string patternName = "";
-                std::unique_ptr<Expression> val = nullptr;
-                std::unique_ptr<Expression> guard = nullptr;
+                std::string_view patternName = "";
+                Expression* val = nullptr;
+                Expression* guard = nullptr;
                 
                 // Pattern
                 if (check(TOK_NUMBER) || check(TOK_STRING) || check(TOK_TRUE) || check(TOK_FALSE)) {
@@ -137,7 +275,7 @@ public:
                     val = primary(); 
                 } else if (isName(peek())) {
                     Token t = advance();
-                    patternName = t.text;
+                    patternName = arena->copy(t.text);
                     if (patternName != "_") {
                         // It's a variable binding pattern or just a name
                     }
@@ -156,145 +294,291 @@ public:
                 }
                 
                 auto body = declaration();
-                cases.push_back({patternName, std::move(val), std::move(guard), std::move(body)});
+                cases.push_back({patternName, val, guard, body});
             } else if (match(TOK_DEFAULT)) {
                 consume(TOK_COLON, "Expected : after default");
                 auto body = declaration();
-                cases.push_back({"_", nullptr, nullptr, std::move(body)});
+                cases.push_back({"_", nullptr, nullptr, body});
             } else {
                 error("Expected case or default in switch block");
             }
         }
         consume(TOK_RBRACE, "Expected } at end of switch");
-        return std::make_unique<SwitchStmt>(std::move(discriminant), std::move(cases));
+        return make<SwitchStmt>(discriminant, List<SwitchStmt::Case>(*arena, cases));
     }
     
-    std::unique_ptr<Statement> whileStmt() {
+    Statement* whileStmt() {
         auto cond = expression();
         consume(TOK_LBRACE, "Expected { after while condition");
         auto body = block();
-        return std::make_unique<WhileStmt>(std::move(cond), std::move(body));
+        return make<WhileStmt>(cond, body);
     }
 
-    std::unique_ptr<Statement> returnStmt() {
+    // `для x в xs { }` or `для і від a до b { }`. в, від and до are only
+    // words of the loop header, so they stay free as names elsewhere.
+    Statement* forStmt() {
+        std::string_view var = arena->copy(consume(TOK_IDENTIFIER, "Expected loop variable after for").text);
+        Expression* iterable = nullptr;
+        Expression* from = nullptr;
+        Expression* to = nullptr;
+        if (matchWord("в", "in")) {
+            iterable = expression();
+        } else if (matchWord("від", "from")) {
+            from = expression();
+            if (!matchWord("до", "to")) error("Expected to/до after loop start");
+            to = expression();
+        } else {
+            error("Expected in/в or from/від after loop variable");
+        }
+        consume(TOK_LBRACE, "Expected { after for header");
+        auto body = block();
+        return make<ForStmt>(var, iterable, from, to, body);
+    }
+
+    Statement* returnStmt() {
         auto value = expression();
         // Semicolon?
         if (check(TOK_SEMICOLON)) advance();
-        return std::make_unique<ReturnStmt>(std::move(value));
+        return make<ReturnStmt>(value);
     }
     
-    std::unique_ptr<Statement> exprStmt() {
+    Statement* exprStmt() {
         auto expr = expression();
+        if (expr->type == INDEX_EXPR && match(TOK_EQ)) {
+            auto value = expression();
+            if (check(TOK_SEMICOLON)) advance();
+            return make<IndexAssignStmt>((IndexExpr*)expr, value);
+        }
+        if (expr->type == FIELD_EXPR && match(TOK_EQ)) {
+            auto value = expression();
+            if (check(TOK_SEMICOLON)) advance();
+            return make<FieldAssignStmt>((FieldExpr*)expr, value);
+        }
         if (check(TOK_SEMICOLON)) advance();
-        return std::make_unique<ExprStmt>(std::move(expr));
+        return make<ExprStmt>(expr);
     }
     
-    std::unique_ptr<Expression> expression() {
-        if (isName(peek()) && current + 1 < tokens.size() && tokens[current + 1].type == TOK_EQ) {
+    Expression* expression() {
+        if (isName(peek()) && peekNext().type == TOK_EQ) {
             Token name = advance();
             advance(); // consume '='
             auto value = expression();
-            return std::make_unique<AssignExpr>(name.text, std::move(value));
+            return make<AssignExpr>(arena->copy(name.text), value);
         }
-        return equality();
+        return pipeline();
+    }
+
+    // `a |> f(b)` is `f(a, b)`, and `a |> f` is `f(a)`: stages read left
+    // to right.
+    Expression* pipeline() {
+        auto expr = equality();
+        while (match(TOK_PIPE)) {
+            Expression* stage = call();
+            std::vector<Expression*> args{expr};
+            if (stage->type == CALL_EXPR) {
+                CallExpr* c = (CallExpr*)stage;
+                args.insert(args.end(), c->args.begin(), c->args.end());
+                stage = c->callee;
+            } else if (stage->type != IDENTIFIER) {
+                error("Expected a call after |>");
+            }
+            expr = make<CallExpr>(stage, List<Expression*>(*arena, args));
+        }
+        return expr;
     }
     
-    std::unique_ptr<Expression> equality() {
+    Expression* equality() {
         auto expr = comparison();
         while (match(TOK_EQ_EQ)) {
             auto right = comparison();
-            expr = std::make_unique<BinaryExpr>("==", std::move(expr), std::move(right));
+            expr = make<BinaryExpr>(OP_EQ, expr, right);
         }
         return expr;
     }
     
-    std::unique_ptr<Expression> comparison() {
+    Expression* comparison() {
         auto expr = term();
         while (check(TOK_LT) || check(TOK_GT) || check(TOK_LE) || check(TOK_GE)) {
             Token op = advance();
             auto right = term();
-            expr = std::make_unique<BinaryExpr>(op.text, std::move(expr), std::move(right));
+            expr = make<BinaryExpr>(binaryOp(op.type), expr, right);
         }
         return expr;
     }
     
-    std::unique_ptr<Expression> term() {
+    Expression* term() {
         auto expr = factor();
         while (check(TOK_PLUS) || check(TOK_MINUS)) {
              Token op = advance();
              auto right = factor();
-             expr = std::make_unique<BinaryExpr>(op.text, std::move(expr), std::move(right));
+             expr = make<BinaryExpr>(binaryOp(op.type), expr, right);
         }
         return expr;
     }
     
-    std::unique_ptr<Expression> factor() {
+    Expression* factor() {
         auto expr = unary(); 
         // Factor is * / % **
         while (check(TOK_STAR) || check(TOK_SLASH) || check(TOK_PERCENT) || check(TOK_POWER)) {
              Token op = advance();
              auto right = unary(); 
-             expr = std::make_unique<BinaryExpr>(op.text, std::move(expr), std::move(right));
+             expr = make<BinaryExpr>(binaryOp(op.type), expr, right);
         }
         return expr;
     }
     
-    std::unique_ptr<Expression> unary() {
+    Expression* unary() {
         if (match(TOK_MINUS)) {
-            Token op = previous();
             auto right = unary();
-            return std::make_unique<UnaryExpr>(op.text, std::move(right));
+            return make<UnaryExpr>(OP_NEG, right);
         }
         return call();
     }
     
-    std::unique_ptr<Expression> call() {
+    Expression* call() {
         auto expr = primary();
-        while (match(TOK_LPAREN)) {
-            expr = finishCall(std::move(expr));
+        while (true) {
+            if (match(TOK_LPAREN)) {
+                expr = finishCall(expr);
+            } else if (match(TOK_LBRACKET)) {
+                auto index = expression();
+                consume(TOK_RBRACKET, "Expected ] after index");
+                expr = make<IndexExpr>(expr, index);
+            } else if (match(TOK_DOT)) {
+                // `x.f(a)` is `f(x, a)` unless x's class has a method f, so
+                // builtins read as methods too: ch.send(1). Without the
+                // parentheses it is a field.
+                std::string_view name = arena->copy(consume(TOK_IDENTIFIER, "Expected field or method name after .").text);
+                if (match(TOK_LPAREN)) {
+                    CallExpr* call = (CallExpr*)finishCall(make<Identifier>(name), expr);
+                    call->receiver = true;
+                    expr = call;
+                } else {
+                    expr = make<FieldExpr>(expr, name);
+                }
+            } else {
+                return expr;
+            }
         }
-        return expr;
     }
 
     // Rewrite precedence layers closer to real grammar
     // equality -> comparison -> term -> factor -> unary -> call -> primary
     
-    std::unique_ptr<Expression> primary() {
-        if (match(TOK_NUMBER)) return std::make_unique<Literal>(previous().text, "float");
-        if (check(TOK_STRING)) return std::make_unique<Literal>(consume(TOK_STRING, "strs").text, "string");
+    Expression* primary() {
+        if (match(TOK_NUMBER)) {
+            std::string_view text = arena->copy(previous().text);
+            return make<Literal>(text, text.find('.') == std::string_view::npos ? LIT_INT : LIT_FLOAT);
+        }
+        if (check(TOK_STRING)) return make<Literal>(arena->copy(consume(TOK_STRING, "strs").text), LIT_STRING);
         
         // Handle keywords as literals OR identifiers
         if (check(TOK_TRUE) || check(TOK_FALSE) || check(TOK_NONE) || check(TOK_IDENTIFIER)) {
             Token t = advance();
-            std::string name = t.text;
             
             // If just the token, is it a boolean literal or an identifier?
-            if (t.type == TOK_TRUE) return std::make_unique<Literal>("true", "bool");
-            if (t.type == TOK_FALSE) return std::make_unique<Literal>("false", "bool");
-            if (t.type == TOK_NONE) return std::make_unique<Literal>("0", "none");
+            if (t.type == TOK_TRUE) return make<Literal>("true", LIT_BOOL);
+            if (t.type == TOK_FALSE) return make<Literal>("false", LIT_BOOL);
+            if (t.type == TOK_NONE) return make<Literal>("0", LIT_NONE);
+            if ((t.text == "канал" || t.text == "channel") && check(TOK_LT)) return channel();
             
-            return std::make_unique<Identifier>(name);
+            return make<Identifier>(arena->copy(t.text));
         }
+        if (match(TOK_BAR)) return barLambda();
         if (match(TOK_LPAREN)) {
+            if (lambdaAhead()) return lambda();
             auto expr = expression();
             consume(TOK_RPAREN, "Expected )");
             return expr;
         }
+        if (match(TOK_LBRACKET)) {
+            std::vector<Expression*> items;
+            if (!check(TOK_RBRACKET)) {
+                do {
+                    items.push_back(expression());
+                } while (match(TOK_COMMA));
+            }
+            consume(TOK_RBRACKET, "Expected ] after list items");
+            return make<ListExpr>(List<Expression*>(*arena, items));
+        }
+        // A `{` only starts an expression as a map literal; blocks are statements.
+        if (match(TOK_LBRACE)) {
+            std::vector<Expression*> keys, values;
+            if (!check(TOK_RBRACE)) {
+                do {
+                    keys.push_back(expression());
+                    consume(TOK_COLON, "Expected : after map key");
+                    values.push_back(expression());
+                } while (match(TOK_COMMA));
+            }
+            consume(TOK_RBRACE, "Expected } after map entries");
+            return make<MapExpr>(List<Expression*>(*arena, keys), List<Expression*>(*arena, values));
+        }
         
         // Error handling
         std::cerr << "Parser Error: Unexpected token " << peek().text << " in expression." << std::endl;
         exit(1);
     }
     
-    std::unique_ptr<Expression> finishCall(std::unique_ptr<Expression> callee) {
-        std::vector<std::unique_ptr<Expression>> args;
+    // After `(`: `) =>`, `x,`, `x:` and `x) =>` can only start a lambda.
+    bool lambdaAhead() {
+        if (check(TOK_RPAREN)) return true;
+        if (!check(TOK_IDENTIFIER)) return false;
+        TokenType next = peekNext().type;
+        return next == TOK_COMMA || next == TOK_COLON || (next == TOK_RPAREN && at(current + 2).type == TOK_ARROW);
+    }
+
+    Expression* lambda() {
+        List<FunctionDecl::Param> params = parameters();
+        consume(TOK_ARROW, "Expected => after lambda parameters");
+        if (match(TOK_LBRACE)) return make<LambdaExpr>(params, nullptr, block());
+        return make<LambdaExpr>(params, expression(), nullptr);
+    }
+
+    // `|x| x * 2`, `|a, b: ціле| { ... }` and `|| ...`, after the first `|`.
+    Expression* barLambda() {
+        List<FunctionDecl::Param> params = parameters(TOK_BAR);
+        if (match(TOK_LBRACE)) return make<LambdaExpr>(params, nullptr, block());
+        return make<LambdaExpr>(params, expression(), nullptr);
+    }
+
+    // `канал<ціле>(16)`, after the name.
+    Expression* channel() {
+        consume(TOK_LT, "Expected < after channel");
+        std::string_view element = typeName();
+        consume(TOK_GT, "Expected > after channel element type");
+        consume(TOK_LPAREN, "Expected ( after channel type");
+        Expression* capacity = check(TOK_RPAREN) ? nullptr : expression();
+        consume(TOK_RPAREN, "Expected ) after channel capacity");
+        return make<ChannelExpr>(element, capacity);
+    }
+
+    Expression* finishCall(Expression* callee, Expression* receiver = nullptr) {
+        std::vector<Expression*> args;
+        if (receiver) args.push_back(receiver);
         if (!check(TOK_RPAREN)) {
             do {
                 args.push_back(expression());
             } while (match(TOK_COMMA));
         }
         consume(TOK_RPAREN, "Expected ) after arguments");
-        return std::make_unique<CallExpr>(std::move(callee), std::move(args));
+        return make<CallExpr>(callee, List<Expression*>(*arena, args));
+    }
+
+    static BinaryOp binaryOp(TokenType type) {
+        switch (type) {
+            case TOK_PLUS: return OP_ADD;
+            case TOK_MINUS: return OP_SUB;
+            case TOK_STAR: return OP_MUL;
+            case TOK_SLASH: return OP_DIV;
+            case TOK_PERCENT: return OP_MOD;
+            case TOK_POWER: return OP_POW;
+            case TOK_LT: return OP_LT;
+            case TOK_GT: return OP_GT;
+            case TOK_LE: return OP_LE;
+            case TOK_GE: return OP_GE;
+            default: return OP_EQ;
+        }
     }
 
     bool match(TokenType type) {
@@ -305,6 +589,14 @@ public:
         return false;
     }
     
+    // An identifier spelled `a` or `b`, for words that are keywords in one
+    // place only.
+    bool matchWord(std::string_view a, std::string_view b) {
+        if (!check(TOK_IDENTIFIER) || (peek().text != a && peek().text != b)) return false;
+        advance();
+        return true;
+    }
+
     bool check(TokenType type) {
         if (isAtEnd()) return false;
         return peek().type == type;
@@ -316,28 +608,43 @@ public:
     }
     
     bool isAtEnd() {
-        return current >= tokens.size() || tokens[current].type == TOK_EOF;
+        return peek().type == TOK_EOF;
     }
     
-    Token peek() {
-        return tokens[current];
+    const Token& peek() {
+        return at(current);
     }
     
-    Token previous() {
-        return tokens[current - 1];
+    const Token& peekNext() {
+        return at(current + 1);
+    }
+    
+    const Token& previous() {
+        return at(current - 1);
+    }
+    
+    const Token& at(size_t index) {
+        while (lexed <= index) window[lexed++ % WINDOW] = lexer.next();
+        return window[index % WINDOW];
     }
     
     Token consume(TokenType type, const char* msg) {
         if (check(type)) return advance();
-        std::cerr << "Parser Error: " << msg << " at " << peek().text << " (line ~" << current << ")" << std::endl;
+        std::cerr << "Parser Error: " << msg << " at " << peek().text << " (" << where() << ")" << std::endl;
         exit(1);
     }
     
     void error(std::string message) {
-        Token t = peek();
-        std::cerr << "Parser Error: " << message << " at '" << t.text << "' (line ~" << current << ")" << std::endl;
+        const Token& t = peek();
+        std::cerr << "Parser Error: " << message << " at '" << t.text << "' (" << where() << ")" << std::endl;
         exit(1);
     }
+
+    std::string where() {
+        const Token& t = peek();
+        std::string at = "line " + std::to_string(t.line) + ", column " + std::to_string(t.column);
+        return path.empty() ? at : path + ", " + at;
+    }
 };
 
 #endif
@@ -2,70 +2,439 @@
 #define TRANSPILER_H
 
 #include "ast.h"
+#include <cerrno>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <set>
 #include <sstream>
 
 class Transpiler {
     std::stringstream ss;
     int indentLevel = 0;
+
+    // How returns of the function being emitted are lowered. A `return
+    // self(...)` becomes a jump back to `_tail`; a `return e op self(...)`
+    // parks `e` (in `_acc` for integer + and *, else on `_pending`) and jumps,
+    // and every other return then applies the parked operands.
+    struct TailPlan {
+        bool jumps = false;
+        BinaryExpr* pending = nullptr;
+        bool accumulate = false;
+    };
+    FunctionDecl* currentFn = nullptr;
+    TailPlan tail;
+    std::set<std::string_view> functionNames; // user functions of this translation unit
+    std::set<std::string_view> pureFunctions;
+    std::set<std::string_view> memoized;
+    std::set<FunctionDecl*> methods;  // of every class of this translation unit
+    std::set<FunctionDecl*> mutating; // methods that change their object
+    std::map<std::string_view, ClassDecl*> classDecls;
+    std::vector<std::string_view> stringPool; // literal texts, index = _strN
+    std::vector<std::string> profiled;        // --profile: function names, index = _profN
+    std::string file;               // `#line` path of the module being emitted
+    std::set<IndexExpr*> unchecked; // indexes proven in range by the enclosing loop
+    int loops = 0;                  // numbers the hidden variables of each loop
+    std::vector<const Type*> closures; // enclosing task (nullptr) and lambda (result type) bodies, innermost last
     
 public:
-    std::string mapType(std::string uaType) {
-        if (uaType == "Value") return "Value";
-        if (uaType == "число" || uaType == "int" || uaType == "number") return "double";
-        if (uaType == "стрічка" || uaType == "string") return "std::string";
-        if (uaType == "бул" || uaType == "bool") return "bool";
-        return "Value";
+    // --profile: every function and method body opens a ProfileScope
+    // (profile.h). Without it the emitted code has no trace of profiling.
+    bool profile = false;
+
+    // Emitted statements and functions are preceded by `#line N "file.uas"`,
+    // so compiler errors, gdb, perf and the sanitizers name the source line.
+    // Off (`--no-lines`) for reading the C++ itself.
+    bool lines = true;
+
+    std::string mapType(std::string_view uaType) {
+        return cppType(Type::fromName(uaType));
+    }
+
+    static std::string cppType(const Type* t) {
+        switch (t->kind) {
+            case TY_INT: return "int64_t";
+            case TY_NUMBER: return "double";
+            case TY_STRING: return "std::string";
+            case TY_BOOL: return "bool";
+            case TY_LIST: return "List<" + cppType(t->element) + ">";
+            case TY_MAP: return "Map<" + cppType(t->key) + ", " + cppType(t->element) + ">";
+            case TY_CHANNEL: return "Channel<" + cppType(t->element) + ">";
+            case TY_SIGNAL: return "Signal<" + cppType(t->element) + ">";
+            case TY_FUNCTION: return "auto";
+            case TY_CLASS: return t->spelling;
+            default: return "Value";
+        }
     }
 
     std::string transpile(Program* program) {
+        return transpile(std::vector<Program*>{program}, std::vector<std::string>{});
+    }
+
+    // One translation unit for a whole module graph. `modules` is in
+    // initialization order with the entry module last; `initNames` names
+    // the init function of every module but the entry.
+    std::string transpile(const std::vector<Program*>& modules, const std::vector<std::string>& initNames) {
+        begin(modules);
+        for (Program* m : modules) visitDeclarations(m);
+        ss << "\n";
+        for (Program* m : modules) visitDefinitions(m);
+        for (size_t i = 0; i + 1 < modules.size(); i++) visitInit(modules[i], initNames[i]);
+        visitMain(modules.back(), initNames);
+        return finish();
+    }
+
+    // Separate compilation of one module of a graph.
+    struct ModuleCode {
+        std::string header; // declarations of the module's functions and init
+        std::string source;
+    };
+
+    // `includes` are the headers of the modules this one imports. For the
+    // entry module `initNames` lists every other module's init in order
+    // and a main() is emitted; otherwise the top-level code becomes `initName`.
+    ModuleCode transpileModule(Program* program, const std::string& initName,
+                               const std::vector<std::string>& includes,
+                               const std::vector<std::string>& initNames, bool entry) {
+        ModuleCode code;
+        begin({program});
+        visitDeclarations(program);
+        code.header = "#pragma once\n#include \"runtime.h\"\n\n" + ss.str();
+        if (!entry) code.header += "void " + initName + "();\n";
+
         ss.str("");
-        ss << "#include \"runtime.h\"\n\n";
-        
-        // Forward decls
-        for (const auto& stmt : program->body) {
+        for (const auto& h : includes) ss << "#include \"" << h << "\"\n";
+        for (const auto& init : initNames) ss << "void " << init << "();\n";
+        ss << "\n";
+        visitDeclarations(program);
+        ss << "\n";
+        visitDefinitions(program);
+        if (entry) visitMain(program, initNames);
+        else visitInit(program, initName);
+        code.source = finish();
+        return code;
+    }
+    
+private:
+    void begin(const std::vector<Program*>& modules) {
+        ss.str("");
+        stringPool.clear();
+        profiled.clear();
+        unchecked.clear();
+        loops = 0;
+        functionNames.clear();
+        for (FunctionDecl* fn : functionsOf(modules)) functionNames.insert(fn->name);
+        findPureFunctions(modules);
+        findMemoized(modules);
+        methods.clear();
+        classDecls.clear();
+        for (ClassDecl* cls : classesOf(modules)) {
+            classDecls[cls->name] = cls;
+            for (FunctionDecl* m : cls->methods) methods.insert(m);
+        }
+        findMutating(modules);
+    }
+
+    void visitDeclarations(Program* program) {
+        visitClasses(program);
+        for (Statement* stmt : program->body) {
             if (stmt->type == FUNCTION_DECL) {
-                FunctionDecl* fn = (FunctionDecl*)stmt.get();
-                ss << mapType(fn->returnType) << " " << fn->name << "(";
-                for (size_t i = 0; i < fn->params.size(); i++) {
-                    if (i > 0) ss << ", ";
-                    ss << mapType(fn->params[i].typeName) << " " << fn->params[i].name;
+                FunctionDecl* fn = (FunctionDecl*)stmt;
+                if (memoizes(fn)) {
+                    signature(fn, "_memo_" + std::string(fn->name));
+                    ss << ";\n";
+                }
+                signature(fn, std::string(fn->name));
+                ss << ";\n";
+            }
+        }
+    }
+
+    void visitDefinitions(Program* program) {
+        file = program->path;
+        for (Statement* stmt : program->body) {
+            if (stmt->type == CLASS_DECL) visitClassDefinitions((ClassDecl*)stmt);
+        }
+        for (Statement* stmt : program->body) {
+            if (stmt->type == FUNCTION_DECL) visit(stmt);
+        }
+    }
+
+    // Each struct comes after the classes it holds, and a @soa class's
+    // List specialization before anything holds a list of it.
+    void visitClasses(Program* program) {
+        std::vector<ClassDecl*> classes = classesOf({program});
+        if (classes.empty()) return;
+        for (ClassDecl* cls : classes) ss << "struct " << cls->name << ";\n";
+        ss << "\n";
+        std::map<std::string_view, int> state; // 1 while its fields' classes are emitted, 2 once done
+        std::function<void(ClassDecl*)> emit = [&](ClassDecl* cls) {
+            if (state[cls->name] == 2) return;
+            if (state[cls->name] == 1) classError(std::string(cls->name) + " contains itself; a Список of it cannot be @soa, and a field only in a Список");
+            state[cls->name] = 1;
+            for (const ClassDecl::Field& f : cls->fields) {
+                for (ClassDecl* other : classes) {
+                    if (needsComplete(Type::fromName(f.typeName), other)) emit(other);
                 }
-                ss << ");\n";
             }
+            visitClass(cls);
+            state[cls->name] = 2;
+        };
+        for (ClassDecl* cls : classes) emit(cls);
+    }
+
+    // A field of type `t` holds a `cls`, or a list of a @soa `cls`.
+    static bool needsComplete(const Type* t, ClassDecl* cls) {
+        if (t->kind == TY_LIST && cls->columns()) t = t->element;
+        return t->kind == TY_CLASS && t->spelling == cls->name;
+    }
+
+    // A plain struct of typed fields. The constructors and methods are
+    // defined with the functions; a method that leaves its object alone is
+    // const.
+    void visitClass(ClassDecl* cls) {
+        ss << "struct " << cls->name << " {\n";
+        for (const ClassDecl::Field& f : cls->fields) {
+            const Type* t = Type::fromName(f.typeName);
+            if (t->kind == TY_FUNCTION || t->kind == TY_STREAM) {
+                classError(std::string(cls->name) + "'s field " + std::string(f.name) + " cannot hold a " + std::string(t->name()));
+            }
+            ss << "  " << cppType(t) << " " << f.name << ";\n";
         }
         ss << "\n";
-        
-        // Definitions
-        for (const auto& stmt : program->body) {
-             if (stmt->type == FUNCTION_DECL) {
-                 visit(stmt.get());
-             }
+        ss << "  " << cls->name << "();\n";
+        if (cls->parameters > 0) {
+            ss << "  " << cls->name << "(";
+            constructorParameters(cls);
+            ss << ");\n";
         }
-        
-        // Main
+        for (FunctionDecl* m : cls->methods) {
+            ss << "  ";
+            signature(m, std::string(m->name));
+            ss << (mutating.count(m) ? "" : " const") << ";\n";
+        }
+        if (cls->columns()) ss << "\n  struct Ref;\n  struct Columns;\n";
+        ss << "};\n\n";
+        if (cls->data) visitDataHelpers(cls);
+        visitText(cls);
+        if (cls->columns()) visitColumns(cls);
+    }
+
+    void constructorParameters(ClassDecl* cls) {
+        for (size_t i = 0; i < cls->parameters; i++) {
+            if (i > 0) ss << ", ";
+            ss << mapType(cls->fields[i].typeName) << " " << cls->fields[i].name;
+        }
+    }
+
+    // дані: equal when every field is, and hashed from every field, so
+    // objects work as map keys. Lists, maps and channels compare as handles.
+    void visitDataHelpers(ClassDecl* cls) {
+        std::string_view name = cls->name;
+        ss << "inline bool operator==(const " << name << "& a, const " << name << "& b) {\n";
+        ss << "  return ";
+        if (cls->fields.empty()) ss << "true";
+        for (size_t i = 0; i < cls->fields.size(); i++) {
+            std::string_view f = cls->fields[i].name;
+            const Type* t = Type::fromName(cls->fields[i].typeName);
+            if (i > 0) ss << " &&\n         ";
+            if (isHandle(t)) ss << "a." << f << ".rep == b." << f << ".rep";
+            else if (t->kind == TY_VALUE) ss << "isTruthy(a." << f << " == b." << f << ")";
+            else ss << "a." << f << " == b." << f;
+            auto inner = classDecls.find(t->spelling);
+            if (t->kind == TY_CLASS && inner != classDecls.end() && !inner->second->data) {
+                classError(std::string(name) + "'s field " + std::string(f) + " is a клас " + t->spelling + ", which cannot be compared; declare it дані");
+            }
+        }
+        ss << ";\n}\n\n";
+        ss << "inline uint64_t hashKey(const " << name << "& v) {\n";
+        ss << "  uint64_t h = " << cls->fields.size() << ";\n";
+        for (const ClassDecl::Field& f : cls->fields) {
+            if (isHandle(Type::fromName(f.typeName))) ss << "  h = mixHash(h ^ hashKey((int64_t)(intptr_t)v." << f.name << ".rep));\n";
+            else ss << "  h = mixHash(h ^ hashKey(v." << f.name << "));\n";
+        }
+        ss << "  return h;\n}\n\n";
+    }
+
+    static bool isHandle(const Type* t) {
+        return t->kind == TY_LIST || t->kind == TY_MAP || t->kind == TY_CHANNEL || t->kind == TY_SIGNAL;
+    }
+
+    // Objects print as `Точка(x: 1, y: 2)`.
+    void visitText(ClassDecl* cls) {
+        std::string_view name = cls->name;
+        ss << "inline std::string toString(const " << name << "& v) {\n";
+        ss << "  std::string out = \"" << name << "(\";\n";
+        for (size_t i = 0; i < cls->fields.size(); i++) {
+            const ClassDecl::Field& f = cls->fields[i];
+            TypeKind kind = Type::fromName(f.typeName)->kind;
+            ss << "  out += \"" << (i > 0 ? ", " : "") << f.name << ": \" + ";
+            if (kind == TY_CHANNEL) ss << "std::string(\"<channel>\")";
+            else if (kind == TY_SIGNAL) ss << "std::string(\"<signal>\")";
+            else ss << "toString(v." << f.name << ")";
+            ss << ";\n";
+        }
+        ss << "  return out + \")\";\n}\n\n";
+        ss << "inline void print(const " << name << "& v) { print(toString(v)); }\n\n";
+    }
+
+    // @soa: Columns holds an array per field and Ref is an element seen
+    // through references into them, with the class's methods, so `ps[і].x`
+    // and `ps[і].рух(dt)` touch only the arrays they use (see soa.h).
+    void visitColumns(ClassDecl* cls) {
+        std::string_view name = cls->name;
+        if (cls->fields.empty()) classError("@soa needs a class with fields, and " + std::string(name) + " has none");
+        ss << "struct " << name << "::Ref {\n";
+        for (const ClassDecl::Field& f : cls->fields) ss << "  " << mapType(f.typeName) << "& " << f.name << ";\n";
+        ss << "\n";
+        ss << "  operator " << name << "() const {\n";
+        ss << "    " << name << " _v;\n";
+        for (const ClassDecl::Field& f : cls->fields) ss << "    _v." << f.name << " = " << f.name << ";\n";
+        ss << "    return _v;\n";
+        ss << "  }\n";
+        ss << "  const Ref& operator=(const " << name << "& _v) const {\n";
+        for (const ClassDecl::Field& f : cls->fields) ss << "    " << f.name << " = _v." << f.name << ";\n";
+        ss << "    return *this;\n";
+        ss << "  }\n";
+        ss << "  const Ref& operator=(const Ref& _r) const { return *this = " << name << "(_r); }\n";
+        for (FunctionDecl* m : cls->methods) {
+            ss << "  ";
+            signature(m, std::string(m->name));
+            ss << " const;\n";
+        }
+        ss << "};\n\n";
+
+        // `_col_`, so no field's column is named like a parameter below.
+        ss << "struct " << name << "::Columns {\n";
+        for (const ClassDecl::Field& f : cls->fields) ss << "  SoaColumn<" << mapType(f.typeName) << "> _col_" << f.name << ";\n";
+        ss << "\n";
+        ss << "  size_t size() const { return _col_" << cls->fields[0].name << ".size(); }\n";
+        ss << "  void reserve(size_t n) {";
+        for (const ClassDecl::Field& f : cls->fields) ss << " _col_" << f.name << ".reserve(n);";
+        ss << " }\n";
+        ss << "  void push(const " << name << "& _v) {";
+        for (const ClassDecl::Field& f : cls->fields) ss << " _col_" << f.name << ".push_back(_v." << f.name << ");";
+        ss << " }\n";
+        ss << "  Ref at(size_t i) { return Ref{";
+        for (size_t i = 0; i < cls->fields.size(); i++) ss << (i > 0 ? ", _col_" : "_col_") << cls->fields[i].name << "[i]";
+        ss << "}; }\n";
+        ss << "};\n\n";
+
+        ss << "template <>\n";
+        ss << "struct List<" << name << "> : SoaList<" << name << "> {};\n\n";
+    }
+
+    // The constructors give every field its initializer, a constructor
+    // argument or zero, in declaration order.
+    void visitClassDefinitions(ClassDecl* cls) {
+        line(cls);
+        for (int withParameters = 0; withParameters < (cls->parameters > 0 ? 2 : 1); withParameters++) {
+            ss << cls->name << "::" << cls->name << "(";
+            if (withParameters) constructorParameters(cls);
+            ss << ")";
+            for (size_t i = 0; i < cls->fields.size(); i++) {
+                const ClassDecl::Field& f = cls->fields[i];
+                const Type* t = Type::fromName(f.typeName);
+                ss << (i == 0 ? " : " : ", ") << f.name << "(";
+                if (withParameters && i < cls->parameters) ss << "std::move(" << f.name << ")";
+                else if (f.initializer) visitAs(f.initializer, t);
+                else if (t->kind == TY_SIGNAL) ss << cppType(t->element) << "()";
+                ss << ")";
+            }
+            ss << " {}\n\n";
+        }
+        std::string name(cls->name);
+        for (FunctionDecl* m : cls->methods) {
+            visitBody(m, name + "::" + std::string(m->name), mutating.count(m) ? "" : " const", name + "." + std::string(m->name));
+        }
+        if (!cls->columns()) return;
+        for (FunctionDecl* m : cls->methods) {
+            visitBody(m, name + "::Ref::" + std::string(m->name), " const", name + "." + std::string(m->name));
+        }
+    }
+
+    [[noreturn]] static void classError(const std::string& message) {
+        std::cerr << "Error: " << message << std::endl;
+        exit(1);
+    }
+
+    void visitTopLevel(Program* program) {
+        file = program->path;
+        for (size_t i = 0; i < program->body.size(); i++) {
+            Statement* stmt = program->body[i];
+            if (stmt->type == WHILE_STMT) findCountedWhile(program->body, i);
+            if (stmt->type != FUNCTION_DECL && stmt->type != CLASS_DECL) visit(stmt);
+        }
+    }
+
+    // Top-level code of an imported module runs once, before its importer's.
+    void visitInit(Program* program, const std::string& initName) {
+        ss << "\nvoid " << initName << "() {\n";
+        indentLevel++;
+        visitTopLevel(program);
+        indentLevel--;
+        ss << "}\n";
+    }
+
+    void visitMain(Program* program, const std::vector<std::string>& initNames) {
         ss << "\nint main() {\n";
         indentLevel++;
-        
-        for (const auto& stmt : program->body) {
-            if (stmt->type != FUNCTION_DECL) {
-                visit(stmt.get());
-            }
+        for (const auto& init : initNames) {
+            indent(); ss << init << "();\n";
         }
-        
+        visitTopLevel(program);
+        indent(); ss << "waitForTasks();\n";
         indent(); ss << "return 0;\n";
         indentLevel--;
         ss << "}\n";
-        
-        return ss.str();
     }
-    
+
+    // String literals are interned once at startup; the pool is only
+    // known once everything has been emitted.
+    std::string finish() {
+        std::string code = "#include \"runtime.h\"\n";
+        if (profile) code += "#include \"profile.h\"\n";
+        code += "\n";
+        for (size_t i = 0; i < stringPool.size(); i++) {
+            code += "static const Value _str" + std::to_string(i) + " = intern(\"" + std::string(stringPool[i]) + "\");\n";
+        }
+        if (!stringPool.empty()) code += "\n";
+        for (size_t i = 0; i < profiled.size(); i++) {
+            code += "static const uint32_t _prof" + std::to_string(i) + " = profileFunction(\"" + profiled[i] + "\");\n";
+        }
+        if (!profiled.empty()) code += "\n";
+        return code + ss.str();
+    }
+
+    // Starts a line of the output. The directive holds until the next one,
+    // so C++ lines a statement spills over count on from its line; node
+    // placement is exact only at the start of each statement.
+    void line(Node* node) {
+        if (!lines || node->line == 0 || file.empty()) return;
+        ss << "#line " << node->line << " \"";
+        for (char c : file) {
+            if (c == '"' || c == '\\') ss << '\\';
+            ss << c;
+        }
+        ss << "\"\n";
+    }
+
+public:
     void visit(Node* node) {
+        // Statements other than blocks start a line; a block goes on the
+        // line of its `if (...)` or loop head.
+        if (node->type > BLOCK_STMT && node->type <= SPAWN_STMT) line(node);
         switch (node->type) {
             case FUNCTION_DECL: visitFunction((FunctionDecl*)node); break;
             case BLOCK_STMT: visitBlock((BlockStmt*)node); break;
             case IF_STMT: visitIf((IfStmt*)node); break;
             case SWITCH_STMT: visitSwitch((SwitchStmt*)node); break;
             case WHILE_STMT: visitWhile((WhileStmt*)node); break;
+            case FOR_STMT: visitFor((ForStmt*)node); break;
+            case SPAWN_STMT: visitSpawn((SpawnStmt*)node); break;
+            case INDEX_ASSIGN_STMT: visitIndexAssign((IndexAssignStmt*)node); break;
+            case FIELD_ASSIGN_STMT: visitFieldAssign((FieldAssignStmt*)node); break;
             case RETURN_STMT: visitReturn((ReturnStmt*)node); break;
             case LET_STMT: visitLet((LetStmt*)node); break;
             case ASSIGN_STMT: visitAssign((AssignStmt*)node); break;
@@ -74,45 +443,406 @@ public:
             case BINARY_EXPR: visitBinary((BinaryExpr*)node); break;
             case UNARY_EXPR: visitUnary((UnaryExpr*)node); break;
             case CALL_EXPR: visitCall((CallExpr*)node); break;
+            case LIST_EXPR: visitList((ListExpr*)node, ((ListExpr*)node)->staticType); break;
+            case MAP_EXPR: visitMap((MapExpr*)node, ((MapExpr*)node)->staticType); break;
+            case INDEX_EXPR: visitIndex((IndexExpr*)node); break;
+            case FIELD_EXPR: visitField((FieldExpr*)node); break;
+            case CHANNEL_EXPR: visitChannel((ChannelExpr*)node); break;
+            case LAMBDA_EXPR: visitLambda((LambdaExpr*)node); break;
             case LITERAL: visitLiteral((Literal*)node); break;
             case IDENTIFIER: visitIdentifier((Identifier*)node); break;
             default: break;
         }
     }
     
-    void visitFunction(FunctionDecl* fn) {
-        ss << mapType(fn->returnType) << " " << fn->name << "(";
+    // Values, strings, lists, maps and objects that the body never reassigns
+    // (or changes a field of) are taken by const reference; everything else
+    // (and numbers, which are cheaper by value) is copied. Tail-call
+    // lowering reassigns every parameter.
+    void signature(FunctionDecl* fn, const std::string& name) {
+        std::set<std::string_view> assigned;
+        bool tailJumps = planTailCalls(fn).jumps;
+        walk(fn->body, [&](Statement* s) {
+            if (s->type == ASSIGN_STMT) assigned.insert(((AssignStmt*)s)->name);
+            if (Identifier* id = changedObject(s)) assigned.insert(id->name);
+        }, [&](Expression* e) {
+            if (e->type == ASSIGN_EXPR) assigned.insert(((AssignExpr*)e)->name);
+            if (Identifier* id = changedObject(e)) assigned.insert(id->name);
+        });
+        ss << mapType(fn->returnType) << " " << name << "(";
         for (size_t i = 0; i < fn->params.size(); i++) {
             if (i > 0) ss << ", ";
-            ss << mapType(fn->params[i].typeName) << " " << fn->params[i].name;
+            std::string type = mapType(fn->params[i].typeName);
+            bool handle = type == "Value" || type == "std::string" || type.compare(0, 5, "List<") == 0 ||
+                          type.compare(0, 4, "Map<") == 0 || type.compare(0, 8, "Channel<") == 0 ||
+                          type.compare(0, 7, "Signal<") == 0 || Type::fromName(fn->params[i].typeName)->kind == TY_CLASS;
+            bool byRef = handle && !tailJumps && !assigned.count(fn->params[i].name);
+            ss << (byRef ? "const " + type + "&" : type) << " " << fn->params[i].name;
+        }
+        ss << ")";
+    }
+
+    // A specialization shows in a profile as `фібоначчі(ціле)`.
+    void visitFunction(FunctionDecl* fn) {
+        bool memo = memoizes(fn);
+        if (memo) visitMemoWrapper(fn);
+        std::string shown(fn->name);
+        if (fn->generic) {
+            shown = std::string(fn->generic->name) + "(";
+            for (size_t i = 0; i < fn->params.size(); i++) shown += (i > 0 ? ", " : "") + std::string(fn->params[i].typeName);
+            shown += ")";
+        }
+        visitBody(fn, memo ? "_memo_" + std::string(fn->name) : std::string(fn->name), "", shown);
+    }
+
+    // Also emits methods out of line, with their qualified `name`;
+    // `qualifier` is " const" for one that leaves its object alone. A body
+    // that falls off the end gives none, or zero for a typed result.
+    // `shown` is the name a profile reports it under; a cache hit of an
+    // @мемо function is not a call.
+    void visitBody(FunctionDecl* fn, const std::string& name, const char* qualifier, const std::string& shown) {
+        currentFn = fn;
+        tail = planTailCalls(fn);
+        line(fn);
+        signature(fn, name);
+        ss << qualifier << " ";
+        std::string scope;
+        if (profile) {
+            scope = "ProfileScope _profile(_prof" + std::to_string(profiled.size()) + ");\n";
+            profiled.push_back(shown);
+        }
+        if (!tail.jumps) {
+            visitFunctionBlock(fn->body, scope);
+        } else {
+            ss << "{\n";
+            indentLevel++;
+            if (profile) { indent(); ss << scope; }
+            if (tail.accumulate) {
+                indent(); ss << "int64_t _acc = " << (tail.pending->op == OP_MUL ? 1 : 0) << ";\n";
+            } else if (tail.pending) {
+                indent(); ss << "std::vector<" << mapType(tail.pending->left->staticType->name()) << "> _pending;\n";
+            }
+            indentLevel--;
+            indent(); ss << "_tail:\n";
+            indentLevel++;
+            indent(); visitFunctionBlock(fn->body, "");
+            indentLevel--;
+            ss << "}\n";
         }
-        ss << ") ";
-        visitBlock(fn->body.get());
         ss << "\n\n";
+        currentFn = nullptr;
+        tail = TailPlan();
+    }
+
+    // Results are cached per thread, keyed by the single numeric argument.
+    void visitMemoWrapper(FunctionDecl* fn) {
+        std::string ret = mapType(fn->returnType);
+        std::string arg = std::string(fn->params[0].name);
+        line(fn);
+        signature(fn, std::string(fn->name));
+        ss << " {\n";
+        ss << "  static thread_local std::unordered_map<" << mapType(fn->params[0].typeName) << ", " << ret << "> _memo;\n";
+        ss << "  auto _it = _memo.find(" << arg << ");\n";
+        ss << "  if (_it != _memo.end()) return _it->second;\n";
+        ss << "  " << ret << " _r = _memo_" << fn->name << "(" << arg << ");\n";
+        ss << "  _memo.emplace(" << arg << ", _r);\n";
+        ss << "  return _r;\n";
+        ss << "}\n\n";
+    }
+
+    bool memoizes(FunctionDecl* fn) { return memoized.count(fn->name) > 0; }
+
+    // `@мемо` is honoured only where caching cannot change behaviour: one
+    // numeric parameter, a native result and no side effects.
+    void findMemoized(const std::vector<Program*>& modules) {
+        memoized.clear();
+        for (FunctionDecl* fn : functionsOf(modules)) {
+            if (!fn->hasAttribute("мемо") && !fn->hasAttribute("memo")) continue;
+            bool ok = fn->params.size() == 1 &&
+                      Type::fromName(fn->params[0].typeName)->isNumeric() &&
+                      Type::fromName(fn->returnType)->kind != TY_VALUE &&
+                      pureFunctions.count(fn->name);
+            if (ok) memoized.insert(fn->name);
+            else std::cerr << "Warning: @мемо ignored on " << fn->name
+                           << ": needs one ціле/число parameter, a typed result and no side effects" << std::endl;
+        }
+    }
+
+    // A function is pure if it only calls pure user functions (builtins
+    // such as друк, and functions of separately compiled modules, count as
+    // effects) and neither spawns tasks nor makes channels. Functions
+    // cannot reach globals.
+    void findPureFunctions(const std::vector<Program*>& modules) {
+        std::vector<FunctionDecl*> fns = functionsOf(modules);
+        pureFunctions.clear();
+        for (FunctionDecl* fn : fns) pureFunctions.insert(fn->name);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (FunctionDecl* fn : fns) {
+                if (!pureFunctions.count(fn->name)) continue;
+                bool pure = true;
+                walk(fn->body, [&](Statement* s) {
+                    if (s->type == SPAWN_STMT) pure = false;
+                }, [&](Expression* e) {
+                    if (e->type == CHANNEL_EXPR) pure = false;
+                    if (e->type != CALL_EXPR) return;
+                    Expression* callee = ((CallExpr*)e)->callee;
+                    if (callee->type != IDENTIFIER || !pureFunctions.count(((Identifier*)callee)->name)) pure = false;
+                });
+                if (!pure) {
+                    pureFunctions.erase(fn->name);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Methods that change their object: they assign one of its fields, or
+    // call such a method on it or on one of its fields.
+    void findMutating(const std::vector<Program*>& modules) {
+        mutating.clear();
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (ClassDecl* cls : classesOf(modules)) {
+                for (FunctionDecl* m : cls->methods) {
+                    if (mutating.count(m)) continue;
+                    std::set<std::string_view> local;
+                    for (const auto& p : m->params) local.insert(p.name);
+                    walk(m->body, [&](Statement* s) {
+                        if (s->type == LET_STMT) local.insert(((LetStmt*)s)->name);
+                        if (s->type == FOR_STMT) local.insert(((ForStmt*)s)->var);
+                        if (s->type == SWITCH_STMT) {
+                            for (auto& c : ((SwitchStmt*)s)->cases) local.insert(c.patternName);
+                        }
+                    }, nullptr);
+                    auto field = [&](std::string_view name) { return cls->field(name) && !local.count(name); };
+                    bool writes = false;
+                    walk(m->body, [&](Statement* s) {
+                        if (s->type == ASSIGN_STMT && field(((AssignStmt*)s)->name)) writes = true;
+                        Identifier* id = changedObject(s);
+                        if (id && field(id->name)) writes = true;
+                    }, [&](Expression* e) {
+                        if (e->type == ASSIGN_EXPR && field(((AssignExpr*)e)->name)) writes = true;
+                        if (e->type == CALL_EXPR && !((CallExpr*)e)->receiver && mutating.count(((CallExpr*)e)->method)) writes = true;
+                        Identifier* id = changedObject(e);
+                        if (id && field(id->name)) writes = true;
+                    });
+                    if (writes) {
+                        mutating.insert(m);
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    static std::vector<ClassDecl*> classesOf(const std::vector<Program*>& modules) {
+        std::vector<ClassDecl*> classes;
+        for (Program* program : modules) {
+            for (Statement* stmt : program->body) {
+                if (stmt->type == CLASS_DECL) classes.push_back((ClassDecl*)stmt);
+            }
+        }
+        return classes;
+    }
+
+    static std::vector<FunctionDecl*> functionsOf(const std::vector<Program*>& modules) {
+        std::vector<FunctionDecl*> fns;
+        for (Program* program : modules) {
+            for (Statement* stmt : program->body) {
+                if (stmt->type == FUNCTION_DECL) fns.push_back((FunctionDecl*)stmt);
+            }
+        }
+        return fns;
+    }
+
+    TailPlan planTailCalls(FunctionDecl* fn) {
+        TailPlan plan;
+        // A return inside a task body ends the task, not the function.
+        std::set<Statement*> inTasks;
+        walk(fn->body, [&](Statement* s) {
+            if (s->type == SPAWN_STMT) walk(((SpawnStmt*)s)->body, [&](Statement* t) { inTasks.insert(t); }, nullptr);
+        }, nullptr);
+        walk(fn->body, [&](Statement* s) {
+            if (s->type != RETURN_STMT || !((ReturnStmt*)s)->value || inTasks.count(s)) return;
+            Expression* v = ((ReturnStmt*)s)->value;
+            if (isSelfCall(v, fn)) {
+                plan.jumps = true;
+            } else if (v->type == BINARY_EXPR && !plan.pending) {
+                BinaryExpr* b = (BinaryExpr*)v;
+                if (b->op <= OP_POW && isSelfCall(b->right, fn) && !callsSelf(b->left, fn)) {
+                    plan.pending = b;
+                    plan.jumps = true;
+                }
+            }
+        }, nullptr);
+        plan.accumulate = plan.pending &&
+            (plan.pending->op == OP_ADD || plan.pending->op == OP_MUL) &&
+            Type::fromName(fn->returnType)->kind == TY_INT &&
+            plan.pending->left->staticType->kind == TY_INT &&
+            plan.pending->staticType->kind == TY_INT;
+        return plan;
+    }
+
+    // Same operator and operand types as the chosen pending shape.
+    bool isPendingSite(Expression* v) {
+        if (!tail.pending || v->type != BINARY_EXPR) return false;
+        BinaryExpr* b = (BinaryExpr*)v;
+        return b->op == tail.pending->op && isSelfCall(b->right, currentFn) && !callsSelf(b->left, currentFn) &&
+               b->left->staticType == tail.pending->left->staticType &&
+               b->staticType == tail.pending->staticType;
+    }
+
+    // A method calls itself without a receiver, on its own object.
+    bool isSelfCall(Expression* e, FunctionDecl* fn) {
+        if (e->type != CALL_EXPR) return false;
+        CallExpr* call = (CallExpr*)e;
+        if (methods.count(fn)) return call->method == fn && !call->receiver;
+        return !call->method && !call->constructs && call->callee->type == IDENTIFIER &&
+               ((Identifier*)call->callee)->name == fn->name && call->args.size() == fn->params.size();
+    }
+
+    static bool hasCall(Expression* e) {
+        bool found = false;
+        walk(e, [&](Expression* x) { if (x->type == CALL_EXPR) found = true; });
+        return found;
+    }
+
+    bool callsSelf(Expression* e, FunctionDecl* fn) {
+        bool found = false;
+        walk(e, [&](Expression* x) {
+            if (x->type != CALL_EXPR) return;
+            CallExpr* call = (CallExpr*)x;
+            if (methods.count(fn) ? call->method == fn
+                                  : call->callee->type == IDENTIFIER && ((Identifier*)call->callee)->name == fn->name) found = true;
+        });
+        return found;
     }
 
     void visitBlock(BlockStmt* blk) {
         ss << "{\n";
         indentLevel++;
-        for (const auto& stmt : blk->statements) {
-            visit(stmt.get());
+        visitStatements(blk);
+        indentLevel--;
+        indent(); ss << "}\n";
+    }
+
+    // `prologue` is a statement to run first.
+    void visitFunctionBlock(BlockStmt* blk, const std::string& prologue) {
+        ss << "{\n";
+        indentLevel++;
+        if (!prologue.empty()) { indent(); ss << prologue; }
+        visitStatements(blk);
+        if (blk->statements.empty() || blk->statements[blk->statements.size() - 1]->type != RETURN_STMT) {
+            indent(); ss << "return {};\n";
         }
         indentLevel--;
         indent(); ss << "}\n";
     }
+
+    void visitStatements(BlockStmt* blk) {
+        for (size_t i = 0; i < blk->statements.size(); i++) {
+            if (blk->statements[i]->type == WHILE_STMT) findCountedWhile(blk->statements, i);
+            visit(blk->statements[i]);
+        }
+    }
+
+    // The body runs as a closure over copies of the variables it uses;
+    // lists, maps and channels are handles, so those copies share.
+    void visitSpawn(SpawnStmt* stmt) {
+        indent(); ss << "spawn([=]() mutable {\n";
+        indentLevel++;
+        closures.push_back(nullptr);
+        visitStatements(stmt->body);
+        closures.pop_back();
+        indentLevel--;
+        indent(); ss << "});\n";
+    }
+
+    // Captures by copy like a task body. A block body that falls off the
+    // end gives none, or zero for a typed result. A stream stage's function
+    // only runs inside the fused loop, so it captures by reference, and an
+    // unannotated parameter takes the stream's `element` type; strings and
+    // other handles are passed by reference unless the body reassigns them.
+    void visitLambda(LambdaExpr* lambda, const Type* element = nullptr) {
+        const Type* result = lambda->staticType->element;
+        std::set<std::string_view> written;
+        if (element && lambda->body) written = writtenNames(lambda->body);
+        else if (element) walk(lambda->result, [&](Expression* e) {
+            if (e->type == ASSIGN_EXPR) written.insert(((AssignExpr*)e)->name);
+            if (Identifier* id = changedObject(e)) written.insert(id->name);
+        });
+        ss << (element ? "[&](" : "[=](");
+        for (size_t i = 0; i < lambda->params.size(); i++) {
+            if (i > 0) ss << ", ";
+            const FunctionDecl::Param& p = lambda->params[i];
+            const Type* t = element && p.typeName == "Value" ? element : Type::fromName(p.typeName);
+            bool byReference = element && !t->isNumeric() && t->kind != TY_BOOL && !written.count(p.name);
+            ss << (byReference ? "const " : "") << cppType(t) << (byReference ? "& " : " ") << p.name;
+        }
+        ss << ") mutable -> " << cppType(result);
+        if (lambda->result && printCall(lambda->result)) {
+            ss << " { ";
+            visit(lambda->result);
+            ss << "; return {}; }";
+            return;
+        }
+        if (lambda->result) {
+            ss << " { return ";
+            visitAs(lambda->result, result);
+            ss << "; }";
+            return;
+        }
+        ss << " {\n";
+        indentLevel++;
+        closures.push_back(result);
+        visitStatements(lambda->body);
+        closures.pop_back();
+        bool returns = !lambda->body->statements.empty() &&
+                       lambda->body->statements[lambda->body->statements.size() - 1]->type == RETURN_STMT;
+        if (!returns) {
+            indent(); ss << "return {};\n";
+        }
+        indentLevel--;
+        indent(); ss << "}";
+    }
+
+    // `друк(x)` has no value, so a lambda made of one runs it for effect.
+    bool printCall(Expression* e) {
+        if (e->type != CALL_EXPR || ((CallExpr*)e)->builtin || ((CallExpr*)e)->callee->type != IDENTIFIER) return false;
+        std::string_view name = ((Identifier*)((CallExpr*)e)->callee)->name;
+        return (name == "друк" || name == "print") && !functionNames.count(name);
+    }
+
+    void visitChannel(ChannelExpr* expr) {
+        ss << cppType(expr->staticType) << "(";
+        if (expr->capacity) visitCount(expr->capacity);
+        ss << ")";
+    }
+
+    // An int64_t from an argument that should hold an integer.
+    void visitCount(Expression* e) {
+        switch (e->staticType->kind) {
+            case TY_INT: visit(e); break;
+            case TY_NUMBER: ss << "(int64_t)("; visit(e); ss << ")"; break;
+            default: ss << "element<int64_t>("; visitAs(e, Type::value()); ss << ")"; break;
+        }
+    }
     
     void visitIf(IfStmt* stmt) {
         indent(); ss << "if (isTruthy(";
-        visit(stmt->condition.get());
+        visit(stmt->condition);
         ss << ")) {\n";
         indentLevel++;
-        visit(stmt->thenBranch.get());
+        visit(stmt->thenBranch);
         indentLevel--;
         indent(); ss << "}";
         if (stmt->elseBranch) {
             ss << " else {\n";
             indentLevel++;
-            visit(stmt->elseBranch.get());
+            visit(stmt->elseBranch);
             indentLevel--;
             indent(); ss << "}";
         }
@@ -122,10 +852,86 @@ public:
     void visitSwitch(SwitchStmt* stmt) {
         indent(); ss << "{\n";
         indentLevel++;
-        indent(); ss << "Value _sw = "; visit(stmt->discriminant.get()); ss << ";\n";
-        
-        bool first = true;
+        const Type* t = stmt->discriminant->staticType;
+        std::string swType = t->kind == TY_INT ? "int64_t" : t->kind == TY_NUMBER ? "double" : "Value";
+        // Against interned literal arms, an interned discriminant compares by pointer.
+        bool stringArms = false;
         for (auto& c : stmt->cases) {
+            if (c.value && c.value->type == LITERAL && ((Literal*)c.value)->kind == LIT_STRING) stringArms = true;
+        }
+        indent(); ss << swType << " _sw = ";
+        if (stringArms && swType == "Value") {
+            ss << "canonical("; visit(stmt->discriminant); ss << ")";
+        } else {
+            visit(stmt->discriminant);
+        }
+        ss << ";\n";
+
+        // Leading guard-free integer arms become a native switch, which the
+        // C++ compiler turns into a jump table or binary search; anything
+        // after them stays an if-chain.
+        size_t native = 0;
+        if (t->kind == TY_INT || t->kind == TY_NUMBER || t->kind == TY_VALUE) {
+            while (native < stmt->cases.size() && isIntegerArm(stmt->cases[native])) native++;
+        }
+
+        if (native == 0) {
+            visitCaseChain(stmt, 0);
+        } else {
+            bool rest = native < stmt->cases.size();
+            if (t->kind == TY_INT) {
+                if (rest) { indent(); ss << "bool _hit = true;\n"; }
+                indent(); ss << "switch (_sw) {\n";
+            } else {
+                indent(); ss << "int64_t _key;\n";
+                if (rest) {
+                    indent(); ss << "bool _hit = switchKey(_sw, _key);\n";
+                    indent(); ss << "if (_hit) switch (_key) {\n";
+                } else {
+                    indent(); ss << "if (switchKey(_sw, _key)) switch (_key) {\n";
+                }
+            }
+            std::set<long long> seen;
+            for (size_t i = 0; i < native; i++) {
+                auto& c = stmt->cases[i];
+                long long key = strtoll(std::string(((Literal*)c.value)->value).c_str(), nullptr, 10);
+                if (!seen.insert(key).second) continue; // shadowed by an earlier arm
+                indent(); ss << "case " << key << "LL: {\n";
+                indentLevel++;
+                visit(c.body);
+                indent(); ss << "break;\n";
+                indentLevel--;
+                indent(); ss << "}\n";
+            }
+            if (rest) { indent(); ss << "default: _hit = false;\n"; }
+            indent(); ss << "}\n";
+            if (rest) {
+                indent(); ss << "if (!_hit) {\n";
+                indentLevel++;
+                visitCaseChain(stmt, native);
+                indentLevel--;
+                indent(); ss << "}\n";
+            }
+        }
+
+        indentLevel--;
+        indent(); ss << "}\n";
+    }
+
+    static bool isIntegerArm(const SwitchStmt::Case& c) {
+        if (!c.value || c.guard || c.value->type != LITERAL) return false;
+        Literal* lit = (Literal*)c.value;
+        if (lit->kind != LIT_INT) return false;
+        errno = 0;
+        strtoll(std::string(lit->value).c_str(), nullptr, 10);
+        return errno == 0;
+    }
+
+    // if / else if lowering, used for arms that are not integer literals.
+    void visitCaseChain(SwitchStmt* stmt, size_t from) {
+        bool first = true;
+        for (size_t i = from; i < stmt->cases.size(); i++) {
+            auto& c = stmt->cases[i];
             indent();
             if (!first) ss << "else ";
             
@@ -138,26 +944,23 @@ public:
                 bool needsAnd = false;
                 if (c.value) {
                     ss << "isTruthy(_sw == ";
-                    visit(c.value.get());
+                    Literal* lit = c.value->type == LITERAL ? (Literal*)c.value : nullptr;
+                    if (lit && lit->kind == LIT_STRING) ss << "_str" << internLiteral(lit->value); // interned handle
+                    else visit(c.value);
                     ss << ")";
                     needsAnd = true;
                 }
                 
-                if (!c.patternName.empty() && c.patternName != "_") {
-                    // Variable binding - in simple transpiler we just allow it if guard or body uses it
-                }
-                
                 if (c.guard) {
                     if (needsAnd) ss << " && ";
-                    // To support variable name in guard, we'd need a lambda or similar.
-                    // For now, let's assume the variable name is just used in the body.
-                    // If we want it in guard:
+                    // The binding has to be visible to the guard, so it is
+                    // evaluated inside a lambda that declares it.
                     ss << "isTruthy([&](){ ";
                     if (!c.patternName.empty() && c.patternName != "_") {
                         ss << "Value " << c.patternName << " = _sw; ";
                     }
                     ss << "return ";
-                    visit(c.guard.get());
+                    visit(c.guard);
                     ss << "; }())";
                 } else if (!needsAnd) {
                     ss << "true"; 
@@ -170,120 +973,958 @@ public:
             if (!c.patternName.empty() && c.patternName != "_") {
                 indent(); ss << "Value " << c.patternName << " = _sw;\n";
             }
-            visit(c.body.get());
+            visit(c.body);
             indentLevel--;
             indent(); ss << "}\n";
             
             first = false;
             if (isDefault) break; // nothing after default
         }
-        
-        indentLevel--;
-        indent(); ss << "}\n";
     }
     
     void visitWhile(WhileStmt* stmt) {
         indent(); ss << "while (isTruthy(";
-        visit(stmt->condition.get());
+        visit(stmt->condition);
         ss << ")) ";
-        visit(stmt->body.get());
+        visit(stmt->body);
+    }
+
+    // The list (or map) handle is evaluated once; the element (or key) is
+    // copied out, so the body may append to what it iterates. A Value is
+    // walked as a List<Value> of its elements or keys.
+    void visitFor(ForStmt* stmt) {
+        std::string n = std::to_string(loops++);
+        if (stmt->iterable && stmt->iterable->staticType->kind == TY_STREAM) {
+            indent(); ss << "{\n";
+            indentLevel++;
+            streamLoop(stmt->iterable, n, [&](const std::string& v, const Type* t) {
+                indent(); ss << cppType(t) << " " << stmt->var << " = " << v << ";\n";
+                indent(); visit(stmt->body);
+            });
+            indentLevel--;
+            indent(); ss << "}\n";
+            return;
+        }
+        if (stmt->iterable) {
+            const Type* t = stmt->iterable->staticType;
+            bool map = t->kind == TY_MAP;
+            indent(); ss << "{\n";
+            indentLevel++;
+            indent();
+            if (t->kind == TY_LIST || map) {
+                ss << cppType(t) << " _xs" << n << " = "; visit(stmt->iterable); ss << ";\n";
+            } else {
+                t = Type::list(Type::value());
+                ss << "List<Value> _xs" << n << " = iterationList("; visit(stmt->iterable); ss << ");\n";
+            }
+            indent(); ss << "for (int64_t _i" << n << " = 0; _i" << n << " < _xs" << n << ".size(); _i" << n << "++) {\n";
+            indentLevel++;
+            indent(); ss << cppType(map ? t->key : t->element) << " " << stmt->var << " = _xs" << n
+                         << (map ? ".keyAt(_i" : ".unchecked(_i") << n << ");\n";
+            indent(); visit(stmt->body);
+            indentLevel--;
+            indent(); ss << "}\n";
+            indentLevel--;
+            indent(); ss << "}\n";
+            return;
+        }
+
+        if (stmt->parallel) {
+            std::vector<Reduction> reductions;
+            std::string why = planParallel(stmt, reductions);
+            if (why.empty()) {
+                visitParallelFor(stmt, reductions, n);
+                return;
+            }
+            std::cerr << "Warning: паралельно ignored: " << why << "; the loop runs serially" << std::endl;
+        }
+
+        TypeKind from = stmt->from->staticType->kind;
+        TypeKind to = stmt->to->staticType->kind;
+        std::string type = from == TY_INT && to == TY_INT ? "int64_t"
+                         : stmt->from->staticType->isNumeric() && stmt->to->staticType->isNumeric() ? "double" : "Value";
+        if (type == "int64_t") markCountedFor(stmt);
+        std::string end = "_end" + n;
+        indent(); ss << "for (" << type << " " << stmt->var << " = "; visit(stmt->from);
+        ss << ", " << end << " = "; visit(stmt->to); ss << "; ";
+        if (type == "Value") ss << "isTruthy(" << stmt->var << " < " << end << "); " << stmt->var << " = " << stmt->var << " + 1) ";
+        else ss << stmt->var << " < " << end << "; " << stmt->var << "++) ";
+        visit(stmt->body);
+    }
+
+    // A pipeline ending in зібрати, сума, кількість or кожен: one loop in
+    // an immediately invoked lambda, which gives the result.
+    void visitStream(CallExpr* sink) {
+        std::string_view op = sink->builtin;
+        size_t arity = op == "streamEach" ? 2 : 1;
+        if (sink->args.size() != arity) streamError(std::string(op == "streamEach" ? "кожен takes a stream and a function" : "a stream sink takes only the stream"));
+        const Type* t = sink->args[0]->staticType;
+        if (op == "streamSum" && t->kind == TY_LIST && t->element->isNumeric()) {
+            // A whole numeric list: the vector kernel, no loop of our own.
+            ss << "listSum(";
+            visitAs(sink->args[0], t);
+            ss << ")";
+            return;
+        }
+        std::string n = std::to_string(loops++);
+        const Type* element = sink->args[0]->staticType->streamed();
+        ss << "[&]() {\n";
+        indentLevel++;
+        std::string result;
+        if (op == "streamCollect") {
+            result = "_out" + n;
+            indent(); ss << cppType(sink->staticType) << " " << result << ";\n";
+        } else if (op == "streamSum") {
+            result = "_sum" + n;
+            indent(); ss << cppType(sink->staticType) << " " << result << " = " << (sink->staticType->kind == TY_VALUE ? "Value(0.0)" : "0") << ";\n";
+        } else if (op == "streamCount") {
+            result = "_count" + n;
+            indent(); ss << "int64_t " << result << " = 0;\n";
+        } else {
+            result = "NONE_VAL";
+            indent(); ss << "auto _each" << n << " = "; stageFunction(sink->args[1], element); ss << ";\n";
+        }
+        streamLoop(sink->args[0], n, [&](const std::string& v, const Type*) {
+            indent();
+            if (op == "streamCollect") ss << result << ".push(" << v << ");\n";
+            else if (op == "streamSum") ss << result << " = " << result << " + " << v << ";\n";
+            else if (op == "streamCount") ss << result << "++;\n";
+            else ss << "_each" << n << "(" << v << ");\n";
+        });
+        indent(); ss << "return " << result << ";\n";
+        indentLevel--;
+        indent(); ss << "}()";
+    }
+
+    // Emits the source's loop with every stage inlined into its body, so no
+    // stage builds an intermediate list; `sink` emits what happens to each
+    // element that gets through, given its C++ expression and type. Stage
+    // functions are C++ lambdas declared once before the loop, which the
+    // C++ compiler inlines into it.
+    void streamLoop(Expression* stream, const std::string& n, const std::function<void(const std::string&, const Type*)>& sink) {
+        std::vector<CallExpr*> stages;
+        Expression* source = stream;
+        while (source->type == CALL_EXPR && ((CallExpr*)source)->builtin && isStage(((CallExpr*)source)->builtin)) {
+            CallExpr* stage = (CallExpr*)source;
+            if (stage->args.size() != 2) streamError("фільтр, відобразити and взяти take a stream and one argument");
+            stages.insert(stages.begin(), stage);
+            source = stage->args[0];
+        }
+
+        std::vector<std::string> takes;
+        for (size_t k = 0; k < stages.size(); k++) {
+            std::string op = stages[k]->builtin;
+            std::string id = n + "_" + std::to_string(k);
+            indent();
+            if (op == "streamTake") {
+                takes.push_back(id);
+                ss << "int64_t _taken" << id << " = 0, _limit" << id << " = "; visitCount(stages[k]->args[1]); ss << ";\n";
+            } else {
+                ss << "auto _f" << id << " = "; stageFunction(stages[k]->args[1], stages[k]->args[0]->staticType->streamed()); ss << ";\n";
+            }
+        }
+
+        const Type* t = source->staticType->streamed();
+        std::string v = "_v" + n;
+        CallExpr* call = source->type == CALL_EXPR ? (CallExpr*)source : nullptr;
+        std::string_view from = call && call->builtin ? call->builtin : "";
+        if (source->staticType->kind == TY_LIST || (from == "streamOf" && call->args.size() == 1 && call->args[0]->staticType->kind == TY_LIST)) {
+            // Like `для x в xs`: the handle is read once and lists never shrink.
+            Expression* list = source->staticType->kind == TY_LIST ? source : call->args[0];
+            std::string xs = "_xs" + n, i = "_i" + n;
+            indent(); ss << cppType(list->staticType) << " " << xs << " = "; visit(list); ss << ";\n";
+            indent(); ss << "for (int64_t " << i << " = 0; " << i << " < " << xs << ".size(); " << i << "++) {\n";
+            indentLevel++;
+            indent(); ss << "const " << cppType(t) << "& " << v << " = " << xs << ".unchecked(" << i << ")"
+                         << (list->staticType->element->kind == TY_SIGNAL ? ".get()" : "") << ";\n";
+        } else if (from == "streamOf") {
+            indent(); ss << "for (const " << cppType(t) << "& " << v << " : std::initializer_list<" << cppType(t) << ">{";
+            for (size_t i = 0; i < call->args.size(); i++) {
+                if (i > 0) ss << ", ";
+                visitAs(call->args[i], t);
+            }
+            ss << "}) {\n";
+            indentLevel++;
+        } else if (from == "streamRange" && call->args.size() == 2) {
+            indent(); ss << "for (" << cppType(t) << " " << v << " = "; visit(call->args[0]);
+            ss << ", _end" << n << " = "; visit(call->args[1]);
+            ss << "; " << v << " < _end" << n << "; " << v << "++) {\n";
+            indentLevel++;
+        } else if (from == "streamLines" && call->args.size() <= 1) {
+            indent(); ss << "LineReader _lines" << n;
+            if (call->args.size() == 1) {
+                ss << "(";
+                visit(call->args[0]);
+                ss << ")";
+            }
+            ss << ";\n";
+            indent(); ss << "for (std::string " << v << "; _lines" << n << ".next(" << v << ");) {\n";
+            indentLevel++;
+        } else {
+            streamError("a stream must start at потік, діапазон, рядки or a list");
+        }
+
+        for (size_t k = 0; k < stages.size(); k++) {
+            std::string op = stages[k]->builtin;
+            std::string id = n + "_" + std::to_string(k);
+            indent();
+            if (op == "streamFilter") {
+                ss << "if (!isTruthy(_f" << id << "(" << v << "))) continue;\n";
+            } else if (op == "streamMap") {
+                t = stages[k]->staticType->element;
+                ss << cppType(t) << " _v" << id << " = _f" << id << "(" << v << ");\n";
+                v = "_v" + id;
+            } else {
+                ss << "if (_taken" << id << " == _limit" << id << ") break;\n";
+                indent(); ss << "_taken" << id << "++;\n";
+            }
+        }
+        sink(v, t);
+        // Stop as soon as a взяти is satisfied rather than at the next element,
+        // which for рядки() would wait for another line.
+        for (const std::string& id : takes) {
+            indent(); ss << "if (_taken" << id << " == _limit" << id << ") break;\n";
+        }
+        indentLevel--;
+        indent(); ss << "}\n";
+    }
+
+    static bool isStage(std::string_view builtin) {
+        return builtin == "streamFilter" || builtin == "streamMap" || builtin == "streamTake";
+    }
+
+    static bool isSink(std::string_view builtin) {
+        return builtin == "streamCollect" || builtin == "streamSum" || builtin == "streamCount" || builtin == "streamEach";
+    }
+
+    // A stage's function: a lambda written in place, or a function or a
+    // lambda variable called by name.
+    void stageFunction(Expression* f, const Type* element) {
+        if (f->type == LAMBDA_EXPR) visitLambda((LambdaExpr*)f, element);
+        else visit(f);
+    }
+
+    [[noreturn]] static void streamError(const std::string& message) {
+        std::cerr << "Error: " << message << std::endl;
+        exit(1);
+    }
+
+    // `для і від 0 до довжина(xs)`: і stays in [0, length) as long as the
+    // body reassigns neither і nor xs (lists never shrink).
+    // `x = x + e`, `x = x * e`, `x = мін(x, e)` or `x = макс(x, e)`, where
+    // x is a ціле or число from outside the loop and e does not mention x.
+    struct Reduction {
+        std::string_view name;
+        std::string op; // "+", "*", "minimum" or "maximum"
+        const Type* type;
+    };
+
+    // Why a `паралельно для` has to run serially, or "" with its
+    // reductions filled in. Besides its reductions, the body may only
+    // write its own variables and elements of lists that already exist.
+    std::string planParallel(ForStmt* stmt, std::vector<Reduction>& reductions) {
+        if (stmt->from->staticType->kind != TY_INT || stmt->to->staticType->kind != TY_INT) return "the range is not ціле";
+        std::set<std::string_view> local = {stmt->var};
+        walk(stmt->body, [&](Statement* s) {
+            if (s->type == LET_STMT) local.insert(((LetStmt*)s)->name);
+            if (s->type == FOR_STMT) local.insert(((ForStmt*)s)->var);
+            if (s->type == SWITCH_STMT) {
+                for (auto& c : ((SwitchStmt*)s)->cases) local.insert(c.patternName);
+            }
+        }, nullptr);
+        auto shared = [&](Expression* e) { return e->type != IDENTIFIER || !local.count(((Identifier*)e)->name); };
+
+        std::string why;
+        std::map<std::string_view, size_t> sites;
+        walk(stmt->body, [&](Statement* s) {
+            if (!why.empty()) return;
+            if (s->type == RETURN_STMT) {
+                why = "its body returns";
+            } else if (s->type == ASSIGN_STMT && !local.count(((AssignStmt*)s)->name)) {
+                std::string_view name = ((AssignStmt*)s)->name;
+                Reduction r;
+                if (!reductionOf((AssignStmt*)s, r)) {
+                    why = "it assigns " + std::string(name) + ", which is not a reduction";
+                    return;
+                }
+                for (const Reduction& seen : reductions) {
+                    if (seen.name == name && seen.op != r.op) why = std::string(name) + " is reduced two different ways";
+                }
+                if (!sites[name]++) reductions.push_back(r);
+            } else if (s->type == INDEX_ASSIGN_STMT) {
+                Expression* target = ((IndexAssignStmt*)s)->target->target;
+                if (target->staticType->kind != TY_LIST && shared(target)) why = "it stores into a shared map";
+            } else if (Identifier* id = changedObject(s)) {
+                if (shared(id)) why = "it changes a field of " + std::string(id->name);
+            }
+        }, [&](Expression* e) {
+            if (!why.empty()) return;
+            if (e->type == ASSIGN_EXPR && !local.count(((AssignExpr*)e)->name)) {
+                why = "it assigns " + std::string(((AssignExpr*)e)->name) + " inside an expression";
+            }
+            if (Identifier* id = changedObject(e)) {
+                if (shared(id)) why = "it changes " + std::string(id->name) + " in place";
+            }
+            if (e->type == CALL_EXPR && !((CallExpr*)e)->receiver && mutating.count(((CallExpr*)e)->method)) {
+                why = "it calls " + std::string(((CallExpr*)e)->method->name) + ", which changes the object";
+            }
+            if (e->type == CALL_EXPR && ((CallExpr*)e)->builtin) {
+                std::string_view name = ((CallExpr*)e)->builtin;
+                CallExpr* call = (CallExpr*)e;
+                if ((name == "push" || name == "removeKey") && !call->args.empty() && shared(call->args[0])) {
+                    why = "it resizes a shared list or map";
+                }
+            }
+        });
+        if (!why.empty()) return why;
+        // A reduction variable is only ever read by its own updates.
+        for (const Reduction& r : reductions) {
+            size_t uses = 0;
+            walk(stmt->body, nullptr, [&](Expression* e) {
+                if (e->type == IDENTIFIER && ((Identifier*)e)->name == r.name) uses++;
+            });
+            if (uses != sites[r.name]) return "it reads " + std::string(r.name) + ", which it also reduces";
+        }
+        return "";
+    }
+
+    static bool reductionOf(AssignStmt* s, Reduction& r) {
+        Expression* v = s->value;
+        Expression* self = nullptr;
+        Expression* operand = nullptr;
+        if (v->type == BINARY_EXPR && (((BinaryExpr*)v)->op == OP_ADD || ((BinaryExpr*)v)->op == OP_MUL)) {
+            r.op = opText(((BinaryExpr*)v)->op);
+            self = ((BinaryExpr*)v)->left;
+            operand = ((BinaryExpr*)v)->right;
+        } else if (v->type == CALL_EXPR && ((CallExpr*)v)->builtin && ((CallExpr*)v)->args.size() == 2) {
+            r.op = ((CallExpr*)v)->builtin;
+            if (r.op != "minimum" && r.op != "maximum") return false;
+            self = ((CallExpr*)v)->args[0];
+            operand = ((CallExpr*)v)->args[1];
+        } else {
+            return false;
+        }
+        if (self->type != IDENTIFIER || ((Identifier*)self)->name != s->name || mentions(operand, s->name)) return false;
+        r.name = s->name;
+        r.type = self->staticType;
+        return (r.type->kind == TY_INT || r.type->kind == TY_NUMBER) && v->staticType == r.type;
+    }
+
+    static bool mentions(Expression* e, std::string_view name) {
+        bool found = false;
+        walk(e, [&](Expression* x) {
+            if (x->type == IDENTIFIER && ((Identifier*)x)->name == name) found = true;
+            if (x->type == ASSIGN_EXPR && ((AssignExpr*)x)->name == name) found = true;
+        });
+        return found;
+    }
+
+    // Each slice of the range reduces into its own copy of every reduction
+    // variable, starting from the identity; the partial results are then
+    // folded in slice order, so the outcome does not depend on scheduling.
+    void visitParallelFor(ForStmt* stmt, const std::vector<Reduction>& reductions, const std::string& n) {
+        markCountedFor(stmt);
+        indent(); ss << "{\n";
+        indentLevel++;
+        indent(); ss << "int64_t _from" << n << " = "; visit(stmt->from);
+        ss << ", _to" << n << " = "; visit(stmt->to); ss << ";\n";
+        indent(); ss << "int64_t _chunks" << n << " = parallelChunks(_from" << n << ", _to" << n << ");\n";
+        for (size_t i = 0; i < reductions.size(); i++) {
+            indent(); ss << "std::vector<" << cppType(reductions[i].type) << "> _part" << n << "_" << i
+                         << "(_chunks" << n << ");\n";
+        }
+        indent(); ss << "parallelFor(_from" << n << ", _to" << n << ", _chunks" << n << ", [&](int64_t";
+        if (!reductions.empty()) ss << " _chunk" << n; // otherwise unused
+        ss << ", int64_t _lo" << n << ", int64_t _hi" << n << ") {\n";
+        indentLevel++;
+        for (const Reduction& r : reductions) {
+            indent(); ss << cppType(r.type) << " " << r.name << " = " << identity(r) << ";\n";
+        }
+        indent(); ss << "for (int64_t " << stmt->var << " = _lo" << n << "; " << stmt->var << " < _hi" << n << "; "
+                     << stmt->var << "++) ";
+        visit(stmt->body);
+        for (size_t i = 0; i < reductions.size(); i++) {
+            indent(); ss << "_part" << n << "_" << i << "[_chunk" << n << "] = " << reductions[i].name << ";\n";
+        }
+        indentLevel--;
+        indent(); ss << "});\n";
+        for (size_t i = 0; i < reductions.size(); i++) {
+            const Reduction& r = reductions[i];
+            std::string part = "_part" + n + "_" + std::to_string(i) + "[_c" + n + "]";
+            indent(); ss << "for (int64_t _c" << n << " = 0; _c" << n << " < _chunks" << n << "; _c" << n << "++) "
+                         << r.name << " = ";
+            if (r.op == "+" || r.op == "*") ss << r.name << " " << r.op << " " << part << ";\n";
+            else ss << r.op << "(" << r.name << ", " << part << ");\n";
+        }
+        indentLevel--;
+        indent(); ss << "}\n";
+    }
+
+    static const char* identity(const Reduction& r) {
+        bool integer = r.type->kind == TY_INT;
+        if (r.op == "+") return integer ? "0" : "0.0";
+        if (r.op == "*") return integer ? "1" : "1.0";
+        if (r.op == "minimum") return integer ? "INT64_MAX" : "INFINITY";
+        return integer ? "INT64_MIN" : "-INFINITY";
+    }
+
+    void markCountedFor(ForStmt* stmt) {
+        if (stmt->from->type != LITERAL || ((Literal*)stmt->from)->kind != LIT_INT) return;
+        if (((Literal*)stmt->from)->value[0] == '-') return;
+        Identifier* list = lengthOf(stmt->to);
+        if (!list) return;
+        std::set<std::string_view> written = writtenNames(stmt->body);
+        if (written.count(stmt->var) || written.count(list->name)) return;
+        markUnchecked(stmt->body, list->name, stmt->var);
+    }
+
+    // The same for a counted `поки`:
+    //     нехай і = 0          (a non-negative integer literal)
+    //     поки і < довжина(xs) { ...; і = і + 1 }
+    // where nothing between the let and the loop writes і, and only the
+    // final increment in the body writes і or xs.
+    void findCountedWhile(const List<Statement*>& statements, size_t at) {
+        WhileStmt* loop = (WhileStmt*)statements[at];
+        if (loop->condition->type != BINARY_EXPR || loop->body->type != BLOCK_STMT) return;
+        BinaryExpr* cond = (BinaryExpr*)loop->condition;
+        if (cond->op != OP_LT || cond->left->type != IDENTIFIER || cond->left->staticType->kind != TY_INT) return;
+        std::string_view index = ((Identifier*)cond->left)->name;
+        Identifier* list = lengthOf(cond->right);
+        if (!list) return;
+
+        BlockStmt* body = (BlockStmt*)loop->body;
+        if (body->statements.empty() || !isIncrement(body->statements[body->statements.size() - 1], index)) return;
+        for (size_t i = 0; i + 1 < body->statements.size(); i++) {
+            std::set<std::string_view> written = writtenNames(body->statements[i]);
+            if (written.count(index) || written.count(list->name)) return;
+        }
+
+        for (size_t i = at; i-- > 0;) {
+            Statement* s = statements[i];
+            if (s->type == LET_STMT && ((LetStmt*)s)->name == index) {
+                Expression* init = ((LetStmt*)s)->initializer;
+                if (init->type != LITERAL || ((Literal*)init)->kind != LIT_INT || ((Literal*)init)->value[0] == '-') return;
+                markUnchecked(body, list->name, index);
+                return;
+            }
+            if (writtenNames(s).count(index)) return;
+        }
+    }
+
+    // `довжина(xs)` on a typed list `xs`.
+    static Identifier* lengthOf(Expression* e) {
+        if (e->type != CALL_EXPR) return nullptr;
+        CallExpr* call = (CallExpr*)e;
+        if (!call->builtin || std::string_view(call->builtin) != "length" || call->args.size() != 1) return nullptr;
+        Expression* arg = call->args[0];
+        if (arg->type != IDENTIFIER || arg->staticType->kind != TY_LIST) return nullptr;
+        return (Identifier*)arg;
+    }
+
+    // `і = і + <non-negative integer literal>`
+    static bool isIncrement(Statement* s, std::string_view index) {
+        if (s->type != ASSIGN_STMT || ((AssignStmt*)s)->name != index) return false;
+        Expression* v = ((AssignStmt*)s)->value;
+        if (v->type != BINARY_EXPR || ((BinaryExpr*)v)->op != OP_ADD) return false;
+        BinaryExpr* add = (BinaryExpr*)v;
+        return add->left->type == IDENTIFIER && ((Identifier*)add->left)->name == index &&
+               add->right->type == LITERAL && ((Literal*)add->right)->kind == LIT_INT &&
+               ((Literal*)add->right)->value[0] != '-';
+    }
+
+    // Names a statement assigns, changes a field of or declares anew
+    // (which would shadow them).
+    std::set<std::string_view> writtenNames(Statement* stmt) {
+        std::set<std::string_view> names;
+        walk(stmt, [&](Statement* s) {
+            if (s->type == ASSIGN_STMT) names.insert(((AssignStmt*)s)->name);
+            if (Identifier* id = changedObject(s)) names.insert(id->name);
+            if (s->type == LET_STMT) names.insert(((LetStmt*)s)->name);
+            if (s->type == FOR_STMT) names.insert(((ForStmt*)s)->var);
+            if (s->type == SWITCH_STMT) {
+                for (auto& c : ((SwitchStmt*)s)->cases) names.insert(c.patternName);
+            }
+        }, [&](Expression* e) {
+            if (e->type == ASSIGN_EXPR) names.insert(((AssignExpr*)e)->name);
+            if (Identifier* id = changedObject(e)) names.insert(id->name);
+        });
+        return names;
+    }
+
+    // The variable whose object `p.x = v` or a call of a method that
+    // changes its object, `p.рух()`, changes in place. Elements of lists
+    // and maps are reached through a handle, so no variable changes.
+    Identifier* changedObject(Statement* s) {
+        return s->type == FIELD_ASSIGN_STMT ? rootOf(((FieldAssignStmt*)s)->target->object) : nullptr;
+    }
+
+    Identifier* changedObject(Expression* e) {
+        if (e->type != CALL_EXPR) return nullptr;
+        CallExpr* call = (CallExpr*)e;
+        return call->receiver && call->method && mutating.count(call->method) ? rootOf(call->args[0]) : nullptr;
+    }
+
+    // `p` of `p`, `p.a` or `p.a.b`.
+    static Identifier* rootOf(Expression* e) {
+        while (e->type == FIELD_EXPR) e = ((FieldExpr*)e)->object;
+        return e->type == IDENTIFIER ? (Identifier*)e : nullptr;
+    }
+
+    void markUnchecked(Statement* body, std::string_view list, std::string_view index) {
+        walk(body, nullptr, [&](Expression* e) {
+            if (e->type != INDEX_EXPR) return;
+            IndexExpr* x = (IndexExpr*)e;
+            if (x->target->type == IDENTIFIER && ((Identifier*)x->target)->name == list &&
+                x->index->type == IDENTIFIER && ((Identifier*)x->index)->name == index) unchecked.insert(x);
+        });
+    }
+
+    // A map gains the key; a list element must already exist.
+    void visitIndexAssign(IndexAssignStmt* stmt) {
+        IndexExpr* target = stmt->target;
+        TypeKind kind = target->target->staticType->kind;
+        indent();
+        if (kind == TY_MAP) {
+            visit(target->target); ss << ".slot("; visitKey(target->index); ss << ")";
+        } else if (kind == TY_LIST) {
+            visitElement(target);
+        } else {
+            ss << "storeAt("; visit(target->target); ss << ", "; visitKey(target->index); ss << ")";
+        }
+        if (target->readsSignal) {
+            ss << ".set(";
+            visitAs(stmt->value, target->staticType);
+            ss << ");\n";
+            return;
+        }
+        ss << " = ";
+        visitAs(stmt->value, target->staticType);
+        ss << ";\n";
+    }
+
+    void visitIndex(IndexExpr* expr) {
+        visitElement(expr);
+        if (expr->readsSignal) ss << ".get()";
+    }
+
+    void visitElement(IndexExpr* expr) {
+        TypeKind kind = expr->target->staticType->kind;
+        if (kind == TY_MAP) {
+            visit(expr->target); ss << ".at("; visitKey(expr->index); ss << ")";
+            return;
+        }
+        if (kind != TY_LIST) {
+            ss << "elementAt("; visit(expr->target); ss << ", "; visitKey(expr->index); ss << ")";
+            return;
+        }
+        visit(expr->target);
+        if (unchecked.count(expr)) {
+            ss << ".unchecked("; visit(expr->index); ss << ")";
+        } else {
+            ss << "["; visit(expr->index); ss << "]";
+        }
+    }
+
+    // A string literal key is passed as its interned handle, whose hash
+    // was computed once at startup.
+    void visitKey(Expression* key) {
+        if (key->type == LITERAL && ((Literal*)key)->kind == LIT_STRING) visitAs(key, Type::value());
+        else visit(key);
+    }
+
+    // A list or map literal is built directly as the type it is stored as,
+    // so `нехай xs: Список<число> = [1, 2]` needs no conversion.
+    void visitAs(Expression* expr, const Type* target) {
+        if (expr->type == LIST_EXPR) {
+            visitList((ListExpr*)expr, target);
+        } else if (expr->type == MAP_EXPR) {
+            visitMap((MapExpr*)expr, target);
+        } else if (target->kind == TY_VALUE && expr->type == LITERAL && ((Literal*)expr)->kind == LIT_STRING) {
+            ss << "_str" << internLiteral(((Literal*)expr)->value);
+        } else {
+            visit(expr);
+        }
+    }
+
+    void visitList(ListExpr* list, const Type* target) {
+        const Type* element = target->kind == TY_LIST ? target->element : Type::value();
+        ss << "List<" << cppType(element) << ">::of(";
+        for (size_t i = 0; i < list->items.size(); i++) {
+            if (i > 0) ss << ", ";
+            visitAs(list->items[i], element);
+        }
+        ss << ")";
+    }
+
+    void visitMap(MapExpr* map, const Type* target) {
+        const Type* key = target->kind == TY_MAP ? target->key : Type::value();
+        const Type* value = target->kind == TY_MAP ? target->element : Type::value();
+        ss << "Map<" << cppType(key) << ", " << cppType(value) << ">::of(";
+        for (size_t i = 0; i < map->keys.size(); i++) {
+            if (i > 0) ss << ", ";
+            visitKey(map->keys[i]);
+            ss << ", ";
+            visitAs(map->values[i], value);
+        }
+        ss << ")";
     }
     
     void visitReturn(ReturnStmt* stmt) {
+        if (!closures.empty() && closures.back()) {
+            indent(); ss << "return ";
+            visitAs(stmt->value, closures.back());
+            ss << ";\n";
+            return;
+        }
+        if (!closures.empty()) {
+            if (stmt->value && hasCall(stmt->value)) {
+                indent(); ss << "(void)("; visit(stmt->value); ss << ");\n";
+            }
+            indent(); ss << "return;\n";
+            return;
+        }
+        if (tail.jumps && stmt->value) {
+            if (isSelfCall(stmt->value, currentFn)) {
+                visitTailJump((CallExpr*)stmt->value, nullptr);
+                return;
+            }
+            if (isPendingSite(stmt->value)) {
+                BinaryExpr* b = (BinaryExpr*)stmt->value;
+                visitTailJump((CallExpr*)b->right, b->left);
+                return;
+            }
+        }
+        if (tail.accumulate && stmt->value) {
+            indent(); ss << "return _acc " << opText(tail.pending->op) << " ";
+            visit(stmt->value);
+            ss << ";\n";
+            return;
+        }
+        if (tail.pending && stmt->value) {
+            // Apply the parked left operands innermost-first, as the
+            // recursive calls would have.
+            Identifier parked("_pending.back()");
+            parked.staticType = tail.pending->left->staticType;
+            Identifier result("_r");
+            result.staticType = tail.pending->right->staticType;
+            BinaryExpr combine(tail.pending->op, &parked, &result);
+            combine.staticType = tail.pending->staticType;
+
+            indent(); ss << "{\n";
+            indentLevel++;
+            indent(); ss << mapType(currentFn->returnType) << " _r = "; visit(stmt->value); ss << ";\n";
+            indent(); ss << "while (!_pending.empty()) {\n";
+            indentLevel++;
+            indent(); ss << "_r = "; visit(&combine); ss << ";\n";
+            indent(); ss << "_pending.pop_back();\n";
+            indentLevel--;
+            indent(); ss << "}\n";
+            indent(); ss << "return _r;\n";
+            indentLevel--;
+            indent(); ss << "}\n";
+            return;
+        }
         indent(); ss << "return ";
-        if (stmt->value) visit(stmt->value.get());
+        if (stmt->value) visitAs(stmt->value, currentFn ? Type::fromName(currentFn->returnType) : Type::value());
         else ss << "NONE_VAL";
         ss << ";\n";
     }
 
+    // New arguments are all evaluated before any parameter is overwritten.
+    void visitTailJump(CallExpr* call, Expression* parked) {
+        indent(); ss << "{\n";
+        indentLevel++;
+        if (parked && tail.accumulate) {
+            indent(); ss << "_acc = _acc " << opText(tail.pending->op) << " "; visit(parked); ss << ";\n";
+        } else if (parked) {
+            indent(); ss << "_pending.push_back("; visit(parked); ss << ");\n";
+        }
+        for (size_t i = 0; i < call->args.size(); i++) {
+            indent(); ss << mapType(currentFn->params[i].typeName) << " _a" << i << " = ";
+            visit(call->args[i]);
+            ss << ";\n";
+        }
+        for (size_t i = 0; i < call->args.size(); i++) {
+            indent(); ss << currentFn->params[i].name << " = std::move(_a" << i << ");\n";
+        }
+        indent(); ss << "goto _tail;\n";
+        indentLevel--;
+        indent(); ss << "}\n";
+    }
+
     void visitLet(LetStmt* stmt) {
         indent(); ss << mapType(stmt->typeName) << " " << stmt->name << " = ";
-        visit(stmt->initializer.get());
+        visitAs(stmt->initializer, Type::fromName(stmt->typeName));
         ss << ";\n";
     }
     
     void visitAssign(AssignStmt* stmt) {
+        if (stmt->signal) {
+            indent(); ss << stmt->name << ".set(";
+            visitAs(stmt->value, Type::resolved(stmt->signal->element));
+            ss << ");\n";
+            return;
+        }
         indent(); ss << stmt->name << " = ";
-        visit(stmt->value.get());
+        visit(stmt->value);
         ss << ";\n";
     }
     
     void visitExprStmt(ExprStmt* stmt) {
         indent();
-        visit(stmt->expr.get());
+        visit(stmt->expr);
         ss << ";\n";
     }
 
     void visitAssignExpr(AssignExpr* expr) {
+        if (expr->signal) {
+            ss << expr->name << ".set(";
+            visitAs(expr->value, Type::resolved(expr->signal->element));
+            ss << ")";
+            return;
+        }
         ss << "(" << expr->name << " = ";
-        visit(expr->value.get());
+        visit(expr->value);
         ss << ")";
     }
     
     void visitBinary(BinaryExpr* expr) {
-        if (expr->op == "%") {
+        // Typed concatenation: stringify the non-string side, stay in std::string.
+        // Typed concatenation: the whole chain becomes one concat() call,
+        // which formats non-string operands in place and allocates once.
+        if (expr->op == OP_ADD && expr->staticType->kind == TY_STRING) {
+            std::vector<Expression*> parts;
+            flattenConcat(expr, parts);
+            ss << "concat(";
+            for (size_t i = 0; i < parts.size(); i++) {
+                if (i > 0) ss << ", ";
+                Expression* part = parts[i];
+                if (part->type == LITERAL && ((Literal*)part)->kind == LIT_STRING) {
+                    ss << "\"" << ((Literal*)part)->value << "\"";
+                } else if (part->staticType->kind == TY_CLASS) {
+                    ss << "toString(";
+                    visit(part);
+                    ss << ")";
+                } else {
+                    visit(part);
+                }
+            }
+            ss << ")";
+            return;
+        }
+        if (expr->staticType->kind == TY_LIST) {
+            ss << "elementwise<'" << opText(expr->op) << "'>(";
+            visitAs(expr->left, expr->left->staticType);
+            ss << ", ";
+            visitAs(expr->right, expr->right->staticType);
+            ss << ")";
+            return;
+        }
+        // A dynamic result from two typed operands must still be computed on Value.
+        bool asValue = expr->staticType->kind == TY_VALUE &&
+                       expr->left->staticType->kind != TY_VALUE &&
+                       expr->right->staticType->kind != TY_VALUE;
+        TypeKind lk = expr->left->staticType->kind;
+        TypeKind rk = expr->right->staticType->kind;
+        if (expr->op == OP_MOD && expr->staticType->kind == TY_INT) {
+            ss << "(";
+            visit(expr->left);
+            ss << " % ";
+            visit(expr->right);
+            ss << ")";
+            return;
+        }
+        if (expr->op == OP_DIV && lk == TY_INT && rk == TY_INT) {
+            ss << "((double)";
+            visit(expr->left);
+            ss << " / ";
+            visit(expr->right);
+            ss << ")";
+            return;
+        }
+        if (expr->op == OP_POW && rk == TY_INT && (lk == TY_INT || lk == TY_NUMBER)) {
+            ss << "ipow<" << mapType(expr->staticType->name()) << ">(";
+            visit(expr->left);
+            ss << ", ";
+            visit(expr->right);
+            ss << ")";
+            return;
+        }
+        if (expr->op == OP_MOD) {
             ss << "fmod(";
-            visit(expr->left.get());
+            visitOperand(expr->left, asValue);
             ss << ", ";
-            visit(expr->right.get());
+            visit(expr->right);
             ss << ")";
             return;
         }
-        if (expr->op == "**") {
+        if (expr->op == OP_POW) {
             ss << "pow(";
-            visit(expr->left.get());
+            visitOperand(expr->left, asValue);
             ss << ", ";
-            visit(expr->right.get());
+            visit(expr->right);
             ss << ")";
             return;
         }
-        ss << "(";
-        visit(expr->left.get());
-        // Original comment: if (expr->op == "**") ss << " ^ "; // Overloaded ^ for power? C++ has ^ for XOR.
+        // TypeInference::exactIntegers can leave an число with two ціле operands.
+        ss << (expr->staticType->kind == TY_NUMBER && lk == TY_INT && rk == TY_INT ? "((double)" : "(");
+        visitOperand(expr->left, asValue);
+        // Original comment: if (expr->op == OP_POW) ss << " ^ "; // Overloaded ^ for power? C++ has ^ for XOR.
         // Original comment: // Better to use a function or overload ^ in Value.
         // Original comment: // I overloaded ^ in Runtime.
-        ss << " " << expr->op << " "; // Now ** is handled by pow, so no special ^ mapping here.
-        visit(expr->right.get());
+        ss << " " << opText(expr->op) << " "; // Now ** is handled by pow, so no special ^ mapping here.
+        visit(expr->right);
+        ss << ")";
+    }
+
+    void visitOperand(Expression* expr, bool asValue) {
+        if (!asValue) { visit(expr); return; }
+        ss << "Value(";
+        visit(expr);
         ss << ")";
     }
+
+    static void flattenConcat(Expression* expr, std::vector<Expression*>& parts) {
+        if (expr->type == BINARY_EXPR && ((BinaryExpr*)expr)->op == OP_ADD && expr->staticType->kind == TY_STRING) {
+            flattenConcat(((BinaryExpr*)expr)->left, parts);
+            flattenConcat(((BinaryExpr*)expr)->right, parts);
+        } else {
+            parts.push_back(expr);
+        }
+    }
     
     void visitUnary(UnaryExpr* expr) {
-        ss << expr->op;
-        visit(expr->right.get());
+        ss << opText(expr->op);
+        if (expr->staticType->kind == TY_NUMBER && expr->right->staticType->kind == TY_INT) ss << "(double)"; // -0 stays -0
+        visit(expr->right);
     }
     
     void visitCall(CallExpr* expr) {
+        if (expr->builtin && isSink(expr->builtin)) {
+            visitStream(expr);
+            return;
+        }
+        if (expr->builtin && std::string_view(expr->builtin).substr(0, 6) == "stream") {
+            streamError("a потік must end in зібрати, сума, кількість, кожен or a для loop");
+        }
+        if (expr->builtin && std::string_view(expr->builtin) == "makeSignal" && expr->args.size() == 1) {
+            ss << cppType(expr->staticType) << "(";
+            visitAs(expr->args[0], expr->staticType->element);
+            ss << ")";
+            return;
+        }
+        if (expr->builtin) {
+            // String literals go in as their interned handle, which map
+            // lookups hash without rehashing the text.
+            ss << expr->builtin << "(";
+            for (size_t i = 0; i < expr->args.size(); i++) {
+                if (i > 0) ss << ", ";
+                Expression* arg = expr->args[i];
+                if (arg->type == LITERAL && ((Literal*)arg)->kind == LIT_STRING) visitAs(arg, Type::value());
+                else visit(arg);
+            }
+            ss << ")";
+            return;
+        }
+        if (expr->constructs || expr->method) {
+            visitObjectCall(expr);
+            return;
+        }
         // Special case print
         if (expr->callee->type == IDENTIFIER) {
-            Identifier* id = (Identifier*)expr->callee.get();
+            Identifier* id = (Identifier*)expr->callee;
             if (id->name == "print") {
                 ss << "print(";
                 for (size_t i = 0; i < expr->args.size(); i++) {
                     if (i > 0) ss << ", ";
-                    visit(expr->args[i].get());
+                    visit(expr->args[i]);
                 }
                 ss << ")";
                 return;
             }
         }
         
-        visit(expr->callee.get());
+        visit(expr->callee);
         ss << "(";
         for (size_t i = 0; i < expr->args.size(); i++) {
             if (i > 0) ss << ", ";
-            visit(expr->args[i].get());
+            visit(expr->args[i]);
         }
         ss << ")";
     }
     
+    // Methods are members of the struct, so `p.f(a)` stays `p.f(a)`, and
+    // `f(a)` inside the class is a call on the same object. A копія
+    // copies the object and overwrites the fields it names.
+    void visitObjectCall(CallExpr* expr) {
+        if (expr->constructs && expr->receiver) {
+            ss << "[&]() { " << expr->constructs->name << " _c = ";
+            visit(expr->args[0]);
+            ss << "; ";
+            for (size_t i = 1; i < expr->args.size(); i++) {
+                AssignExpr* a = (AssignExpr*)expr->args[i];
+                ss << "_c." << a->name << " = ";
+                visitAs(a->value, a->staticType);
+                ss << "; ";
+            }
+            ss << "return _c; }()";
+            return;
+        }
+        size_t from = 0;
+        const List<FunctionDecl::Param>* params = nullptr;
+        if (expr->constructs) {
+            ss << expr->constructs->name;
+        } else {
+            if (expr->receiver) {
+                visit(expr->args[0]);
+                ss << ".";
+                from = 1;
+            }
+            ss << expr->method->name;
+            params = &expr->method->params;
+        }
+        ss << "(";
+        for (size_t i = from; i < expr->args.size(); i++) {
+            if (i > from) ss << ", ";
+            visitAs(expr->args[i], Type::fromName(params ? (*params)[i - from].typeName : expr->constructs->fields[i].typeName));
+        }
+        ss << ")";
+    }
+
+    void visitField(FieldExpr* expr) {
+        visit(expr->object);
+        ss << "." << expr->field;
+    }
+
+    void visitFieldAssign(FieldAssignStmt* stmt) {
+        indent();
+        visitField(stmt->target);
+        ss << " = ";
+        visitAs(stmt->value, stmt->target->staticType);
+        ss << ";\n";
+    }
+
     void visitLiteral(Literal* lit) {
-        if (lit->valueType == "string") ss << "Value(\"" << lit->value << "\")";
-        else if (lit->valueType == "bool") ss << (lit->value == "true" ? "true" : "false");
+        if (lit->kind == LIT_STRING) {
+            ss << "_str" << internLiteral(lit->value);
+            if (lit->staticType->kind == TY_STRING) ss << ".stringVal()";
+        }
+        else if (lit->kind == LIT_BOOL) ss << (lit->value == "true" ? "true" : "false");
+        else if (lit->kind == LIT_INT && lit->staticType->kind == TY_NUMBER) ss << lit->value << ".0"; // so C++ does not do integer math on it
         else ss << lit->value; // Numbers
     }
     
+    size_t internLiteral(std::string_view text) {
+        for (size_t i = 0; i < stringPool.size(); i++) {
+            if (stringPool[i] == text) return i;
+        }
+        stringPool.push_back(text);
+        return stringPool.size() - 1;
+    }
+
     void visitIdentifier(Identifier* id) {
         ss << id->name;
+        if (id->readsSignal) ss << ".get()";
     }
     
     void indent() {
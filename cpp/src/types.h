@@ -0,0 +1,206 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Static types tracked by the inference pass. TY_VALUE is the dynamic
+// fallback; TY_UNKNOWN only exists while inference is still iterating.
+enum TypeKind { TY_UNKNOWN, TY_INT, TY_NUMBER, TY_BOOL, TY_STRING, TY_VALUE, TY_LIST, TY_MAP, TY_CHANNEL, TY_SIGNAL, TY_FUNCTION, TY_STREAM, TY_CLASS };
+
+struct Type {
+    TypeKind kind = TY_UNKNOWN;
+    const Type* element = nullptr; // TY_LIST, TY_CHANNEL, TY_SIGNAL, TY_STREAM elements, TY_MAP values, TY_FUNCTION results
+    std::string spelling;          // every kind with an element, and a class's name; see name()
+    const Type* key = nullptr;     // TY_MAP only
+
+    explicit Type(TypeKind kind, const Type* element = nullptr, std::string spelling = {}, const Type* key = nullptr)
+        : kind(kind), element(element), spelling(std::move(spelling)), key(key) {}
+
+    static const Type* unknown() { static const Type t{TY_UNKNOWN}; return &t; }
+    static const Type* integer() { static const Type t{TY_INT}; return &t; }
+    static const Type* number() { static const Type t{TY_NUMBER}; return &t; }
+    static const Type* boolean() { static const Type t{TY_BOOL}; return &t; }
+    static const Type* string() { static const Type t{TY_STRING}; return &t; }
+    static const Type* value() { static const Type t{TY_VALUE}; return &t; }
+    // An integer literal, and unannotated arithmetic on them: a number
+    // everywhere, but one a ціле it meets turns ціле (see join() and
+    // TypeInference::narrow). Anything that stores it keeps a number.
+    static const Type* whole() { static const Type t{TY_NUMBER}; return &t; }
+    static const Type* settled(const Type* t) { return t == whole() ? number() : t; }
+
+    // Interned, so types can still be compared by pointer.
+    static const Type* list(const Type* element) {
+        element = settled(element);
+        static std::map<const Type*, std::unique_ptr<Type>> lists;
+        auto& t = lists[element];
+        if (!t) t.reset(new Type{TY_LIST, element, "Список<" + std::string(element->name()) + ">"});
+        return t.get();
+    }
+
+    static const Type* map(const Type* key, const Type* value) {
+        key = settled(key);
+        value = settled(value);
+        static std::map<std::pair<const Type*, const Type*>, std::unique_ptr<Type>> maps;
+        auto& t = maps[{key, value}];
+        if (!t) {
+            std::string spelling = "Словник<" + std::string(key->name()) + "," + std::string(value->name()) + ">";
+            t.reset(new Type{TY_MAP, value, spelling, key});
+        }
+        return t.get();
+    }
+
+    static const Type* channel(const Type* element) {
+        element = settled(element);
+        static std::map<const Type*, std::unique_ptr<Type>> channels;
+        auto& t = channels[element];
+        if (!t) t.reset(new Type{TY_CHANNEL, element, "Канал<" + std::string(element->name()) + ">"});
+        return t.get();
+    }
+
+    static const Type* signal(const Type* element) {
+        element = settled(element);
+        static std::map<const Type*, std::unique_ptr<Type>> signals;
+        auto& t = signals[element];
+        if (!t) t.reset(new Type{TY_SIGNAL, element, "Сигнал<" + std::string(element->name()) + ">"});
+        return t.get();
+    }
+
+    // A lambda, by its result. Its C++ type has no spelling, so only a
+    // let can hold one.
+    static const Type* function(const Type* result) {
+        result = settled(result);
+        static std::map<const Type*, std::unique_ptr<Type>> functions;
+        auto& t = functions[result];
+        if (!t) t.reset(new Type{TY_FUNCTION, result, "Функція<" + std::string(result->name()) + ">"});
+        return t.get();
+    }
+
+    // A `потік` pipeline, by its element. Pipelines are fused into loops
+    // at compile time, so nothing at runtime has this type.
+    static const Type* stream(const Type* element) {
+        element = settled(element);
+        static std::map<const Type*, std::unique_ptr<Type>> streams;
+        auto& t = streams[element];
+        if (!t) t.reset(new Type{TY_STREAM, element, "Потік<" + std::string(element->name()) + ">"});
+        return t.get();
+    }
+
+    // A `клас` or `дані` type, by name. Class names are global, so one
+    // declared by any module is known to fromName() from then on.
+    static const Type* object(std::string_view name) {
+        auto& t = classes()[std::string(name)];
+        if (!t) t.reset(new Type{TY_CLASS, nullptr, std::string(name)});
+        return t.get();
+    }
+
+    static const Type* findObject(std::string_view name) {
+        auto it = classes().find(std::string(name));
+        return it == classes().end() ? nullptr : it->second.get();
+    }
+
+    static std::map<std::string, std::unique_ptr<Type>>& classes() {
+        static std::map<std::string, std::unique_ptr<Type>> classes;
+        return classes;
+    }
+
+    // Annotation spelling understood by Transpiler::mapType.
+    std::string_view name() const {
+        switch (kind) {
+            case TY_INT: return "ціле";
+            case TY_NUMBER: return "число";
+            case TY_BOOL: return "бул";
+            case TY_STRING: return "стрічка";
+            case TY_LIST:
+            case TY_MAP:
+            case TY_CHANNEL:
+            case TY_SIGNAL:
+            case TY_FUNCTION:
+            case TY_STREAM:
+            case TY_CLASS: return spelling;
+            default: return "Value";
+        }
+    }
+
+    // Inverse of name(): resolves a source annotation such as ": number".
+    static const Type* fromName(std::string_view n) {
+        if (n == "ціле" || n == "Ціле" || n == "int" || n == "Int") return integer();
+        if (n == "число" || n == "number") return number();
+        if (n == "стрічка" || n == "string") return string();
+        if (n == "бул" || n == "bool") return boolean();
+        if (const Type* c = findObject(n)) return c;
+        if (auto inner = typeArgument(n, "Список") ; !inner.empty()) return list(fromName(inner));
+        if (auto inner = typeArgument(n, "List") ; !inner.empty()) return list(fromName(inner));
+        if (auto inner = typeArgument(n, "Канал") ; !inner.empty()) return channel(fromName(inner));
+        if (auto inner = typeArgument(n, "Channel") ; !inner.empty()) return channel(fromName(inner));
+        if (auto inner = typeArgument(n, "Сигнал") ; !inner.empty()) return signal(fromName(inner));
+        if (auto inner = typeArgument(n, "Signal") ; !inner.empty()) return signal(fromName(inner));
+        if (auto inner = typeArgument(n, "Функція") ; !inner.empty()) return function(fromName(inner));
+        std::string_view inner = typeArgument(n, "Словник");
+        if (inner.empty()) inner = typeArgument(n, "Map");
+        if (!inner.empty()) {
+            // Split "K,V" at the comma that is not inside a nested argument list.
+            int depth = 0;
+            for (size_t i = 0; i < inner.size(); i++) {
+                if (inner[i] == '<') depth++;
+                else if (inner[i] == '>') depth--;
+                else if (inner[i] == ',' && depth == 0) return map(fromName(inner.substr(0, i)), fromName(inner.substr(i + 1)));
+            }
+        }
+        return value();
+    }
+
+    // "Список<число>" with prefix "Список" -> "число"; "" if it does not match.
+    static std::string_view typeArgument(std::string_view n, std::string_view prefix) {
+        if (n.size() < prefix.size() + 3 || n.substr(0, prefix.size()) != prefix) return {};
+        if (n[prefix.size()] != '<' || n.back() != '>') return {};
+        return n.substr(prefix.size() + 1, n.size() - prefix.size() - 2);
+    }
+
+    bool isNumeric() const { return kind == TY_INT || kind == TY_NUMBER; }
+
+    // What a stream stage reads from this: a stream's elements, or a
+    // list's, with сигнал elements read for their value; nullptr for
+    // anything else.
+    const Type* streamed() const {
+        if (kind == TY_UNKNOWN) return this;
+        if (kind == TY_STREAM) return element;
+        if (kind != TY_LIST) return nullptr;
+        return element->kind == TY_SIGNAL ? element->element : element;
+    }
+
+    // Least upper bound: identical types stay, an int widens to a number
+    // (but makes a whole one ціле), two lists (or maps) join their element
+    // types, so an empty literal takes the other side's and mixed elements
+    // become Value; anything else goes dynamic.
+    static const Type* join(const Type* a, const Type* b) {
+        if (a->kind == TY_UNKNOWN) return b;
+        if (b->kind == TY_UNKNOWN) return a;
+        if (a == b) return a;
+        if ((a == whole() && b->kind == TY_INT) || (b == whole() && a->kind == TY_INT)) return integer();
+        if (a->isNumeric() && b->isNumeric()) return number();
+        if (a->kind == TY_LIST && b->kind == TY_LIST) return list(join(a->element, b->element));
+        if (a->kind == TY_MAP && b->kind == TY_MAP) return map(join(a->key, b->key), join(a->element, b->element));
+        if (a->kind == TY_SIGNAL && b->kind == TY_SIGNAL) return signal(join(a->element, b->element));
+        if (a->kind == TY_STREAM && b->kind == TY_STREAM) return stream(join(a->element, b->element));
+        return value();
+    }
+
+    // Whatever is still unknown once inference is done is dynamic.
+    static const Type* resolved(const Type* t) {
+        if (t->kind == TY_UNKNOWN) return value();
+        if (t == whole()) return number();
+        if (t->kind == TY_LIST) return list(resolved(t->element));
+        if (t->kind == TY_MAP) return map(resolved(t->key), resolved(t->element));
+        if (t->kind == TY_CHANNEL) return channel(resolved(t->element));
+        if (t->kind == TY_SIGNAL) return signal(resolved(t->element));
+        if (t->kind == TY_FUNCTION) return function(resolved(t->element));
+        if (t->kind == TY_STREAM) return stream(resolved(t->element));
+        return t;
+    }
+};
+
+#endif